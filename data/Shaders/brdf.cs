@@ -0,0 +1,58 @@
+#version 420
+#extension GL_ARB_compute_shader : require
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+/* ==============================================================================
+        Uniforms
+ ============================================================================== */
+layout(binding = 0, rg16f) writeonly uniform image2D brdfLUT;
+
+uniform float lutSize;
+uniform float numSamples;
+
+/* ==============================================================================
+        Imports
+ ============================================================================== */
+vec2 hammersley(uint i, uint n);
+vec3 importanceSampleGGX(vec2 u, float a2);
+
+// Scale and bias of F0 for NdotV along x and roughness along y, with
+// Smith-Schlick visibility, as integrateBRDF in IBL.cpp
+void main(void) {
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (float(texel.x) >= lutSize || float(texel.y) >= lutSize)
+        return;
+
+    float NdotV     = (float(texel.x) + 0.5) / lutSize;
+    float roughness = (float(texel.y) + 0.5) / lutSize;
+
+    vec3 V = vec3(sqrt(1.0 - NdotV * NdotV), 0.0, NdotV);
+
+    float a  = roughness * roughness;
+    float a2 = a * a;
+    float k  = a / 2.0;
+
+    // G1 of the view direction over NdotV, the same for every sample
+    float visV = 1.0 / (NdotV * (1.0 - k) + k);
+
+    uint n = uint(numSamples);
+
+    vec2 result = vec2(0.0);
+    for (uint i = 0u; i < n; ++i) {
+        vec3 H = importanceSampleGGX(hammersley(i, n), a2);
+
+        float VdotH = max(dot(V, H), 0.0);
+        float NdotL = 2.0 * VdotH * H.z - V.z;
+        if (NdotL <= 0.0)
+            continue;
+
+        float visL = NdotL / (NdotL * (1.0 - k) + k);
+        float vis  = visL * visV * VdotH / H.z;
+        float Fc   = pow(1.0 - VdotH, 5.0);
+
+        result += vec2(1.0 - Fc, Fc) * vis;
+    }
+
+    imageStore(brdfLUT, ivec2(texel), vec4(result / numSamples, 0.0, 0.0));
+}
@@ -92,8 +92,8 @@ float brdfOrenNayarTriAce() {
  ============================================================================*/
 
 float specMicrofacet(in float HdotL, in float HdotR, in float D, in float G) {
-    if (HdotL == 0 || HdotR == 0)
-        return 0;
+    if (HdotL == 0.0 || HdotR == 0.0)
+        return 0.0;
 
     float F = fresnelSchlick(HdotL);
     return (D * G * F) / (4.0 * HdotL * HdotR);
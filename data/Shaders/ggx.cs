@@ -0,0 +1,78 @@
+#version 420
+#extension GL_ARB_compute_shader : require
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// Math constants
+const float PI = 3.14159265358979;
+
+/* ==============================================================================
+        Uniforms
+ ============================================================================== */
+layout(binding = 0) uniform samplerCube envMap;
+layout(binding = 0, rgba16f) writeonly uniform imageCube ggxLevel;
+
+uniform float roughness;
+uniform float levelSize;
+uniform float envSize;
+uniform float minLod;     // Level of envMap as large as level 0 of ggxLevel
+uniform float numSamples;
+
+/* ==============================================================================
+        Imports
+ ============================================================================== */
+vec2 hammersley(uint i, uint n);
+vec3 importanceSampleGGX(vec2 u, float a2);
+vec3 faceDirection(uint face, vec2 st);
+
+// Prefilters one texel of a level with N = V = R, as prefilterGGX in
+// IBL.cpp. Samples read the mip of envMap that covers their solid angle.
+void main(void) {
+    uvec3 texel = gl_GlobalInvocationID;
+    if (float(texel.x) >= levelSize || float(texel.y) >= levelSize)
+        return;
+
+    vec2 st = 2.0 * (vec2(texel.xy) + 0.5) / levelSize - 1.0;
+    vec3 N  = faceDirection(texel.z, st);
+
+    if (roughness == 0.0) {
+        imageStore(ggxLevel, ivec3(texel), vec4(textureLod(envMap, N, minLod).rgb, 1.0));
+        return;
+    }
+
+    vec3 up = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 T  = normalize(cross(up, N));
+    vec3 B  = cross(N, T);
+
+    float a  = roughness * roughness;
+    float a2 = a * a;
+
+    float texelAngle = 4.0 * PI / (6.0 * envSize * envSize);
+
+    uint n = uint(numSamples);
+
+    vec3  color  = vec3(0.0);
+    float weight = 0.0;
+    for (uint i = 0u; i < n; ++i) {
+        vec3 H = importanceSampleGGX(hammersley(i, n), a2);
+
+        // Reflect V = N about H
+        float NdotL = 2.0 * H.z * H.z - 1.0;
+        if (NdotL <= 0.0)
+            continue;
+
+        vec3 L = T * (2.0 * H.z * H.x) + B * (2.0 * H.z * H.y) + N * NdotL;
+
+        // pdf of L is D(H) / 4, as NdotH = VdotH
+        float d   = H.z * H.z * (a2 - 1.0) + 1.0;
+        float pdf = a2 / (PI * d * d) / 4.0;
+
+        float sampleAngle = 1.0 / (numSamples * pdf);
+        float lod = max(0.5 * log2(sampleAngle / texelAngle) + 1.0, minLod);
+
+        color  += textureLod(envMap, L, lod).rgb * NdotL;
+        weight += NdotL;
+    }
+
+    imageStore(ggxLevel, ivec3(texel), vec4(color / weight, 1.0));
+}
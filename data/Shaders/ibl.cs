@@ -0,0 +1,40 @@
+#version 420
+#extension GL_ARB_compute_shader : require
+
+// Math constants
+const float PI = 3.14159265358979;
+
+/* ==============================================================================
+        Sampling
+ ============================================================================== */
+// Hammersley point i of n
+vec2 hammersley(uint i, uint n) {
+    return vec2(float(i) / float(n), float(bitfieldReverse(i)) * 2.3283064365386963e-10);
+}
+
+// Half vector of the GGX lobe around +Z [Karis, 2013]
+vec3 importanceSampleGGX(vec2 u, float a2) {
+    float phi      = 2.0 * PI * u.x;
+    float cosTheta = sqrt((1.0 - u.y) / (1.0 + (a2 - 1.0) * u.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+
+    return vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+}
+
+/* ==============================================================================
+        Cubemaps
+ ============================================================================== */
+// Direction through a texel of a face, st in [-1, 1]
+vec3 faceDirection(uint face, vec2 st) {
+    vec3 dir;
+    switch (face) {
+        case 0:  dir = vec3( 1.0, -st.y, -st.x); break;
+        case 1:  dir = vec3(-1.0, -st.y,  st.x); break;
+        case 2:  dir = vec3( st.x,  1.0,  st.y); break;
+        case 3:  dir = vec3( st.x, -1.0, -st.y); break;
+        case 4:  dir = vec3( st.x, -st.y,  1.0); break;
+        default: dir = vec3(-st.x, -st.y, -1.0); break;
+    }
+
+    return normalize(dir);
+}
@@ -45,6 +45,11 @@ uniform lightBlock {
     Light lights[NUM_LIGHTS];
 };
 
+// Irradiance of the environment over pi, in the first three SH bands
+uniform shBlock {
+    vec4 shCoeffs[9];
+};
+
 // Material parameters
 uniform sampler2D diffuseTex;
 uniform sampler2D normalTex;
@@ -57,8 +62,8 @@ uniform float roughness;
 uniform vec3  spec;
 
 // IBL precomputation
-uniform samplerCube irradianceTex;
 uniform samplerCube ggxTex;
+uniform float       maxGGXLod; // Level of roughness 1, see ggxLevelRoughness
 uniform sampler2D   brdfTex;
 
 /* ==============================================================================
@@ -83,8 +88,11 @@ const float PI = 3.14159265358979;
 out vec4 outColor;
 
 vec3 perturbNormal(in sampler2D normalMap) {
-    // Fetch normal from map and adjust to linear space
-    vec3 normal = texture(normalMap, vsIn.texCoords).xyz * 2.0 - 1.0;
+    // Fetch normal from map and adjust to linear space. Z is rebuilt
+    // from XY, as BC5 normal maps only store those two
+    vec3 normal;
+    normal.xy = texture(normalMap, vsIn.texCoords).xy * 2.0 - 1.0;
+    normal.z  = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 
     // Calculate uv derivatives
     vec2 duvdx = dFdx(vsIn.texCoords);
@@ -102,8 +110,6 @@ vec3 perturbNormal(in sampler2D normalMap) {
     return normalize(mat3(T, B, N) * normal);
 }
 
-const float MAX_GGX_LOD = 4.0;
-
 float fetchParameter(sampler2D samp, float val) {
     if (val >= 0.0)
         return val;
@@ -118,6 +124,22 @@ vec3 fetchDiffuse() {
         return toLinearRGB(texture(diffuseTex, vsIn.texCoords).rgb, gamma);
 }
 
+vec3 evalSH(vec3 N) {
+    vec3 sh = shCoeffs[0].rgb * 0.282095;
+
+    sh += shCoeffs[1].rgb * 0.488603 * N.y;
+    sh += shCoeffs[2].rgb * 0.488603 * N.z;
+    sh += shCoeffs[3].rgb * 0.488603 * N.x;
+
+    sh += shCoeffs[4].rgb * 1.092548 * N.x * N.y;
+    sh += shCoeffs[5].rgb * 1.092548 * N.y * N.z;
+    sh += shCoeffs[6].rgb * 0.315392 * (3.0 * N.z * N.z - 1.0);
+    sh += shCoeffs[7].rgb * 1.092548 * N.x * N.z;
+    sh += shCoeffs[8].rgb * 0.546274 * (N.x * N.x - N.y * N.y);
+
+    return max(sh, vec3(0.0));
+}
+
 void main(void) {
     vec3 V = normalize(ViewPos - vsIn.position);
     vec3 N = perturbNormal(normalTex);
@@ -133,7 +155,7 @@ void main(void) {
     ============================================================================== */
     // Diffuse component
     vec3 kd         = fetchDiffuse();
-    vec3 irradiance = texture(irradianceTex, N).rgb;
+    vec3 irradiance = evalSH(N);
     vec3 diffuse    = kd * irradiance; // Appendix, formula X
 
     // Specular component
@@ -141,7 +163,7 @@ void main(void) {
     vec3 F  = fresnelSchlickUnreal(NdotV, spec);
 	
     // Fetch precomputed integrals
-    vec3 prefGGX = textureLod(ggxTex, R, rough * MAX_GGX_LOD).rgb;  
+    vec3 prefGGX = textureLod(ggxTex, R, rough * maxGGXLod).rgb;  
     vec3 brdf    = texture(brdfTex, vec2(NdotV, rough)).rgb;
 
     vec3 brdfInt  = F0 * brdf.r + brdf.g; // Appendix, formula Y
@@ -2,6 +2,10 @@
 
 #include <Resources.h>
 #include <RenderInterface.h>
+#include <TextureStreamer.h>
+#include <TextureResidency.h>
+#include <FrameCapture.h>
+#include <PosterRenderer.h>
 
 #include <Shape.h>
 #include <Sphere.h>
@@ -28,10 +32,13 @@ void initializeEngine() {
 
     // Initialize render hardware interface
     RHI.initialize();
+
+    // Initialize texture uploads in the background
+    Streamer.initialize();
 }
 
 PBRApp::PBRApp(const std::string& title, int width, int height) : OpenGLApplication(title, width, height), 
-                         _skyToggle(true), _selectedShape(nullptr), _showGUI(true), _skybox(1), _f0(0.04f) {
+                         _skyToggle(true), _selectedShape(nullptr), _showGUI(true), _snapshot(false), _poster(false), _skybox(1), _f0(0.04f) {
 
 }
 
@@ -110,6 +117,16 @@ void PBRApp::drawScene() {
 
     if (_showGUI)
         drawInterface();
+
+    // Read before the buffers are swapped, while the frame is complete
+    if (_snapshot)
+        takeSnapshot();
+
+    if (_recorder.isRecording())
+        recordFrame();
+
+    if (_poster)
+        renderPoster();
 }
 
 void PBRApp::restoreToneDefaults() {
@@ -125,6 +142,18 @@ void PBRApp::restoreToneDefaults() {
 }
 
 void PBRApp::update(float dt) {
+    // Upload this frame's share of the queued textures
+    bool streaming = !Streamer.isIdle();
+    Streamer.update();
+
+    if (streaming && Streamer.isIdle()) {
+        std::cout << "[INFO] Textures finished streaming..." << std::endl;
+
+        uint64 saved = Resource.sharedTextureSavings();
+        if (saved > 0)
+            std::cout << "[INFO] Shared textures saved " << (saved >> 20) << " MB of GPU memory" << std::endl;
+    }
+
     if (_mouseBtns[2]) {
         _camera->updateOrientation(_mouseDy * dt * 0.75f, _mouseDx * dt * 0.75f);
         _camera->updateViewMatrix();
@@ -153,10 +182,25 @@ void PBRApp::update(float dt) {
     _renderer.setGamma(_gamma);
     _renderer.setToneParams(_toneParams);
     _renderer.setSkyboxDraw(_skyToggle);
+
+    // Fit the resident mip levels to the screen size of the shapes
+    Residency.update(_scene, *_camera);
+
+    // Snapshots are saved in the background
+    Capture.update();
+    if (Capture.takeFailures() > 0)
+        std::cout << "[INFO] Snapshot could not be saved..." << std::endl;
 }
 
 void PBRApp::cleanup()  {
+    if (_recorder.isRecording())
+        toggleRecording();
+
+    Capture.cleanup();
+    Streamer.cleanup();
 
+    // Materials drop their textures while the context is still current
+    Resource.cleanup();
 }
 
 void PBRApp::processKeyPress(unsigned char key, int x, int y)  {
@@ -166,7 +210,13 @@ void PBRApp::processKeyPress(unsigned char key, int x, int y)  {
         _showGUI = !_showGUI;
 
     if (key == 'p')
-        takeSnapshot();
+        _snapshot = true;
+
+    if (key == 'r')
+        toggleRecording();
+
+    if (key == 'o')
+        _poster = true;
 }
 
 void PBRApp::processMouseClick(int button, int state, int x, int y) {
@@ -291,7 +341,53 @@ void PBRApp::changeSkybox(int id) {
 }
 
 void PBRApp::takeSnapshot() {
-    sref<Image> img = RHI.getImage(0, 0, _width, _height);
-    img->flipY();
-    img->saveImage("snapshot.png");
+    Capture.saveFramebuffer("snapshot.png", 0, 0, _width, _height);
+    _snapshot = false;
+}
+
+void PBRApp::toggleRecording() {
+    if (!_recorder.isRecording()) {
+        if (_recorder.start("capture.y4m", _width, _height))
+            std::cout << "[INFO] Recording to capture.y4m..." << std::endl;
+        else
+            std::cout << "[INFO] Could not start recording..." << std::endl;
+
+        return;
+    }
+
+    _recorder.stop();
+
+    std::cout << "[INFO] Recorded " << _recorder.framesWritten() << " frames, "
+              << _recorder.framesDropped() << " dropped, "
+              << _recorder.framesBlocked() << " blocked" << std::endl;
+}
+
+void PBRApp::recordFrame() {
+    // The video keeps the size it started with
+    if (_width != _recorder.width() || _height != _recorder.height()) {
+        std::cout << "[INFO] Window resized, recording stopped..." << std::endl;
+        toggleRecording();
+        return;
+    }
+
+    if (!_recorder.captureFrame()) {
+        std::cout << "[INFO] Could not write the recording..." << std::endl;
+        toggleRecording();
+    }
+}
+
+void PBRApp::renderPoster() {
+    // 16K wide, with the aspect of the window
+    int32 width  = 16384;
+    int32 height = (int32)((int64)width * _height / _width);
+
+    std::cout << "[INFO] Rendering " << width << "x" << height << " poster..." << std::endl;
+
+    PosterRenderer poster;
+    if (poster.render(_renderer, _scene, *_camera, "poster.png", width, height))
+        std::cout << "[INFO] Poster saved to poster.png" << std::endl;
+    else
+        std::cout << "[INFO] Poster could not be rendered..." << std::endl;
+
+    _poster = false;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <Renderer.h>
 #include <Skybox.h>
 #include <Spectrum.h>
+#include <VideoRecorder.h>
 
 namespace pbr {
 
@@ -29,6 +30,9 @@ namespace pbr {
         void restoreToneDefaults();
         void changeSkybox(int id);
         void takeSnapshot();
+        void toggleRecording();
+        void recordFrame();
+        void renderPoster();
 
         Scene    _scene;
         Renderer _renderer;
@@ -50,6 +54,10 @@ namespace pbr {
 
         bool _showGUI;
         bool _skyToggle;
+        bool _snapshot;
+        bool _poster;
+
+        VideoRecorder _recorder;
 
         Shape* _selectedShape;
 
@@ -79,6 +79,20 @@ Mat4 Camera::viewProjMatrix() const {
     return projMatrix() * viewMatrix();
 }
 
+Mat4 Camera::regionProjMatrix(float x0, float y0, float x1, float y1) const {
+    // Maps the window, in NDC, back to [-1, 1]
+    float sx = 1.0f / (x1 - x0);
+    float sy = 1.0f / (y1 - y0);
+
+    Vec3 offset(-(x0 + x1 - 1.0f) * sx, -(y0 + y1 - 1.0f) * sy, 0.0f);
+
+    return translation(offset) * math::scale(sx, sy, 1.0f) * _projMatrix;
+}
+
+void Camera::setProjMatrix(const Mat4& proj) {
+    _projMatrix = proj;
+}
+
 void Camera::updateViewMatrix() {
     Matrix4x4 rotX = rotationAxis(_pitch, Vector3(1, 0, 0));
     Matrix4x4 rotY = rotationAxis(_yaw,   Vector3(0, 1, 0));
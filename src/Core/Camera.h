@@ -37,6 +37,12 @@ namespace pbr {
 
         Mat4 viewProjMatrix() const;
 
+        // Projection of the window [x0, x1] x [y0, y1] of the image, in
+        // [0, 1] from the bottom left, stretched over the whole viewport
+        Mat4 regionProjMatrix(float x0, float y0, float x1, float y1) const;
+
+        void setProjMatrix(const Mat4& proj);
+
         void updateOrientation(float dp, float dy);
 
         void updateViewMatrix();
@@ -60,7 +60,7 @@ BBox3 Mesh::bbox() const {
 }
 
 BSphere Mesh::bSphere() const {
-    return _bbox.sphere();
+    return bbox().sphere();
 }
 
 bool Mesh::intersect(const Ray& ray) const {
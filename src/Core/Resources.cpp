@@ -3,6 +3,8 @@
 #include <Geometry.h>
 #include <Shape.h>
 #include <Shader.h>
+#include <RenderInterface.h>
+#include <TextureResidency.h>
 
 using namespace pbr;
 
@@ -90,9 +92,124 @@ Texture* Resources::getTexture(const std::string& name) {
     return _textures.at(name).get();
 }
 
+RRID Resources::acquireTexture(const std::string& key) {
+    auto it = _sharedKeys.find(key);
+    if (it == _sharedKeys.end())
+        return -1;
+
+    _shared[it->second].refCount++;
+
+    return it->second;
+}
+
+RRID Resources::acquireTexture(uint64 pixelHash, const std::string& key) {
+    auto it = _sharedHashes.find(pixelHash);
+    if (it == _sharedHashes.end())
+        return -1;
+
+    // Later loads of this key skip the import
+    _sharedKeys[key] = it->second;
+    _shared[it->second].refCount++;
+
+    return it->second;
+}
+
+void Resources::registerTexture(const std::string& key, uint64 pixelHash, RRID id, uint64 size) {
+    _sharedKeys[key] = id;
+
+    auto it = _shared.find(id);
+    if (it == _shared.end()) {
+        SharedTexture tex = { 0, 0, 1, -1 };
+        it = _shared.emplace(id, tex).first;
+    }
+
+    // Streamed textures are registered before their pixels are known
+    if (pixelHash == 0)
+        return;
+
+    it->second.pixelHash = pixelHash;
+    it->second.size      = size;
+
+    // Textures uploaded at the same time keep the first one
+    _sharedHashes.emplace(pixelHash, id);
+}
+
+bool Resources::aliasTexture(RRID id, uint64 pixelHash) {
+    auto shared = _sharedHashes.find(pixelHash);
+    if (shared == _sharedHashes.end() || shared->second == id)
+        return false;
+
+    RRID target = shared->second;
+    if (!RHI.aliasTexture(id, target))
+        return false; // Error
+
+    // Streamers without a staging ring alias before the key is registered
+    auto it = _shared.find(id);
+    if (it == _shared.end()) {
+        SharedTexture tex = { 0, 0, 1, -1 };
+        it = _shared.emplace(id, tex).first;
+    }
+
+    // Later loads of the keys of id acquire the texture itself
+    for (auto& key : _sharedKeys) {
+        if (key.second == id)
+            key.second = target;
+    }
+
+    it->second.alias = target;
+    _shared[target].refCount++;
+
+    return true;
+}
+
+bool Resources::releaseTexture(RRID id) {
+    auto it = _shared.find(id);
+    if (it == _shared.end())
+        return false;
+
+    if (--it->second.refCount > 0)
+        return true;
+
+    for (auto key = _sharedKeys.begin(); key != _sharedKeys.end(); ) {
+        if (key->second == id)
+            key = _sharedKeys.erase(key);
+        else
+            ++key;
+    }
+
+    auto hash = _sharedHashes.find(it->second.pixelHash);
+    if (hash != _sharedHashes.end() && hash->second == id)
+        _sharedHashes.erase(hash);
+
+    RRID alias = it->second.alias;
+    _shared.erase(it);
+
+    // Aliases drop their name and the reference they hold
+    if (alias != -1) {
+        RHI.deleteTexture(id);
+        return releaseTexture(alias);
+    }
+
+    Residency.release(id);
+
+    return RHI.deleteTexture(id);
+}
+
+uint64 Resources::sharedTextureSavings() const {
+    uint64 saved = 0;
+    for (const auto& tex : _shared)
+        saved += (uint64)(tex.second.refCount - 1) * tex.second.size;
+
+    return saved;
+}
+
 void Resources::cleanup() {
     _geometry.clear();
     _shapes.clear();
     _shaders.clear();
     _textures.clear();
+
+    _shared.clear();
+    _sharedKeys.clear();
+    _sharedHashes.clear();
 }
\ No newline at end of file
@@ -42,17 +42,49 @@ namespace pbr {
         Shader*   getShader  (const std::string& name);
         Texture*  getTexture (const std::string& name);
 
+        // Textures imported from files are shared through a registry. They
+        // are found by key, the canonical path and import settings, or by a
+        // hash of their pixels. Both acquire functions add a reference and
+        // return -1 when nothing matches. A pixelHash of 0 registers a
+        // texture whose pixels are not known yet, registering its id
+        // again fills them in and keeps its references.
+        RRID acquireTexture(const std::string& key);
+        RRID acquireTexture(uint64 pixelHash, const std::string& key);
+        void registerTexture(const std::string& key, uint64 pixelHash, RRID id, uint64 size);
+
+        // Makes a registered id an alias of the texture holding pixelHash,
+        // once its pixels turn out to be shared. The alias keeps its own
+        // references and holds one on the texture. False if none matches.
+        bool aliasTexture(RRID id, uint64 pixelHash);
+
+        // Drops a reference, the texture is deleted with the last one
+        bool releaseTexture(RRID id);
+
+        // GPU memory that shared textures avoid allocating, in bytes
+        uint64 sharedTextureSavings() const;
+
         void cleanup();
 
     private:
         Resources();
 
+        struct SharedTexture {
+            uint64 pixelHash;
+            uint64 size;
+            uint32 refCount;
+            RRID   alias;
+        };
+
         map<std::string, sref<Transform>> _transforms;
 
         map<std::string, sref<Geometry>> _geometry;
         map<std::string, sref<Shape>>    _shapes;
         map<std::string, sref<Shader>>   _shaders;
         map<std::string, sref<Texture>>  _textures;
+
+        map<RRID, SharedTexture>  _shared;
+        map<std::string, RRID>    _sharedKeys;
+        map<uint64, RRID>         _sharedHashes;
     };
 
 }
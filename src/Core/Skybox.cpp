@@ -3,10 +3,31 @@
 #include <Resources.h>
 #include <RenderInterface.h>
 #include <Texture.h>
+#include <IBL.h>
 
 using namespace pbr;
 
-Skybox::Skybox(RRID cubeProg, RRID cubeTex) : _geoId(-1), _cubeProg(cubeProg), _cubeTex(cubeTex) { }
+namespace {
+    // Resolution cap of the baked GGX maps, mirror reflections above it
+    // are rarely seen at full size
+    static PBR_CONSTEXPR int32 GGX_MAX_SIZE = 256;
+
+    // Samples per axis when projecting panoramas, whose texels get much
+    // smaller than those of the faces towards the poles
+    static PBR_CONSTEXPR uint32 PANO_SAMPLES = 2;
+
+    // Radiance maps are kept in the shared exponent format, a third
+    // of the size of float RGB and still sampled with filtering
+    void packRadiance(Cubemap& cube) {
+        ImageComponent comp = cube.compType();
+        if (cube.numChannels() == 3 && (comp == FLOAT || comp == HALF))
+            cube.convert(IMGFMT_RGB9E5);
+    }
+}
+
+Skybox::Skybox(RRID cubeProg, RRID cubeTex) : _geoId(-1), _cubeProg(cubeProg), _cubeTex(cubeTex) {
+    memset(&_irradianceSH, 0, sizeof(SHCoeffs));
+}
 
 Skybox::Skybox(const std::string& folder) {
     _cubeProg = Resource.getShader("skybox")->id();
@@ -16,24 +37,59 @@ Skybox::Skybox(const std::string& folder) {
     cubeSampler.setFilterMode(FILTER_LINEAR, FILTER_LINEAR);
     cubeSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
 
+    // Panoramas are projected once, and the cubemap saved for next runs
     Cubemap cube;
-    cube.loadCubemap(folder + "/cube.cube");
-    _cubeTex = RHI.createCubemap(cube, cubeSampler);
-    Resource.addTexture("sky-" + folder, RHI.getTexture(_cubeTex));
-
-    Cubemap irradianceCube;
-    irradianceCube.loadCubemap(folder + "/irradiance.cube");
-    _irradianceTex = RHI.createCubemap(irradianceCube, cubeSampler);
-    Resource.addTexture("irradiance-" + folder, RHI.getTexture(_irradianceTex));
-
-    TexSampler ggxSampler;
-    ggxSampler.setFilterMode(FILTER_LINEAR_MIP_LINEAR, FILTER_LINEAR);
-    ggxSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+    if (!cube.loadCubemap(folder + "/cube.cube")) {
+        Image pano;
+        if (pano.loadImage(folder + "/pano.hdr") || pano.loadImage(folder + "/pano.exr")) {
+            std::cout << "[INFO] Projecting " << folder << " panorama..." << std::endl;
+
+            if (equirectToCubemap(pano, cube, std::max(pano.width() / 4, 1), PANO_BILINEAR, PANO_SAMPLES)) {
+                if (cube.numChannels() == 3)
+                    cube.convert(IMGFMT_RGB16F);
+
+                cube.saveCubemap(folder + "/cube.cube");
+            }
+        }
+    }
+
+    // Irradiance is low frequency, nine coefficients replace the map
+    if (projectSH(cube, _irradianceSH))
+        convolveLambert(_irradianceSH);
+    else
+        memset(&_irradianceSH, 0, sizeof(SHCoeffs));
+
+    // Prefiltered on the GPU at load time, so only the radiance map is
+    // needed on disk
+    int32 ggxSize = std::min(cube.width(), GGX_MAX_SIZE);
+    _ggxTex = RHI.prefilterGGX(cube, ggxSize);
+
+    if (_ggxTex == -1) {
+        TexSampler ggxSampler;
+        ggxSampler.setFilterMode(FILTER_LINEAR_MIP_LINEAR, FILTER_LINEAR);
+        ggxSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+
+        // Baked from the radiance map when missing, and saved for next runs
+        Cubemap ggxCube;
+        if (!ggxCube.loadCubemap(folder + "/ggx.cube")) {
+            std::cout << "[INFO] Prefiltering " << folder << " environment..." << std::endl;
+
+            if (prefilterGGX(cube, ggxCube, ggxSize)) {
+                packRadiance(ggxCube);
+                ggxCube.saveCubemap(folder + "/ggx.cube");
+            }
+        }
+
+        packRadiance(ggxCube);
+        _ggxTex = RHI.createCubemap(ggxCube, ggxSampler);
+    }
 
-    Cubemap ggxCube;
-    ggxCube.loadCubemap(folder + "/ggx.cube");
-    _ggxTex = RHI.createCubemap(ggxCube, ggxSampler);
     Resource.addTexture("ggx-" + folder, RHI.getTexture(_ggxTex));
+
+    // Packed once the maps that derive from it are done
+    packRadiance(cube);
+    _cubeTex = RHI.createCubemap(cube, cubeSampler);
+    Resource.addTexture("sky-" + folder, RHI.getTexture(_cubeTex));
 }
 
 void Skybox::initialize() {
@@ -52,14 +108,14 @@ void Skybox::draw() const {
     RHI.useProgram(0);
 }
 
-RRID Skybox::irradianceTex() const {
-    return _irradianceTex;
-}
-
 RRID Skybox::cubeTex() const {
     return _cubeTex;
 }
 
 RRID Skybox::ggxTex() const {
     return _ggxTex;
+}
+
+const SHCoeffs& Skybox::irradianceSH() const {
+    return _irradianceSH;
 }
\ No newline at end of file
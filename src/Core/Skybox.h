@@ -4,6 +4,7 @@
 #include <PBR.h>
 #include <RenderInterface.h>
 #include <Geometry.h>
+#include <IBL.h>
 
 namespace pbr {
 
@@ -15,19 +16,22 @@ namespace pbr {
         void initialize();
         void draw() const;
 
-        RRID irradianceTex() const;
         RRID cubeTex() const;
         RRID ggxTex() const;
 
+        // Irradiance over pi, unreal.fs reads it from SH_BUFFER_IDX
+        const SHCoeffs& irradianceSH() const;
+
     private:
         RRID _cubeProg;      
         RRID _geoId;
 
         // Textures
         RRID _cubeTex;
-        RRID _irradianceTex;
         RRID _ggxTex;
 
+        SHCoeffs _irradianceSH;
+
         sref<Geometry> _geo;
     };
 
@@ -5,7 +5,7 @@
 
 using namespace pbr;
 
-Sphere::Sphere(const Vec3& pos, float radius) : Shape(), _radius(radius) { }
+Sphere::Sphere(const Vec3& pos, float radius) : Shape(pos), _radius(radius) { }
 Sphere::Sphere(const Mat4& objToWorld, float radius) : Shape(objToWorld), _radius(radius) { }
 
 void Sphere::prepare() {
@@ -0,0 +1,272 @@
+#include <FrameCapture.h>
+
+#include <cstring>
+#include <path.h>
+
+#include <Texture.h>
+#include <PixelOps.h>
+#include <ThreadPool.h>
+
+using namespace pbr;
+
+namespace {
+    // Idle pack buffers kept for the next captures
+    static PBR_CONSTEXPR uint32 MAX_IDLE_BUFFERS = 4;
+
+    bool isHDR(ImageFormat format) {
+        ImageComponent comp = formatToImgComp(format);
+        return comp == FLOAT || comp == HALF || format == IMGFMT_RGBE8 ||
+               format == IMGFMT_RGB9E5 || format == IMGFMT_RG11B10F;
+    }
+
+    bool saveCapture(Image& img, const std::string& filePath, ToneOperator op, const RendererBuffer& params) {
+        // OpenGL rows start at the bottom
+        if (!img.flipY())
+            return false;
+
+        std::string ext = filesystem::path(filePath).extension();
+        ImageComponent comp = img.compType();
+
+        if (ext == "png" && isHDR(img.format())) {
+            // Packed formats are tone mapped from float
+            if (comp != FLOAT && comp != HALF && !img.convert(IMGFMT_RGB32F))
+                return false;
+
+            if (!img.toneMap(op, params))
+                return false;
+        } else if ((ext == "hdr" || ext == "exr") && comp != FLOAT && comp != HALF) {
+            ImageFormat format = (img.numChannels() == 4) ? IMGFMT_RGBA32F : IMGFMT_RGB32F;
+            if (!img.convert(format, !isHDR(img.format())))
+                return false;
+        }
+
+        return img.saveImage(filePath);
+    }
+}
+
+FrameCapture::FrameCapture() : _toneOp(REINHART), _failures(0) {
+    memset(&_toneParams, 0, sizeof(RendererBuffer));
+
+    _toneParams.gamma = 2.2f;
+    _toneParams.exp   = 1.0f;
+}
+
+FrameCapture::~FrameCapture() {
+
+}
+
+FrameCapture& FrameCapture::get() {
+    static FrameCapture capture;
+    return capture;
+}
+
+bool FrameCapture::readPixels(int32 x, int32 y, int32 w, int32 h, ImageFormat format, const CaptureDone& done) {
+    return read(format, w, h, done, [=]() {
+        RHI.readPixels(x, y, w, h, format, nullptr);
+    });
+}
+
+bool FrameCapture::readTexture(RRID id, uint32 level, const CaptureDone& done) {
+    sref<Texture> tex = RHI.getTexture(id);
+    if (!tex)
+        return false; // Error
+
+    TexFormat fmt = tex->format();
+    if (fmt.imgType != IMGTYPE_2D || level >= fmt.levels || isCompressed(fmt.imgFmt))
+        return false;
+
+    int32 w = mipDimension(tex->width(),  level);
+    int32 h = mipDimension(tex->height(), level);
+
+    return read(fmt.imgFmt, w, h, done, [=]() {
+        RHI.readTextureLevel(id, level, nullptr);
+    });
+}
+
+bool FrameCapture::saveFramebuffer(const std::string& filePath, int32 x, int32 y, int32 w, int32 h,
+                                   ImageFormat format) {
+    ToneOperator   op     = _toneOp;
+    RendererBuffer params = _toneParams;
+
+    return readPixels(x, y, w, h, format, [=](Image& img) {
+        return saveCapture(img, filePath, op, params);
+    });
+}
+
+bool FrameCapture::saveTexture(const std::string& filePath, RRID id, uint32 level) {
+    ToneOperator   op     = _toneOp;
+    RendererBuffer params = _toneParams;
+
+    return readTexture(id, level, [=](Image& img) {
+        return saveCapture(img, filePath, op, params);
+    });
+}
+
+void FrameCapture::setToneMapping(ToneOperator op, const RendererBuffer& params) {
+    _toneOp     = op;
+    _toneParams = params;
+}
+
+void FrameCapture::update() {
+    if (!_reads.empty() || !_tasks.empty())
+        process(false);
+}
+
+void FrameCapture::flush() {
+    while (!_reads.empty() || !_tasks.empty())
+        process(true);
+}
+
+bool FrameCapture::isIdle() const {
+    return _reads.empty() && _tasks.empty();
+}
+
+uint32 FrameCapture::takeFailures() {
+    uint32 failures = _failures;
+    _failures = 0;
+
+    return failures;
+}
+
+void FrameCapture::cleanup() {
+    flush();
+
+    for (const auto& buffer : _buffers)
+        glDeleteBuffers(1, &buffer.first);
+
+    _buffers.clear();
+}
+
+bool FrameCapture::read(ImageFormat format, int32 w, int32 h, const CaptureDone& done,
+                        const std::function<void()>& issue) {
+    if (w <= 0 || h <= 0 || isCompressed(format) || format == IMGFMT_UNKNOWN)
+        return false;
+
+    Readback read;
+    read.format = format;
+    read.width  = w;
+    read.height = h;
+    read.done   = done;
+
+    uint64 size = levelSize(format, w, h, 1);
+
+    // The smallest idle buffer that fits is reused
+    auto best = _buffers.end();
+    for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+        if (it->second >= size && (best == _buffers.end() || it->second < best->second))
+            best = it;
+    }
+
+    if (best != _buffers.end()) {
+        read.buffer   = best->first;
+        read.capacity = best->second;
+        _buffers.erase(best);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+    } else {
+        read.capacity = size;
+
+        glGenBuffers(1, &read.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_READ);
+    }
+
+    // Reads into the bound buffer return right away
+    issue();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    read.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    _reads.push_back(std::move(read));
+
+    return true;
+}
+
+void FrameCapture::process(bool wait) {
+    for (Readback& read : _reads) {
+        if (!read.fence)
+            continue;
+
+        // Reads finish in order, the ones after a pending read are too
+        GLenum status = glClientWaitSync(read.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(read.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+
+        glDeleteSync(read.fence);
+        read.fence = nullptr;
+
+        uint64 size = levelSize(read.format, read.width, read.height, 1);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+        const uint8* pixels = (const uint8*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size,
+                                                              GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (!pixels) {
+            _failures++;
+            continue; // Error
+        }
+
+        // The pixels are copied out by the worker, the buffer stays
+        // mapped meanwhile
+        sref<std::promise<void>> copied = make_sref<std::promise<void>>();
+        read.copied = copied->get_future();
+
+        ImageFormat format = read.format;
+        int32 w = read.width;
+        int32 h = read.height;
+        CaptureDone done = read.done;
+
+        _tasks.push_back(Workers.enqueue([=]() {
+            Image img;
+            img.init(format, w, h, 1, 1);
+            memcpy(img.data(), pixels, (size_t)img.size());
+
+            copied->set_value();
+
+            return done(img);
+        }));
+    }
+
+    // Buffers go back to the pool once the workers copied them out
+    while (!_reads.empty() && !_reads.front().fence) {
+        Readback& read = _reads.front();
+        if (read.copied.valid()) {
+            if (!wait && read.copied.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                break;
+
+            read.copied.wait();
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        releaseBuffer(read.buffer, read.capacity);
+        _reads.pop_front();
+    }
+
+    while (!_tasks.empty()) {
+        std::future<bool>& task = _tasks.front();
+        if (!wait && task.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            break;
+
+        if (!task.get())
+            _failures++;
+
+        _tasks.pop_front();
+    }
+}
+
+void FrameCapture::releaseBuffer(GLuint buffer, uint64 capacity) {
+    if (_buffers.size() >= MAX_IDLE_BUFFERS) {
+        glDeleteBuffers(1, &buffer);
+        return;
+    }
+
+    _buffers.emplace_back(buffer, capacity);
+}
@@ -0,0 +1,102 @@
+#ifndef __PBR_FRAMECAPTURE_H__
+#define __PBR_FRAMECAPTURE_H__
+
+#include <deque>
+#include <future>
+#include <functional>
+
+#include <RenderInterface.h>
+#include <Renderer.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: Capture.saveFramebuffer("snapshot.png", 0, 0, width, height);
+#define Capture FrameCapture::get()
+
+namespace pbr {
+
+    // Called on a worker thread with the pixels read back, rows bottom up
+    // as OpenGL returns them. Returns false if the capture failed.
+    using CaptureDone = std::function<bool(Image&)>;
+
+    // Reads pixels back without stalling the render loop. Reads go into
+    // pixel pack buffers that are only mapped once the GPU is done with
+    // them, usually a frame or two later, and the pixels are processed
+    // on the worker threads from then on.
+    class FrameCapture {
+    public:
+        ~FrameCapture();
+
+        static FrameCapture& get();
+
+        // Reads a region of the read framebuffer
+        bool readPixels(int32 x, int32 y, int32 w, int32 h, ImageFormat format, const CaptureDone& done);
+
+        // Reads a level of an uncompressed 2D texture
+        bool readTexture(RRID id, uint32 level, const CaptureDone& done);
+
+        // Saves the pixels upright to filePath, in the format of its
+        // extension: png, img, hdr or exr. HDR pixels are tone mapped for
+        // png files, and 8-bit ones are decoded from sRGB for hdr and exr.
+        bool saveFramebuffer(const std::string& filePath, int32 x, int32 y, int32 w, int32 h,
+                             ImageFormat format = IMGFMT_RGB8);
+        bool saveTexture(const std::string& filePath, RRID id, uint32 level = 0);
+
+        // Tone curve of the png files saved from then on
+        void setToneMapping(ToneOperator op, const RendererBuffer& params);
+
+        // Hands the reads the GPU is done with to the workers, from the
+        // main thread
+        void update();
+
+        // Waits for every capture to be read and processed
+        void flush();
+
+        bool isIdle() const;
+
+        // Captures that failed since the last call
+        uint32 takeFailures();
+
+        void cleanup();
+
+    private:
+        FrameCapture();
+
+        struct Readback {
+            GLuint buffer;
+            uint64 capacity;
+            GLsync fence;
+
+            ImageFormat format;
+            int32 width;
+            int32 height;
+
+            CaptureDone done;
+
+            // Ready once a worker copied the pixels out of the mapping
+            std::future<void> copied;
+        };
+
+        // Maps the finished reads and unmaps the ones already copied.
+        // With wait, the GPU and the workers are waited for.
+        void process(bool wait);
+
+        bool read(ImageFormat format, int32 w, int32 h, const CaptureDone& done,
+                  const std::function<void()>& issue);
+
+        void releaseBuffer(GLuint buffer, uint64 capacity);
+
+        std::deque<Readback> _reads;
+        std::deque<std::future<bool>> _tasks;
+
+        // Idle pack buffers and their sizes
+        std::vector<std::pair<GLuint, uint64>> _buffers;
+
+        ToneOperator   _toneOp;
+        RendererBuffer _toneParams;
+
+        uint32 _failures;
+    };
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include <PosterRenderer.h>
+
+#include <future>
+
+#include <Renderer.h>
+#include <Camera.h>
+#include <RenderInterface.h>
+#include <PixelAllocator.h>
+#include <PNGWriter.h>
+#include <ThreadPool.h>
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR int32  DEFAULT_TILE_SIZE = 1024;
+    static PBR_CONSTEXPR uint32 DEFAULT_SAMPLES   = 4;
+}
+
+PosterRenderer::PosterRenderer() : _tileSize(DEFAULT_TILE_SIZE), _samples(DEFAULT_SAMPLES),
+    _renderFbo(0), _resolveFbo(0), _buffers{ 0, 0, 0 } {
+
+}
+
+void PosterRenderer::setTileSize(int32 size) {
+    _tileSize = std::max(size, 1);
+}
+
+void PosterRenderer::setSamples(uint32 samples) {
+    _samples = samples;
+}
+
+bool PosterRenderer::render(Renderer& renderer, const Scene& scene, const Camera& camera,
+                            const std::string& filePath, int32 width, int32 height) {
+    if (width <= 0 || height <= 0)
+        return false;
+
+    GLint maxSize, maxSamples, maxDims[2];
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxDims);
+
+    int32 tileSize = std::min(std::min(_tileSize, (int32)maxSize), std::min(maxDims[0], maxDims[1]));
+    tileSize = std::min(tileSize, std::max(width, height));
+
+    uint32 samples = std::min(_samples, (uint32)maxSamples);
+
+    PNGWriter png;
+    if (!png.open(filePath, width, height, 3))
+        return false; // Error
+
+    // Restored once done
+    GLint drawFbo, readFbo, viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    if (!createTargets(tileSize, samples)) {
+        deleteTargets();
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+        return false; // Error
+    }
+
+    // Tiles are read side by side into a stripe of the full width
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+
+    uint64 rowSize = (uint64)width * 3;
+    PixelBuffer stripes[2] = { Pixels.allocate(rowSize * tileSize), Pixels.allocate(rowSize * tileSize) };
+
+    // Encoding of the previous stripe, rows must reach the png in order
+    std::future<bool> encoding;
+    bool success = true;
+
+    Camera tileCam = camera;
+
+    // Bands of tiles from the top, as png rows go
+    uint32 band = 0;
+    for (int32 top = height; top > 0; top -= tileSize, band++) {
+        int32 bottom = std::max(top - tileSize, 0);
+        int32 rows   = top - bottom;
+
+        uint8* stripe = stripes[band % 2].get();
+
+        for (int32 x = 0; x < width; x += tileSize) {
+            int32 cols = std::min(tileSize, width - x);
+
+            tileCam.setProjMatrix(camera.regionProjMatrix((float)x / width, (float)bottom / height,
+                                                          (float)(x + cols) / width, (float)top / height));
+
+            glBindFramebuffer(GL_FRAMEBUFFER, _renderFbo);
+            glViewport(0, 0, cols, rows);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            renderer.render(scene, tileCam);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _resolveFbo);
+            glBlitFramebuffer(0, 0, cols, rows, 0, 0, cols, rows, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, _resolveFbo);
+            RHI.readPixels(0, 0, cols, rows, IMGFMT_RGB8, stripe + (uint64)x * 3);
+        }
+
+        if (encoding.valid() && !encoding.get()) {
+            success = false;
+            break;
+        }
+
+        // OpenGL rows start at the bottom
+        encoding = Workers.enqueue([&png, stripe, rows, rowSize]() {
+            for (int32 r = rows - 1; r >= 0; --r) {
+                if (!png.writeRow(stripe + r * rowSize))
+                    return false;
+            }
+
+            return true;
+        });
+    }
+
+    if (encoding.valid() && !encoding.get())
+        success = false;
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    deleteTargets();
+
+    return png.close() && success;
+}
+
+bool PosterRenderer::createTargets(int32 tileSize, uint32 samples) {
+    glGenRenderbuffers(3, _buffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _buffers[0]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, tileSize, tileSize);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _buffers[1]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, tileSize, tileSize);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _buffers[2]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, tileSize, tileSize);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_renderFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _renderFbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _buffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, _buffers[1]);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &_resolveFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _resolveFbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _buffers[2]);
+
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return complete;
+}
+
+void PosterRenderer::deleteTargets() {
+    glDeleteFramebuffers(1, &_renderFbo);
+    glDeleteFramebuffers(1, &_resolveFbo);
+    glDeleteRenderbuffers(3, _buffers);
+
+    _renderFbo  = 0;
+    _resolveFbo = 0;
+    _buffers[0] = _buffers[1] = _buffers[2] = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __PBR_POSTERRENDERER_H__
+#define __PBR_POSTERRENDERER_H__
+
+#include <GL/glew.h>
+
+#include <PBR.h>
+
+namespace pbr {
+
+    class Scene;
+    class Camera;
+    class Renderer;
+
+    // Renders stills larger than the framebuffer and the GPU memory allow.
+    // The view of the camera is split in tiles, each rendered offscreen
+    // with its part of the projection. Rows of tiles are compressed to a
+    // png on a worker while the next one renders, so only two of them are
+    // ever in memory.
+    class PosterRenderer {
+    public:
+        PosterRenderer();
+
+        // Clamped to the renderbuffer and viewport limits. 1024 by default.
+        void setTileSize(int32 size);
+
+        // Multisamples of each tile, clamped to the GPU limit. 4 by default.
+        void setSamples(uint32 samples);
+
+        // Pixels are stretched unless width and height keep the aspect of
+        // the camera
+        bool render(Renderer& renderer, const Scene& scene, const Camera& camera,
+                    const std::string& filePath, int32 width, int32 height);
+
+    private:
+        bool createTargets(int32 tileSize, uint32 samples);
+        void deleteTargets();
+
+        int32  _tileSize;
+        uint32 _samples;
+
+        // Tile rendered multisampled, then resolved to be read back
+        GLuint _renderFbo;
+        GLuint _resolveFbo;
+        GLuint _buffers[3];
+    };
+
+}
+
+#endif
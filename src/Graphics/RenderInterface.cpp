@@ -6,8 +6,10 @@
 #include <Utils.h>
 
 #include <Image.h>
+#include <PixelOps.h>
 #include <Texture.h>
 #include <Resources.h>
+#include <IBL.h>
 
 #include <Renderer.h>
 
@@ -69,15 +71,15 @@ const GLenum OGLTexSizedFormats[] = {
     GL_RGBA16,
 
     // Signed IMGFMTs
-    GL_R8I,
-    GL_RG8I,
-    GL_RGB8I,
-    GL_RGBA8I,
+    GL_R8_SNORM,
+    GL_RG8_SNORM,
+    GL_RGB8_SNORM,
+    GL_RGBA8_SNORM,
 
-    GL_R16I,
-    GL_RG16I,
-    GL_RGB16I,
-    GL_RGBA16I,
+    GL_R16_SNORM,
+    GL_RG16_SNORM,
+    GL_RGB16_SNORM,
+    GL_RGBA16_SNORM,
 
     // Float IMGFMTs
     GL_R16F,
@@ -112,27 +114,27 @@ const GLenum OGLTexSizedFormats[] = {
     GL_RGB32UI,
     GL_RGBA32UI,
 
-    // Packed formats
-    0,
-    0,
-    0,
-    0,
-    0,
+    // Packed formats, RGBE8 has no GL equivalent
     0,
+    GL_RGB9_E5,
+    GL_R11F_G11F_B10F,
+    GL_RGB565,
+    GL_RGBA4,
+    GL_RGB10_A2,
 
     // Depth IMGFMTs
     GL_DEPTH_COMPONENT16,
     GL_DEPTH_COMPONENT24,
     GL_DEPTH24_STENCIL8,
-    GL_DEPTH_COMPONENT32,
+    GL_DEPTH_COMPONENT32F,
 
     // Compressed IMGFMTs
-    0,
-    0,
-    0,
-    0,
-    0,
-    0
+    GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+    GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+    GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+    GL_COMPRESSED_RED_RGTC1,
+    GL_COMPRESSED_RG_RGTC2,
+    GL_COMPRESSED_RGBA_BPTC_UNORM
 };
 
 const GLenum OGLTexPixelFormats[] = {
@@ -172,34 +174,34 @@ const GLenum OGLTexPixelFormats[] = {
     GL_RGBA,
 
     // Signed integer IMGFMTs
-    GL_RED,
-    GL_RG,
-    GL_RGB,
-    GL_RGBA,
+    GL_RED_INTEGER,
+    GL_RG_INTEGER,
+    GL_RGB_INTEGER,
+    GL_RGBA_INTEGER,
 
-    GL_RED,
-    GL_RG,
-    GL_RGB,
-    GL_RGBA,
+    GL_RED_INTEGER,
+    GL_RG_INTEGER,
+    GL_RGB_INTEGER,
+    GL_RGBA_INTEGER,
 
     // Unsigned integer IMGFMTs
-    GL_RED,
-    GL_RG,
-    GL_RGB,
-    GL_RGBA,
+    GL_RED_INTEGER,
+    GL_RG_INTEGER,
+    GL_RGB_INTEGER,
+    GL_RGBA_INTEGER,
 
-    GL_RED,
-    GL_RG,
-    GL_RGB,
-    GL_RGBA,
+    GL_RED_INTEGER,
+    GL_RG_INTEGER,
+    GL_RGB_INTEGER,
+    GL_RGBA_INTEGER,
 
     // Packed IMGFMTs
     0,
-    0,
-    0,
-    0,
-    0,
-    0,
+    GL_RGB,
+    GL_RGB,
+    GL_RGB,
+    GL_RGBA,
+    GL_RGBA,
 
     // Depth IMGFMTs
     GL_DEPTH_COMPONENT,
@@ -217,25 +219,84 @@ const GLenum OGLTexPixelFormats[] = {
 };
 
 const GLenum OGLTexPixelTypes[] = {
+    0,
+
+    // Unsigned IMGFMTs
     GL_UNSIGNED_BYTE,
-    GL_BYTE,
+    GL_UNSIGNED_BYTE,
+    GL_UNSIGNED_BYTE,
+    GL_UNSIGNED_BYTE,
+
+    GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_SHORT,
     GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_SHORT,
+
+    // Signed IMGFMTs
+    GL_BYTE,
+    GL_BYTE,
+    GL_BYTE,
+    GL_BYTE,
+
     GL_SHORT,
-    GL_UNSIGNED_INT,
-    GL_INT,
+    GL_SHORT,
+    GL_SHORT,
+    GL_SHORT,
+
+    // Float IMGFMTs
+    GL_HALF_FLOAT,
+    GL_HALF_FLOAT,
+    GL_HALF_FLOAT,
+    GL_HALF_FLOAT,
+
     GL_FLOAT,
-    GL_UNSIGNED_BYTE_3_3_2,
-    GL_UNSIGNED_BYTE_2_3_3_REV,
+    GL_FLOAT,
+    GL_FLOAT,
+    GL_FLOAT,
+
+    // Signed integer IMGFMTs
+    GL_SHORT,
+    GL_SHORT,
+    GL_SHORT,
+    GL_SHORT,
+
+    GL_INT,
+    GL_INT,
+    GL_INT,
+    GL_INT,
+
+    // Unsigned integer IMGFMTs
+    GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_SHORT,
+
+    GL_UNSIGNED_INT,
+    GL_UNSIGNED_INT,
+    GL_UNSIGNED_INT,
+    GL_UNSIGNED_INT,
+
+    // Packed IMGFMTs
+    0,
+    GL_UNSIGNED_INT_5_9_9_9_REV,
+    GL_UNSIGNED_INT_10F_11F_11F_REV,
     GL_UNSIGNED_SHORT_5_6_5,
-    GL_UNSIGNED_SHORT_5_6_5_REV,
     GL_UNSIGNED_SHORT_4_4_4_4,
-    GL_UNSIGNED_SHORT_4_4_4_4_REV,
-    GL_UNSIGNED_SHORT_5_5_5_1,
-    GL_UNSIGNED_SHORT_1_5_5_5_REV,
-    GL_UNSIGNED_INT_8_8_8_8,
-    GL_UNSIGNED_INT_8_8_8_8_REV,
-    GL_UNSIGNED_INT_10_10_10_2,
-    GL_UNSIGNED_INT_2_10_10_10_REV
+    GL_UNSIGNED_INT_2_10_10_10_REV,
+
+    // Depth IMGFMTs
+    GL_UNSIGNED_SHORT,
+    GL_UNSIGNED_INT,
+    GL_UNSIGNED_INT_24_8,
+    GL_FLOAT,
+
+    // Compressed IMGFMTs
+    0,
+    0,
+    0,
+    0,
+    0,
+    0
 };
 
 const GLenum OGLTexFilters[] = { 
@@ -256,7 +317,96 @@ const GLenum OGLTexWrapping[] = {
 
 using namespace pbr;
 
-RenderInterface::RenderInterface() {
+ImageFormat pbr::uploadFormat(ImageFormat format) {
+    if (format == IMGFMT_RGBE8)
+        return IMGFMT_RGB9E5;
+
+    return format;
+}
+
+namespace {
+    void texImage(GLenum target, ImageType type, uint32 lvl, ImageFormat format,
+                  uint32 w, uint32 h, uint32 d, uint64 size, const void* pixels) {
+        GLenum intFmt = OGLTexSizedFormats[format];
+        GLenum pFmt   = OGLTexPixelFormats[format];
+        GLenum pType  = OGLTexPixelTypes[format];
+
+        if (isCompressed(format)) {
+            if (type == IMGTYPE_3D)
+                glCompressedTexImage3D(target, lvl, intFmt, w, h, d, 0, (GLsizei)size, pixels);
+            else
+                glCompressedTexImage2D(target, lvl, intFmt, w, h, 0, (GLsizei)size, pixels);
+        } else if (type == IMGTYPE_1D)
+            glTexImage1D(target, lvl, intFmt, w, 0, pFmt, pType, pixels);
+        else if (type == IMGTYPE_3D)
+            glTexImage3D(target, lvl, intFmt, w, h, d, 0, pFmt, pType, pixels);
+        else
+            glTexImage2D(target, lvl, intFmt, w, h, 0, pFmt, pType, pixels);
+    }
+
+    // Writes a whole level of a texture that already has storage for it.
+    // Formats the GPU does not take are converted in strips of rows, so
+    // no converted copy of the level is ever made.
+    void texSubImage(GLenum target, ImageType type, uint32 lvl, ImageFormat format,
+                     uint32 w, uint32 h, uint32 d, uint64 size, const uint8* pixels) {
+        static PBR_CONSTEXPR uint32 STRIP_SIZE = 1 << 16; // In pixels
+
+        ImageFormat gpuFormat = uploadFormat(format);
+
+        GLenum pFmt  = OGLTexPixelFormats[gpuFormat];
+        GLenum pType = OGLTexPixelTypes[gpuFormat];
+
+        if (gpuFormat == format) {
+            if (isCompressed(format)) {
+                GLenum intFmt = OGLTexSizedFormats[format];
+                if (type == IMGTYPE_3D)
+                    glCompressedTexSubImage3D(target, lvl, 0, 0, 0, w, h, d, intFmt, (GLsizei)size, pixels);
+                else
+                    glCompressedTexSubImage2D(target, lvl, 0, 0, w, h, intFmt, (GLsizei)size, pixels);
+            } else if (type == IMGTYPE_1D)
+                glTexSubImage1D(target, lvl, 0, w, pFmt, pType, pixels);
+            else if (type == IMGTYPE_3D)
+                glTexSubImage3D(target, lvl, 0, 0, 0, w, h, d, pFmt, pType, pixels);
+            else
+                glTexSubImage2D(target, lvl, 0, 0, w, h, pFmt, pType, pixels);
+
+            return;
+        }
+
+        uint64 rowSize   = (uint64)w * formatToBytesPerPixel(format);
+        uint32 stripRows = std::max(STRIP_SIZE / w, 1u);
+        std::vector<uint8> strip((size_t)stripRows * w * formatToBytesPerPixel(gpuFormat));
+
+        for (uint32 z = 0; z < d; ++z) {
+            for (uint32 y = 0; y < h; y += stripRows) {
+                uint32 rows = std::min(stripRows, h - y);
+                convertRow(format, pixels + ((uint64)z * h + y) * rowSize, gpuFormat, &strip[0], w * rows);
+
+                if (type == IMGTYPE_1D)
+                    glTexSubImage1D(target, lvl, 0, w, pFmt, pType, &strip[0]);
+                else if (type == IMGTYPE_3D)
+                    glTexSubImage3D(target, lvl, 0, y, z, w, rows, 1, pFmt, pType, &strip[0]);
+                else
+                    glTexSubImage2D(target, lvl, 0, y, w, rows, pFmt, pType, &strip[0]);
+            }
+        }
+    }
+
+    // Uploads one level, allocating its storage
+    void uploadLevel(GLenum target, ImageType type, uint32 lvl, ImageFormat format,
+                     uint32 w, uint32 h, uint32 d, uint64 size, const uint8* pixels) {
+        ImageFormat gpuFormat = uploadFormat(format);
+        if (gpuFormat == format) {
+            texImage(target, type, lvl, format, w, h, d, size, pixels);
+            return;
+        }
+
+        texImage(target, type, lvl, gpuFormat, w, h, d, 0, nullptr);
+        texSubImage(target, type, lvl, format, w, h, d, size, pixels);
+    }
+}
+
+RenderInterface::RenderInterface() : _ggxProgram(-1), _brdfProgram(-1) {
 
 }
 
@@ -272,12 +422,60 @@ RenderInterface& RenderInterface::get() {
 void RenderInterface::initialize() {
     _programs.push_back({ 0 });
     _currProgram = 0;
+
+    // Image rows are tightly packed, whatever their width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ALIGNMENT,   1);
     
-    // Load BRDF precomputation
-    TexSampler brdfSampler;
-    Image brdf;
-    brdf.loadImage("PBR/brdf.img");
-    RRID brdfId = createTexture(brdf, brdfSampler);
+    // Load IBL precomputation shaders. Drivers that fail to build them
+    // fall back to the CPU bakes.
+    if (isComputeSupported()) {
+        ShaderSource csIBL (COMPUTE_SHADER, "ibl.cs");
+        ShaderSource csGGX (COMPUTE_SHADER, "ggx.cs");
+        ShaderSource csBRDF(COMPUTE_SHADER, "brdf.cs");
+
+        if (csIBL.id() != 0 && csGGX.id() != 0) {
+            sref<Shader> ggxProg = make_sref<Shader>("ggx");
+            ggxProg->addShader(csGGX);
+            ggxProg->addShader(csIBL);
+            if (ggxProg->link()) {
+                Resource.addShader("ggx", ggxProg);
+                _ggxProgram = ggxProg->id();
+            }
+        }
+
+        if (csIBL.id() != 0 && csBRDF.id() != 0) {
+            sref<Shader> brdfProg = make_sref<Shader>("brdf");
+            brdfProg->addShader(csBRDF);
+            brdfProg->addShader(csIBL);
+            if (brdfProg->link()) {
+                Resource.addShader("brdf", brdfProg);
+                _brdfProgram = brdfProg->id();
+            }
+        }
+    }
+
+    // BRDF precomputation, integrated on the GPU when it can. Otherwise it
+    // is loaded from disk, and integrated again when its parameters change.
+    RRID brdfId = integrateBRDF();
+    if (brdfId == -1) {
+        TexSampler brdfSampler;
+        brdfSampler.setFilterMode(FILTER_LINEAR, FILTER_LINEAR);
+        brdfSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+
+        std::string brdfPath = brdfCachePath("PBR", BRDF_LUT_SIZE, IMGFMT_RG16F);
+
+        Image brdf;
+        if (!brdf.loadImage(brdfPath) || brdf.format() != IMGFMT_RG16F) {
+            std::cout << "[INFO] Integrating BRDF table..." << std::endl;
+
+            if (pbr::integrateBRDF(brdf, BRDF_LUT_SIZE, IMGFMT_RG16F))
+                brdf.saveImage(brdfPath);
+        }
+
+        brdfId = createTexture(brdf, brdfSampler);
+    }
+
     Resource.addTexture("brdf", RHI.getTexture(brdfId));
         
     // Load standard engine shaders
@@ -291,16 +489,17 @@ void RenderInterface::initialize() {
     unrealProg->addShader(vsUnreal);
     unrealProg->addShader(fsUnreal);
     unrealProg->addShader(fsCommon);
-    unrealProg->link();
+    if (!unrealProg->link())
+        Utils::throwError("Could not link program unreal");
     Resource.addShader("unreal", unrealProg);
 
     RHI.useProgram(unrealProg->id());
-    RHI.setSampler("irradianceTex", 6);
-    RHI.setSampler("ggxTex",        7);
-    RHI.setSampler("brdfTex",       8);
+    RHI.setSampler("ggxTex",  7);
+    RHI.setSampler("brdfTex", 8);
     RHI.setBufferBlock("cameraBlock",   CAMERA_BUFFER_IDX);
     RHI.setBufferBlock("rendererBlock", RENDERER_BUFFER_IDX);
     RHI.setBufferBlock("lightBlock",    LIGHTS_BUFFER_IDX);
+    RHI.setBufferBlock("shBlock",       SH_BUFFER_IDX);
     RHI.useProgram(0);
 
     // Load environment shader
@@ -310,7 +509,8 @@ void RenderInterface::initialize() {
     skyProg->addShader(vsSkybox);
     skyProg->addShader(fsSkybox);
     skyProg->addShader(fsCommon);
-    skyProg->link();
+    if (!skyProg->link())
+        Utils::throwError("Could not link program skybox");
 
     Resource.addShader("skybox", skyProg);
 
@@ -326,6 +526,99 @@ void RenderInterface::initialize() {
     RHI.bindTexture(brdfId);
 }
 
+bool RenderInterface::isComputeSupported() const {
+    // Compute shaders are written in GLSL 4.20 with the extension
+    return GLEW_VERSION_4_2 && GLEW_ARB_compute_shader;
+}
+
+void RenderInterface::bindImage(uint32 unit, RRID id, uint32 level) {
+    if (id < 0 || id >= _textures.size())
+        return; // Error
+
+    RHITexture ogltex = _textures[id];
+    if (ogltex.id == 0)
+        return; // Error
+
+    GLboolean layered = (ogltex.target == GL_TEXTURE_CUBE_MAP) ? GL_TRUE : GL_FALSE;
+    glBindImageTexture(unit, ogltex.id, level, layered, 0, GL_WRITE_ONLY, ogltex.intFormat);
+}
+
+void RenderInterface::dispatchCompute(uint32 x, uint32 y, uint32 z) {
+    glDispatchCompute(x, y, z);
+}
+
+RRID RenderInterface::prefilterGGX(const Cubemap& env, uint32 size, uint32 numLevels, uint32 numSamples) {
+    if (!isComputeSupported() || _ggxProgram == -1 ||
+        env.width() <= 0 || size == 0 || numSamples == 0)
+        return -1;
+
+    numLevels = std::min(numLevels, maxMipLevels(size, size));
+
+    // Source with its whole mip chain, so samples read the level that
+    // matches their solid angle
+    TexSampler envSampler;
+    envSampler.setFilterMode(FILTER_LINEAR_MIP_LINEAR, FILTER_LINEAR);
+    envSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+
+    RRID envTex = createCubemap(env, envSampler);
+    generateMipmaps(envTex);
+
+    TexSampler ggxSampler;
+    ggxSampler.setFilterMode(FILTER_LINEAR_MIP_LINEAR, FILTER_LINEAR);
+    ggxSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+
+    RRID ggxTex = allocateTexture(IMGTYPE_CUBE, IMGFMT_RGBA16F, size, size, 1, numLevels, ggxSampler);
+
+    useProgram(_ggxProgram);
+    bindTexture(0, envTex);
+
+    setFloat("envSize",    (float)env.width());
+    setFloat("minLod",     std::max(std::log2((float)env.width() / size), 0.0f));
+    setFloat("numSamples", (float)numSamples);
+
+    // Levels only read envMap, so they are dispatched back to back
+    for (uint32 lvl = 0; lvl < numLevels; ++lvl) {
+        uint32 w = mipDimension(size, lvl);
+
+        setFloat("roughness", ggxLevelRoughness(lvl, numLevels));
+        setFloat("levelSize", (float)w);
+
+        bindImage(0, ggxTex, lvl);
+        dispatchCompute((w + 7) / 8, (w + 7) / 8, 6);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    useProgram(0);
+    deleteTexture(envTex);
+
+    return ggxTex;
+}
+
+RRID RenderInterface::integrateBRDF(uint32 size, uint32 numSamples) {
+    if (!isComputeSupported() || _brdfProgram == -1 || size == 0 || numSamples == 0)
+        return -1;
+
+    TexSampler brdfSampler;
+    brdfSampler.setFilterMode(FILTER_LINEAR, FILTER_LINEAR);
+    brdfSampler.setWrapMode(WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE, WRAP_CLAMP_EDGE);
+
+    RRID lutTex = allocateTexture(IMGTYPE_2D, IMGFMT_RG16F, size, size, 1, 1, brdfSampler);
+
+    useProgram(_brdfProgram);
+    setFloat("lutSize",    (float)size);
+    setFloat("numSamples", (float)numSamples);
+
+    bindImage(0, lutTex, 0);
+    dispatchCompute((size + 7) / 8, (size + 7) / 8, 1);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    useProgram(0);
+
+    return lutTex;
+}
+
 RRID RenderInterface::uploadGeometry(const sref<Geometry>& geo) {
     auto verts   = geo->vertices();
     auto indices = geo->indices();
@@ -532,7 +825,7 @@ uint32 RenderInterface::compileShader(const ShaderSource& source) {
     // Cleanup the shader
     glDeleteShader(id);
 
-    return id;
+    return 0;
 }
 
 bool RenderInterface::deleteShader(const ShaderSource& source) {
@@ -569,7 +862,7 @@ RRID RenderInterface::linkProgram(const Shader& shader) {
     if (res != GL_TRUE) {
         // Check program log for the error and print it
         std::string message = getProgramError(shader);
-        Utils::throwError(message);
+        std::cerr << "Program " << shader.name() << " link log:\n" << message;
 
         // Detach shaders
         for (GLuint sid : shader.shaders())
@@ -578,7 +871,7 @@ RRID RenderInterface::linkProgram(const Shader& shader) {
         // Delete the program
         glDeleteProgram(id);
 
-        return false;
+        return -1;
     }
 
     // Detach shaders after successful linking
@@ -701,7 +994,7 @@ bool RenderInterface::isOpenGLError() {
     return isError;
 }
 
-RRID RenderInterface::createTexture(const Image& img, const TexSampler& sampler) {
+RRID RenderInterface::createTexture(const ImageView& img, const TexSampler& sampler) {
     GLuint id = 0;
     GLenum target = OGLTexTargets[img.type()];
 
@@ -710,8 +1003,7 @@ RRID RenderInterface::createTexture(const Image& img, const TexSampler& sampler)
     glGenTextures(1, &id);
     glBindTexture(target, id);
 
-    GLenum pType  = OGLTexPixelTypes[img.compType()];
-    GLenum oglFmt = OGLTexPixelFormats[img.format()];
+    ImageFormat gpuFormat = uploadFormat(img.format());
 
     // Upload all levels
     ImageType type = img.type();
@@ -720,14 +1012,11 @@ RRID RenderInterface::createTexture(const Image& img, const TexSampler& sampler)
         uint32 h = mipDimension(img.height(), lvl);
         uint32 d = mipDimension(img.depth(), lvl);
 
-        if (type == IMGTYPE_2D)
-            glTexImage2D(target, lvl, oglFmt, w, h, 0, oglFmt, pType, img.data(lvl));
-        else if (type == IMGTYPE_1D)
-            glTexImage1D(target, lvl, oglFmt, w, 0, oglFmt, pType, img.data(lvl));
-        else if (type == IMGTYPE_3D)
-            glTexImage3D(target, lvl, oglFmt, w, h, d, 0, oglFmt, pType, img.data(lvl));
+        uploadLevel(target, type, lvl, img.format(), w, h, d, img.size(lvl), img.data(lvl));
     }
 
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, img.numLevels() - 1);
+
     glTexParameteri(target, GL_TEXTURE_WRAP_S,     OGLTexWrapping[sampler.sWrap()]);
     glTexParameteri(target, GL_TEXTURE_WRAP_T,     OGLTexWrapping[sampler.tWrap()]);
     glTexParameteri(target, GL_TEXTURE_WRAP_R,     OGLTexWrapping[sampler.rWrap()]);
@@ -738,14 +1027,15 @@ RRID RenderInterface::createTexture(const Image& img, const TexSampler& sampler)
     glBindTexture(target, 0);
 
     TexFormat fmt;
-    fmt.imgFmt  = img.format();
+    fmt.imgFmt  = gpuFormat;
     fmt.imgType = img.type();
     fmt.levels  = img.numLevels();
-    fmt.pType   = img.compType();
+    fmt.pType   = formatToImgComp(gpuFormat);
 
     sref<Texture> tex = make_sref<GPUTexture>(resId, img.width(), img.height(), img.depth(), sampler, fmt);
 
-    _textures.push_back({ id, target, oglFmt, oglFmt, pType, tex });
+    _textures.push_back({ id, target, OGLTexSizedFormats[gpuFormat], OGLTexPixelFormats[gpuFormat],
+                          OGLTexPixelTypes[gpuFormat], tex });
 
     return resId;
 }
@@ -791,7 +1081,7 @@ RRID RenderInterface::createTexture(ImageType type, ImageFormat fmt, uint32 widt
 
     sref<Texture> tex = make_sref<GPUTexture>(resId, width, height, depth, sampler, texFmt);
 
-    _textures.push_back({ id, target, intFormat, OGLTexPixelFormats[fmt], OGLTexPixelTypes[texFmt.pType], tex });
+    _textures.push_back({ id, target, intFormat, OGLTexPixelFormats[fmt], OGLTexPixelTypes[fmt], tex });
 
     return resId;
 }
@@ -802,27 +1092,27 @@ RRID RenderInterface::createCubemap(const Cubemap& cube, const TexSampler& sampl
 
     RRID resId = _textures.size();
 
-    GLenum pType  = OGLTexPixelTypes[cube.compType()];
-    GLenum oglFmt = OGLTexPixelFormats[cube.format()];
+    ImageFormat gpuFormat = uploadFormat(cube.format());
 
     glGenTextures(1, &id);
     glBindTexture(target, id);
     
     if (cube.numLevels() > 1) {
         glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL,  4);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL,  cube.numLevels() - 1);
         //glGenerateMipmap(target);
     }
     
     for (uint32 side = 0; side < 6; side++) {
-        const Image* img = cube.face((CubemapFace)side);
+        ImageView face = cube.view((CubemapFace)side);
 
         // Upload all levels for the face
-        for (uint32 lvl = 0; lvl < img->numLevels(); ++lvl) {
-            uint32 w = mipDimension(img->width(),  lvl);
-            uint32 h = mipDimension(img->height(), lvl);
+        for (uint32 lvl = 0; lvl < face.numLevels(); ++lvl) {
+            uint32 w = mipDimension(face.width(),  lvl);
+            uint32 h = mipDimension(face.height(), lvl);
 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, lvl, oglFmt, w, h, 0, oglFmt, pType, img->data(lvl));
+            uploadLevel(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, IMGTYPE_2D, lvl, cube.format(), w, h, 1,
+                        face.size(lvl), face.data(lvl));
         }
     }
 
@@ -836,19 +1126,277 @@ RRID RenderInterface::createCubemap(const Cubemap& cube, const TexSampler& sampl
     glBindTexture(target, 0);
 
     TexFormat fmt;
-    fmt.imgFmt  = cube.format();
+    fmt.imgFmt  = gpuFormat;
     fmt.imgType = IMGTYPE_CUBE;
     fmt.levels  = cube.numLevels();
-    fmt.pType   = cube.compType();
+    fmt.pType   = formatToImgComp(gpuFormat);
 
     sref<Texture> tex = make_sref<GPUTexture>(resId, cube.width(), cube.height(), 1, sampler, fmt);
 
-    _textures.push_back({ id, target, oglFmt, oglFmt, pType, tex });
+    _textures.push_back({ id, target, OGLTexSizedFormats[gpuFormat], OGLTexPixelFormats[gpuFormat],
+                          OGLTexPixelTypes[gpuFormat], tex });
+
+    return resId;
+}
+
+RRID RenderInterface::allocateTexture(ImageType type, ImageFormat fmt, uint32 width, uint32 height,
+                                      uint32 depth, uint32 levels, const TexSampler& sampler) {
+    GLuint id = 0;
+    GLenum target = OGLTexTargets[type];
+
+    RRID resId = _textures.size();
+
+    if (type == IMGTYPE_2D || type == IMGTYPE_CUBE) {
+        depth = 1;
+    } else if (type == IMGTYPE_1D) {
+        height = depth = 1;
+    }
+
+    ImageFormat gpuFormat = uploadFormat(fmt);
+    GLenum intFormat = OGLTexSizedFormats[gpuFormat];
+
+    glGenTextures(1, &id);
+    glBindTexture(target, id);
+
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+        if (type == IMGTYPE_1D)
+            glTexStorage1D(target, levels, intFormat, width);
+        else if (type == IMGTYPE_3D)
+            glTexStorage3D(target, levels, intFormat, width, height, depth);
+        else
+            glTexStorage2D(target, levels, intFormat, width, height);
+    } else {
+        // Mutable storage, specified level by level with no pixels
+        for (uint32 lvl = 0; lvl < levels; ++lvl) {
+            uint32 w = mipDimension(width,  lvl);
+            uint32 h = mipDimension(height, lvl);
+            uint32 d = mipDimension(depth,  lvl);
+
+            uint64 size = formatToBlockSize(gpuFormat) * ((w + 3) / 4) * ((h + 3) / 4) * d;
+
+            if (type == IMGTYPE_CUBE) {
+                for (uint32 side = 0; side < 6; ++side)
+                    texImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, IMGTYPE_2D, lvl, gpuFormat,
+                             w, h, 1, size, nullptr);
+            } else {
+                texImage(target, type, lvl, gpuFormat, w, h, d, size, nullptr);
+            }
+        }
+    }
+
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    glTexParameteri(target, GL_TEXTURE_WRAP_S,     OGLTexWrapping[sampler.sWrap()]);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T,     OGLTexWrapping[sampler.tWrap()]);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R,     OGLTexWrapping[sampler.rWrap()]);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, OGLTexFilters[sampler.minFilter()]);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, OGLTexFilters[sampler.magFilter()]);
+
+    // Unbind texture
+    glBindTexture(target, 0);
+
+    TexFormat texFmt;
+    texFmt.imgFmt  = gpuFormat;
+    texFmt.imgType = type;
+    texFmt.pType   = formatToImgComp(gpuFormat);
+    texFmt.levels  = levels;
+
+    sref<Texture> tex = make_sref<GPUTexture>(resId, width, height, depth, sampler, texFmt);
+
+    _textures.push_back({ id, target, intFormat, OGLTexPixelFormats[gpuFormat],
+                          OGLTexPixelTypes[gpuFormat], tex });
 
     return resId;
 }
 
+void RenderInterface::updateTexture(RRID id, uint32 level, uint32 y, uint32 rows, uint64 size, const void* pixels) {
+    if (id < 0 || id >= _textures.size())
+        return; // Error
+
+    RHITexture ogltex = _textures[id];
+    if (ogltex.id == 0 || ogltex.target != GL_TEXTURE_2D)
+        return; // Error
+
+    const TexFormat& fmt = ogltex.tex->format();
+    GLsizei width = mipDimension(ogltex.tex->width(), level);
+
+    glBindTexture(ogltex.target, ogltex.id);
+
+    if (isCompressed(fmt.imgFmt)) {
+        // The last block row may hang over the level
+        GLsizei height = std::min(rows, mipDimension(ogltex.tex->height(), level) - y);
+        glCompressedTexSubImage2D(ogltex.target, level, 0, y, width, height, ogltex.intFormat,
+                                  (GLsizei)size, pixels);
+    } else {
+        glTexSubImage2D(ogltex.target, level, 0, y, width, rows, ogltex.format, ogltex.pType, pixels);
+    }
+
+    glBindTexture(ogltex.target, 0);
+}
+
+bool RenderInterface::replaceTexture(RRID id, RRID with) {
+    if (id < 0 || id >= _textures.size() || with < 0 || with >= _textures.size() || id == with)
+        return false; // Error
+
+    if (_textures[with].id == 0)
+        return false; // Error
+
+    deleteTexture(id);
+
+    _textures[id] = _textures[with];
+    _textures[id].tex = make_sref<GPUTexture>(id, _textures[with].tex->width(), _textures[with].tex->height(),
+                                              _textures[with].tex->depth(), _textures[with].tex->sampler(),
+                                              _textures[with].tex->format());
+
+    _textures[with].id  = 0;
+    _textures[with].tex = nullptr;
+
+    return true;
+}
+
+bool RenderInterface::aliasTexture(RRID id, RRID target) {
+    target = resolveTexture(target);
+    if (id < 0 || id >= _textures.size() || target < 0 || target >= _textures.size() || id == target)
+        return false; // Error
+
+    if (_textures[target].id == 0)
+        return false; // Error
+
+    deleteTexture(id);
+
+    // Binds look the target up, residency may move it to new storage
+    _textureAliases[id] = target;
+
+    return true;
+}
+
+RRID RenderInterface::resolveTexture(RRID id) const {
+    auto it = _textureAliases.find(id);
+    if (it == _textureAliases.end())
+        return id;
+
+    return it->second;
+}
+
+bool RenderInterface::setResidentLevels(RRID id, const Image& source, uint32 base) {
+    if (id < 0 || id >= _textures.size() || base >= source.numLevels())
+        return false; // Error
+
+    RHITexture ogltex = _textures[id];
+    if (ogltex.id == 0 || ogltex.target != GL_TEXTURE_2D)
+        return false; // Error
+
+    GLint immutable = GL_FALSE;
+    GLint oldBase   = 0;
+
+    glBindTexture(ogltex.target, ogltex.id);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+        glGetTexParameteriv(ogltex.target, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+
+    glGetTexParameteriv(ogltex.target, GL_TEXTURE_BASE_LEVEL, &oldBase);
+
+    // Immutable storage cannot free levels, so the resident ones move to
+    // storage that starts at base, under the same id. Levels both hold
+    // are copied on the GPU, only the finer ones come from source.
+    if (immutable && (GLEW_VERSION_4_3 || GLEW_ARB_copy_image)) {
+        // Source level that level 0 of the old storage holds
+        uint32 first = 0;
+        while (first + 1 < source.numLevels() &&
+               (mipDimension(source.width(),  first) != (uint32)ogltex.tex->width() ||
+                mipDimension(source.height(), first) != (uint32)ogltex.tex->height()))
+            ++first;
+
+        uint32 oldFirst = first + oldBase;
+        uint32 width    = mipDimension(source.width(),  base);
+        uint32 height   = mipDimension(source.height(), base);
+        uint32 levels   = source.numLevels() - base;
+
+        const TexSampler& sampler = ogltex.tex->sampler();
+
+        GLuint storage = 0;
+        glGenTextures(1, &storage);
+        glBindTexture(ogltex.target, storage);
+        glTexStorage2D(ogltex.target, levels, ogltex.intFormat, width, height);
+
+        glTexParameteri(ogltex.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        glTexParameteri(ogltex.target, GL_TEXTURE_WRAP_S,     OGLTexWrapping[sampler.sWrap()]);
+        glTexParameteri(ogltex.target, GL_TEXTURE_WRAP_T,     OGLTexWrapping[sampler.tWrap()]);
+        glTexParameteri(ogltex.target, GL_TEXTURE_WRAP_R,     OGLTexWrapping[sampler.rWrap()]);
+        glTexParameteri(ogltex.target, GL_TEXTURE_MIN_FILTER, OGLTexFilters[sampler.minFilter()]);
+        glTexParameteri(ogltex.target, GL_TEXTURE_MAG_FILTER, OGLTexFilters[sampler.magFilter()]);
+
+        for (uint32 lvl = base; lvl < source.numLevels(); ++lvl) {
+            uint32 w = mipDimension(source.width(),  lvl);
+            uint32 h = mipDimension(source.height(), lvl);
+
+            if (lvl >= oldFirst)
+                glCopyImageSubData(ogltex.id, ogltex.target, lvl - first, 0, 0, 0,
+                                   storage,   ogltex.target, lvl - base,  0, 0, 0, w, h, 1);
+            else
+                texSubImage(ogltex.target, IMGTYPE_2D, lvl - base, source.format(), w, h, 1,
+                            source.size(lvl), source.data(lvl));
+        }
+
+        glBindTexture(ogltex.target, 0);
+        glDeleteTextures(1, &ogltex.id);
+
+        TexFormat texFmt = ogltex.tex->format();
+        texFmt.levels = levels;
+
+        _textures[id].id  = storage;
+        _textures[id].tex = make_sref<GPUTexture>(id, width, height, 1, sampler, texFmt);
+
+        return true;
+    }
+
+    // Finer levels are loaded before the base moves to them, so the
+    // texture is complete at all times. Immutable storage that cannot be
+    // copied keeps every level, so they are written in place.
+    for (uint32 lvl = base; lvl < (uint32)oldBase; ++lvl) {
+        uint32 w = mipDimension(source.width(),  lvl);
+        uint32 h = mipDimension(source.height(), lvl);
+
+        if (immutable)
+            texSubImage(ogltex.target, IMGTYPE_2D, lvl, source.format(), w, h, 1,
+                        source.size(lvl), source.data(lvl));
+        else
+            uploadLevel(ogltex.target, IMGTYPE_2D, lvl, source.format(), w, h, 1,
+                        source.size(lvl), source.data(lvl));
+    }
+
+    glTexParameteri(ogltex.target, GL_TEXTURE_BASE_LEVEL, base);
+
+    // Respecifying evicted levels as empty frees their memory
+    if (!immutable) {
+        ImageFormat gpuFormat = uploadFormat(source.format());
+        for (uint32 lvl = oldBase; lvl < base; ++lvl)
+            texImage(ogltex.target, IMGTYPE_2D, lvl, gpuFormat, 0, 0, 1, 0, nullptr);
+    }
+
+    glBindTexture(ogltex.target, 0);
+
+    return true;
+}
+
+bool RenderInterface::isFormatSupported(ImageFormat format) const {
+    switch (format) {
+        case IMGFMT_DXT1:
+        case IMGFMT_DXT3:
+        case IMGFMT_DXT5:
+            return GLEW_EXT_texture_compression_s3tc == GL_TRUE;
+        case IMGFMT_ATI1N:
+        case IMGFMT_ATI2N:
+            return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+        case IMGFMT_BC7:
+            return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+        default:
+            return OGLTexSizedFormats[format] != 0;
+    }
+}
+
 sref<Texture> RenderInterface::getTexture(RRID id) {
+    id = resolveTexture(id);
     if (id < 0 || id >= _textures.size())
         return nullptr; // Error
 
@@ -873,10 +1421,10 @@ bool RenderInterface::readTexture(RRID id, Image& img) {
 
     img.init(fmt.imgFmt, tex.tex->width(), tex.tex->height(), tex.tex->depth(), fmt.levels);
 
-    glBindTexture(tex.target, tex.id);
-    for (uint32 lvl = 0; lvl < fmt.levels; ++lvl)
-        glGetTexImage(tex.target, 0, tex.format, tex.pType, img.data(lvl));
-    glBindTexture(tex.target, 0);
+    for (uint32 lvl = 0; lvl < fmt.levels; ++lvl) {
+        if (!readTextureLevel(id, lvl, img.data(lvl)))
+            return false;
+    }
 
     return true;
 }
@@ -895,10 +1443,36 @@ bool RenderInterface::readCubemap(RRID id, Cubemap& cube) {
 
     cube.init(fmt.imgFmt, tex.tex->width(), tex.tex->height(), fmt.levels);
 
+    for (uint32 f = 0; f < 6; ++f) {
+        for (uint32 lvl = 0; lvl < fmt.levels; ++lvl) {
+            if (!readTextureLevel(id, lvl, cube.data((CubemapFace)f, lvl), (CubemapFace)f))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool RenderInterface::readTextureLevel(RRID id, uint32 level, void* pixels, CubemapFace face) {
+    if (id < 0 || id >= _textures.size())
+        return false; // Error
+
+    const RHITexture& tex = _textures[id];
+    if (tex.id == 0 || level >= tex.tex->format().levels)
+        return false; // Error
+
+    // Cubemaps are read a face at a time
+    GLenum target = tex.target;
+    if (target == GL_TEXTURE_CUBE_MAP)
+        target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+
     glBindTexture(tex.target, tex.id);
-    for (uint32 f = 0; f < 6; ++f)
-        for (uint32 lvl = 0; lvl < fmt.levels; ++lvl)
-            glGetTexImage(tex.target, 0, tex.format, tex.pType, cube.data((CubemapFace)f, lvl));
+
+    if (isCompressed(tex.tex->format().imgFmt))
+        glGetCompressedTexImage(target, level, pixels);
+    else
+        glGetTexImage(target, level, tex.format, tex.pType, pixels);
+
     glBindTexture(tex.target, 0);
 
     return true;
@@ -932,7 +1506,7 @@ void RenderInterface::setTextureData(RRID id, uint32 level, const void* pixels)
     GLsizei depth  = ogltex.tex->depth();
 
     const TexFormat& fmt = ogltex.tex->format();
-    GLenum type = OGLTexPixelTypes[fmt.pType];
+    GLenum type = ogltex.pType;
     if (fmt.imgType == IMGTYPE_2D)
         glTexImage2D(ogltex.target, level, ogltex.intFormat, width, height, 0, ogltex.format, type, pixels);
     else if (fmt.imgType == IMGTYPE_1D)
@@ -944,6 +1518,10 @@ void RenderInterface::setTextureData(RRID id, uint32 level, const void* pixels)
 }
 
 bool RenderInterface::deleteTexture(RRID id) {
+    // Only the name goes, the target has its own owner
+    if (_textureAliases.erase(id) > 0)
+        return true;
+
     if (id < (int64)_textures.size() && id != -1) {
         GLuint oglId = _textures[id].id;
         if (oglId != 0) {
@@ -957,6 +1535,7 @@ bool RenderInterface::deleteTexture(RRID id) {
 }
 
 void RenderInterface::bindTexture(RRID id) {
+    id = resolveTexture(id);
     if (id < 0 || id >= _textures.size())
         return; // Error
 
@@ -975,6 +1554,10 @@ void RenderInterface::bindTexture(uint32 slot, RRID id) {
 sref<Image> RenderInterface::getImage(int32 x, int32 y, int32 w, int32 h) const {
     sref<Image> img = make_sref<Image>();
     img->init(IMGFMT_RGB8, w, h, 1, 1);
-    glReadPixels(x, y, w, h, GL_RGB, GL_UNSIGNED_BYTE, img->data());
+    readPixels(x, y, w, h, IMGFMT_RGB8, img->data());
     return img;
+}
+
+void RenderInterface::readPixels(int32 x, int32 y, int32 w, int32 h, ImageFormat format, void* pixels) const {
+    glReadPixels(x, y, w, h, OGLTexPixelFormats[format], OGLTexPixelTypes[format], pixels);
 }
\ No newline at end of file
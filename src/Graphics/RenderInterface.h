@@ -1,12 +1,15 @@
 #ifndef __PBR_RI_H__
 #define __PBR_RI_H__
 
+#include <unordered_map>
+
 #include <GL/glew.h>
 
 #include <PBR.h>
 #include <PBRMath.h>
 #include <Shader.h>
 #include <Image.h>
+#include <IBL.h>
 
 // Macro to syntax sugar the singleton getter
 #define RHI RenderInterface::get()
@@ -84,6 +87,9 @@ namespace pbr {
         BufferLayoutEntry* entries;
     };
 
+    // Formats the GPU cannot sample are uploaded as the closest one it can
+    ImageFormat uploadFormat(ImageFormat format);
+
     class RenderInterface {
     public:
         ~RenderInterface();
@@ -95,15 +101,54 @@ namespace pbr {
         /* ===================================================================================
                 Textures
         =====================================================================================*/
-        RRID createTexture(const Image& img, const TexSampler& sampler);
+        // Images convert to views, so pixels are read where they are
+        RRID createTexture(const ImageView& img, const TexSampler& sampler);
         RRID createTexture(ImageType type, ImageFormat fmt, uint32 width, uint32 height,
                                     uint32 depth, const TexSampler& sampler);
         RRID createCubemap(const Cubemap& cube, const TexSampler& sampler);
 
+        // Creates a texture with storage for all levels and no contents,
+        // immutable when the context supports it. Formats are mapped with
+        // uploadFormat, so pixels given later must already be converted.
+        RRID allocateTexture(ImageType type, ImageFormat fmt, uint32 width, uint32 height,
+                             uint32 depth, uint32 levels, const TexSampler& sampler);
+
+        // Writes rows [y, y + rows) of a level of a 2D texture. Compressed
+        // textures take whole block rows. pixels is an offset into the
+        // pixel unpack buffer when one is bound.
+        void updateTexture(RRID id, uint32 level, uint32 y, uint32 rows, uint64 size, const void* pixels);
+
+        // Makes levels [base, n) of source the resident levels of a 2D
+        // texture, whose level 0 is the first level of source. Only levels
+        // that become resident are uploaded. Mutable textures move
+        // GL_TEXTURE_BASE_LEVEL and free evicted levels, immutable ones
+        // are moved on the GPU to storage that starts at base, or keep
+        // their storage and move the base when images cannot be copied.
+        bool setResidentLevels(RRID id, const Image& source, uint32 base);
+
+        // Moves the texture with into id, deleting the one id had. Users
+        // of id see the new texture from then on, and with is left empty.
+        bool replaceTexture(RRID id, RRID with);
+
+        // Makes id another name of target, deleting the texture id had.
+        // Aliases follow target when its storage is replaced or moved,
+        // and deleting one leaves target alone. target must outlive id.
+        bool aliasTexture(RRID id, RRID target);
+
+        // Texture an id names, which is id itself unless it is an alias
+        RRID resolveTexture(RRID id) const;
+
+        // Whether textures of format can be created on this context
+        bool isFormatSupported(ImageFormat format) const;
+
         sref<Texture> getTexture(RRID id);
         bool readTexture(RRID id, Image& img);
         bool readCubemap(RRID id, Cubemap& cube);
 
+        // Reads a level of a texture, or of a face of a cubemap. pixels is
+        // an offset into the pixel pack buffer when one is bound.
+        bool readTextureLevel(RRID id, uint32 level, void* pixels, CubemapFace face = CUBE_X_POS);
+
         void generateMipmaps(RRID id);
         void setTextureData(RRID id, uint32 level, const void* pixels);
         bool deleteTexture(RRID id);
@@ -140,6 +185,27 @@ namespace pbr {
         int32  uniformLocation(RRID id, const std::string& name);
         uint32 uniformBlockLocation(RRID id, const std::string& name);
 
+        /* ===================================================================================
+                Compute
+        =====================================================================================*/
+        // Whether compute shaders, and the image stores they write with, are available
+        bool isComputeSupported() const;
+
+        // Binds a level of a texture to an image unit for the current program
+        // to write. Cubemaps are bound with all of their faces.
+        void bindImage(uint32 unit, RRID id, uint32 level);
+        void dispatchCompute(uint32 x, uint32 y, uint32 z);
+
+        // GGX prefiltered RGBA16F cubemap of a float env, filtered on the
+        // GPU as prefilterGGX does on the CPU. -1 without compute support
+        // or when the compute programs failed to build.
+        RRID prefilterGGX(const Cubemap& env, uint32 size, uint32 numLevels = GGX_LEVELS,
+                          uint32 numSamples = GGX_SAMPLES);
+
+        // RG16F split-sum table, as integrateBRDF. -1 when prefilterGGX
+        // would be.
+        RRID integrateBRDF(uint32 size = BRDF_LUT_SIZE, uint32 numSamples = BRDF_SAMPLES);
+
         /* ===================================================================================
                 Geometry
         =====================================================================================*/
@@ -163,15 +229,25 @@ namespace pbr {
         void checkOpenGLError(const std::string& error);
 
         sref<Image> getImage(int32 x, int32 y, int32 w, int32 h) const;
+
+        // Reads a region of the read framebuffer, rows bottom up. pixels is
+        // an offset into the pixel pack buffer when one is bound.
+        void readPixels(int32 x, int32 y, int32 w, int32 h, ImageFormat format, void* pixels) const;
     private:
         RenderInterface();
 
         RRID _currProgram;
 
+        // IBL compute programs, -1 when they could not be built
+        RRID _ggxProgram;
+        RRID _brdfProgram;
+
         vec<RHIVertArray> _vertArrays;
         vec<RHIBuffer>    _buffers;
         vec<RHIProgram>   _programs;
         vec<RHITexture>   _textures;
+
+        std::unordered_map<RRID, RRID> _textureAliases;
     };  
 
 }
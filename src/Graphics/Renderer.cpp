@@ -7,10 +7,11 @@
 #include <Skybox.h>
 
 #include <RenderInterface.h>
+#include <IBL.h>
 
 using namespace pbr;
 
-Renderer::Renderer() : _gamma(2.4f), _exposure(3.0f), _toneParams{ 0.15f, 0.5f, 0.1f, 0.2f, 0.02f, 0.3f, 11.2f }, _drawSkybox(true) { }
+Renderer::Renderer() : _gamma(2.4f), _exposure(3.0f), _toneParams{ 0.15f, 0.5f, 0.1f, 0.2f, 0.02f, 0.3f, 11.2f }, _tone(UNCHARTED), _drawSkybox(true) { }
 
 void Renderer::setGamma(float gamma) {
     _gamma = gamma;
@@ -36,6 +37,31 @@ const float* Renderer::toneParams() const {
     return &_toneParams[0];
 }
 
+ToneOperator Renderer::toneOperator() const {
+    return _tone;
+}
+
+void Renderer::setToneOperator(ToneOperator op) {
+    _tone = op;
+}
+
+RendererBuffer Renderer::bufferData() const {
+    RendererBuffer data;
+    data.gamma = _gamma;
+    data.exp   = _exposure;
+
+    // Tone map parameters
+    data.A = _toneParams[0];
+    data.B = _toneParams[1];
+    data.C = _toneParams[2];
+    data.D = _toneParams[3];
+    data.E = _toneParams[4];
+    data.F = _toneParams[5];
+    data.W = _toneParams[6];
+
+    return data;
+}
+
 void Renderer::setSkyboxDraw(bool state) {
     _drawSkybox = state;
 }
@@ -57,6 +83,16 @@ void Renderer::uploadLightsBuffer(const Scene& scene) {
     RHI.updateBuffer(_lightsBuffer, sizeof(LightData) * NUM_LIGHTS, &data);
 }
 
+void Renderer::uploadSHBuffer(const Scene& scene) {
+    if (!scene.hasSkybox())
+        return;
+
+    // Irradiance of the environment, as evaluated by unreal.fs
+    SHCoeffs data = scene.skybox().irradianceSH();
+
+    RHI.updateBuffer(_shBuffer, sizeof(SHCoeffs), &data);
+}
+
 void Renderer::uploadCameraBuffer(const Camera& camera) {
     CameraData data;
     data.viewMatrix     = camera.viewMatrix();
@@ -69,18 +105,7 @@ void Renderer::uploadCameraBuffer(const Camera& camera) {
 }
 
 void Renderer::uploadRendererBuffer() {
-    RendererBuffer data;
-    data.gamma = _gamma;
-    data.exp   = _exposure;
-
-    // Tone map parameters
-    data.A = _toneParams[0];
-    data.B = _toneParams[1];
-    data.C = _toneParams[2];
-    data.D = _toneParams[3];
-    data.E = _toneParams[4];
-    data.F = _toneParams[5];
-    data.W = _toneParams[6];
+    RendererBuffer data = bufferData();
 
     // Upload the buffer to the GPU
     RHI.updateBuffer(_rendererBuffer, sizeof(RendererBuffer), &data);
@@ -105,17 +130,20 @@ void Renderer::prepare() {
     _lightsBuffer   = RHI.createBuffer(BUFFER_SHARED, DYNAMIC, sizeof(LightData) * NUM_LIGHTS, 0);
     _cameraBuffer   = RHI.createBuffer(BUFFER_SHARED, DYNAMIC, sizeof(CameraData), 0);
     _rendererBuffer = RHI.createBuffer(BUFFER_SHARED, DYNAMIC, sizeof(RendererBuffer), 0);
+    _shBuffer       = RHI.createBuffer(BUFFER_SHARED, DYNAMIC, sizeof(SHCoeffs), 0);
 
     // Bind buffers to known indices
     RHI.bindBufferBase(_cameraBuffer,   CAMERA_BUFFER_IDX);
     RHI.bindBufferBase(_lightsBuffer,   LIGHTS_BUFFER_IDX);
     RHI.bindBufferBase(_rendererBuffer, RENDERER_BUFFER_IDX);
+    RHI.bindBufferBase(_shBuffer,       SH_BUFFER_IDX);
 }
 
 void Renderer::render(const Scene& scene, const Camera& camera) {
     // Upload constant buffers to the GPU
     uploadRendererBuffer();
     uploadLightsBuffer(scene);
+    uploadSHBuffer(scene);
     uploadCameraBuffer(camera);
 
     // Draw scene objects
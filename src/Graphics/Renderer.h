@@ -2,6 +2,7 @@
 #define __PBR_RENDERER_H__
 
 #include <PBR.h>
+#include <ToneMap.h>
 
 namespace pbr {
 
@@ -10,27 +11,13 @@ namespace pbr {
 
     static PBR_CONSTEXPR uint32 NUM_LIGHTS = 4;
     
-    enum ToneOperator {
-        SIMPLE,
-        REINHART,
-        UNCHARTED
-    };
-
     enum BufferIndices : uint32 {
         CAMERA_BUFFER_IDX   = 0,
         LIGHTS_BUFFER_IDX   = 1,
-        RENDERER_BUFFER_IDX = 2
+        RENDERER_BUFFER_IDX = 2,
+        SH_BUFFER_IDX       = 3
     };
 
-    // Buffer for shaders with renderer information
-    struct RendererBuffer {
-        float gamma;
-        float exp;
-
-        // Uncharted tone curve control parameters
-        float A, B, C, D, E, F, W;
-    };
-    
     class PBR_SHARED Renderer {
     public:
         Renderer();
@@ -47,11 +34,18 @@ namespace pbr {
         const float* toneParams() const;
         void setToneParams(float toneParams[7]);
 
+        ToneOperator toneOperator() const;
+        void setToneOperator(ToneOperator op);
+
+        // Current values of the renderer buffer, for CPU side tone mapping
+        RendererBuffer bufferData() const;
+
         void setSkyboxDraw(bool state);
 
     private:
         void uploadRendererBuffer();
         void uploadLightsBuffer(const Scene& scene);
+        void uploadSHBuffer(const Scene& scene);
         void uploadCameraBuffer(const Camera& camera);
         void drawShapes(const Scene& scene);
         void drawSkybox(const Scene& scene);
@@ -66,6 +60,7 @@ namespace pbr {
         RRID _lightsBuffer;
         RRID _cameraBuffer;
         RRID _rendererBuffer;
+        RRID _shBuffer;
     };
 
 }
@@ -63,7 +63,11 @@ bool Shader::addShader(const ShaderSource& source) {
 }
 
 bool Shader::link() {
-    _id = RHI.linkProgram(*this);
+    RRID id = RHI.linkProgram(*this);
+    if (id == -1)
+        return false; // Error
+
+    _id = (uint32)id;
     return true;
 }
 
@@ -0,0 +1,194 @@
+#include <TextureResidency.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <RenderInterface.h>
+#include <PBRMaterial.h>
+#include <Camera.h>
+#include <Shape.h>
+#include <Scene.h>
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR uint64 DEFAULT_BUDGET = 512ull << 20; // 512 MB
+
+    // Levels loaded in a frame, at least one is loaded if any is needed
+    static PBR_CONSTEXPR uint64 LOAD_BUDGET = 4 << 20;
+
+    // Finest level worth sampling for a texture that covers a shape of
+    // the given diameter in pixels, assuming it is mapped once over it
+    uint32 screenLevel(const Image& source, float pixels) {
+        float size = (float)std::max(source.width(), source.height());
+        if (pixels >= size)
+            return 0;
+
+        uint32 level = (uint32)std::log2(size / std::max(pixels, 1.0f));
+        return std::min(level, source.numLevels() - 1);
+    }
+}
+
+TextureResidency::TextureResidency() : _budget(DEFAULT_BUDGET), _residentSize(0) {
+
+}
+
+TextureResidency& TextureResidency::get() {
+    static TextureResidency residency;
+    return residency;
+}
+
+void TextureResidency::setBudget(uint64 maxBytes) {
+    _budget = maxBytes;
+}
+
+uint64 TextureResidency::budget() const {
+    return _budget;
+}
+
+uint64 TextureResidency::residentSize() const {
+    return _residentSize;
+}
+
+void TextureResidency::manage(RRID id, const sref<Image>& source) {
+    // Single level textures have nothing to evict
+    if (!source || source->type() != IMGTYPE_2D || source->numLevels() < 2)
+        return;
+
+    release(id);
+
+    Resident res = { source, 0, 0, 0 };
+    _textures[id] = res;
+
+    _residentSize += levelsSize(res, 0);
+}
+
+void TextureResidency::release(RRID id) {
+    auto it = _textures.find(id);
+    if (it == _textures.end())
+        return;
+
+    _residentSize -= levelsSize(it->second, it->second.base);
+    _textures.erase(it);
+}
+
+void TextureResidency::update(const Scene& scene, const Camera& camera) {
+    if (_textures.empty())
+        return;
+
+    for (auto& tex : _textures)
+        tex.second.wanted = tex.second.source->numLevels() - 1;
+
+    // Diameter in pixels of a unit sphere at unit distance
+    float scale = camera.projMatrix()(1, 1) * camera.height();
+
+    for (const sref<Shape>& shape : scene.shapes()) {
+        const PBRMaterial* mat = dynamic_cast<const PBRMaterial*>(shape->material().get());
+        if (!mat)
+            continue;
+
+        BSphere sphere = shape->bSphere();
+        float dist = distance(sphere.center(), camera.position());
+
+        // The camera is inside the bounds, anything may be close
+        float pixels = std::numeric_limits<float>::max();
+        if (dist > sphere.radius())
+            pixels = sphere.radius() * scale / dist;
+
+        RRID maps[] = { mat->diffuseTex(), mat->normalTex(), mat->metallicTex(), mat->roughTex() };
+        // Maps that share pixels alias the texture residency manages
+        for (RRID id : maps) {
+            auto it = _textures.find(RHI.resolveTexture(id));
+            if (it == _textures.end())
+                continue;
+
+            Resident& res = it->second;
+            res.wanted = std::min(res.wanted, screenLevel(*res.source, pixels));
+        }
+    }
+
+    for (auto& tex : _textures)
+        tex.second.target = tex.second.base;
+
+    // Levels no shape needs go first
+    while (_residentSize > _budget && evictLevel(false));
+
+    // The blurriest textures are loaded first, a level per frame each
+    std::vector<std::pair<uint32, RRID>> loads;
+    for (const auto& tex : _textures) {
+        if (tex.second.target > tex.second.wanted)
+            loads.emplace_back(tex.second.target - tex.second.wanted, tex.first);
+    }
+
+    std::sort(loads.begin(), loads.end(), std::greater<std::pair<uint32, RRID>>());
+
+    uint64 loaded = 0;
+    for (const auto& load : loads) {
+        Resident& res = _textures[load.second];
+
+        uint64 size = res.source->size(res.target - 1);
+        if (loaded > 0 && loaded + size > LOAD_BUDGET)
+            break;
+
+        while (_residentSize + size > _budget && evictLevel(false));
+        if (_residentSize + size > _budget)
+            continue;
+
+        res.target--;
+
+        _residentSize += size;
+        loaded += size;
+    }
+
+    // Budgets under what is on screen cost needed levels as well
+    while (_residentSize > _budget && evictLevel(true));
+
+    for (auto& tex : _textures) {
+        Resident& res = tex.second;
+        if (res.target == res.base)
+            continue;
+
+        if (RHI.setResidentLevels(tex.first, *res.source, res.target))
+            res.base = res.target;
+        else
+            _residentSize = _residentSize + levelsSize(res, res.base) - levelsSize(res, res.target);
+    }
+}
+
+uint64 TextureResidency::levelsSize(const Resident& res, uint32 base) const {
+    uint64 size = 0;
+    for (uint32 lvl = base; lvl < res.source->numLevels(); ++lvl)
+        size += res.source->size(lvl);
+
+    return size;
+}
+
+bool TextureResidency::evictLevel(bool wanted) {
+    // The largest level that may go is evicted
+    Resident* victim  = nullptr;
+    uint64 victimSize = 0;
+
+    for (auto& tex : _textures) {
+        Resident& res = tex.second;
+
+        uint32 limit = wanted ? res.source->numLevels() - 1 : res.wanted;
+        if (res.target >= limit)
+            continue;
+
+        uint64 size = res.source->size(res.target);
+        if (size > victimSize) {
+            victim     = &res;
+            victimSize = size;
+        }
+    }
+
+    if (!victim)
+        return false;
+
+    victim->target++;
+
+    _residentSize -= victimSize;
+
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef __PBR_TEXTURERESIDENCY_H__
+#define __PBR_TEXTURERESIDENCY_H__
+
+#include <unordered_map>
+
+#include <PBR.h>
+#include <Image.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: Residency.update(scene, camera);
+#define Residency TextureResidency::get()
+
+namespace pbr {
+
+    class Scene;
+    class Camera;
+
+    // Keeps the finest mip levels of material textures resident only while
+    // a shape using them covers enough of the screen. Levels are loaded
+    // from the source images back towards the mip each shape needs, and
+    // the least needed ones are evicted to stay under the memory budget.
+    class TextureResidency {
+    public:
+        static TextureResidency& get();
+
+        void setBudget(uint64 maxBytes);
+        uint64 budget() const;
+
+        // Bytes of all resident levels of the managed textures
+        uint64 residentSize() const;
+
+        // Starts managing a 2D texture with all levels of source resident
+        void manage(RRID id, const sref<Image>& source);
+        void release(RRID id);
+
+        // Estimates the level each texture needs from the screen size of
+        // the shapes that use it, and loads or evicts levels towards it
+        void update(const Scene& scene, const Camera& camera);
+
+    private:
+        TextureResidency();
+
+        struct Resident {
+            sref<Image> source;
+            uint32 base;   // First resident level
+            uint32 wanted; // Finest level needed on screen
+            uint32 target; // First resident level after this update
+        };
+
+        uint64 levelsSize(const Resident& res, uint32 base) const;
+        bool   evictLevel(bool wanted);
+
+        std::unordered_map<RRID, Resident> _textures;
+
+        uint64 _budget;
+        uint64 _residentSize;
+    };
+
+}
+
+#endif
@@ -0,0 +1,334 @@
+#include <TextureStreamer.h>
+
+#include <cstring>
+
+#include <PixelOps.h>
+#include <ThreadPool.h>
+
+using namespace pbr;
+
+namespace {
+    // The GPU may still read the two segments written before the current one
+    static PBR_CONSTEXPR uint32 NUM_SEGMENTS = 3;
+
+    // Offsets of copies in a segment, keeps float rows aligned
+    static PBR_CONSTEXPR uint64 COPY_ALIGNMENT = 16;
+
+    struct Copy {
+        RRID   texture;
+        uint32 level;
+        uint32 y;
+        uint32 rows;
+        uint64 size;
+        uint64 offset;
+    };
+
+    uint8 toByte(float val) {
+        return (uint8)(std::min(std::max(val, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+TextureStreamer::TextureStreamer() : _segmentSize(0), _current(0), _persistent(false) {
+
+}
+
+TextureStreamer::~TextureStreamer() {
+
+}
+
+TextureStreamer& TextureStreamer::get() {
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+void TextureStreamer::initialize(uint64 frameBudget) {
+    _segmentSize = frameBudget;
+    _current     = 0;
+
+    // Persistently mapped buffers are written without any map calls,
+    // older contexts map each segment when it is written
+    _persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+    _ring.resize(NUM_SEGMENTS);
+    for (Segment& seg : _ring) {
+        seg.fence = nullptr;
+        seg.ptr   = nullptr;
+
+        glGenBuffers(1, &seg.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, seg.buffer);
+
+        if (_persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)_segmentSize, nullptr, flags);
+            seg.ptr = (uint8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)_segmentSize, flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)_segmentSize, nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+RRID TextureStreamer::request(const TextureImporter& import, const Color& placeholder,
+                              const TextureReady& ready, const TextureShare& share) {
+    uint8 color[] = { toByte(placeholder.r), toByte(placeholder.g), toByte(placeholder.b), 255 };
+
+    Job job;
+    job.placeholder = RHI.allocateTexture(IMGTYPE_2D, IMGFMT_RGBA8, 1, 1, 1, 1, TexSampler());
+    job.texture     = -1;
+    job.image       = make_sref<Image>();
+    job.sampler     = make_sref<TexSampler>();
+    job.ready       = ready;
+    job.share       = share;
+    job.level       = 0;
+    job.row         = 0;
+
+    RHI.updateTexture(job.placeholder, 0, 0, 1, sizeof(color), color);
+
+    sref<Image>      image   = job.image;
+    sref<TexSampler> sampler = job.sampler;
+
+    // Without a staging ring the texture is loaded right away
+    if (_ring.empty()) {
+        if (import(*image, *sampler) && !(share && share(job.placeholder))) {
+            job.texture = RHI.createTexture(*image, *sampler);
+            finish(job);
+        }
+
+        return job.placeholder;
+    }
+
+    job.imported = Workers.enqueue([import, image, sampler]() {
+        return import(*image, *sampler);
+    });
+
+    _jobs.push_back(std::move(job));
+
+    return _jobs.back().placeholder;
+}
+
+void TextureStreamer::update() {
+    if (!_ring.empty() && !_jobs.empty())
+        uploadFrame(false);
+}
+
+void TextureStreamer::flush() {
+    while (!_ring.empty() && !_jobs.empty())
+        uploadFrame(true);
+}
+
+bool TextureStreamer::isIdle() const {
+    return _jobs.empty();
+}
+
+void TextureStreamer::cleanup() {
+    // Workers may still be writing the images
+    for (Job& job : _jobs) {
+        if (job.imported.valid())
+            job.imported.wait();
+    }
+
+    _jobs.clear();
+
+    for (Segment& seg : _ring) {
+        if (seg.fence)
+            glDeleteSync(seg.fence);
+
+        if (_persistent) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, seg.buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+
+        glDeleteBuffers(1, &seg.buffer);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    _ring.clear();
+}
+
+void TextureStreamer::uploadFrame(bool wait) {
+    // Allocate storage for the textures the workers are done with
+    for (auto it = _jobs.begin(); it != _jobs.end(); ) {
+        Job& job = *it;
+        if (job.texture != -1 || !job.imported.valid()) {
+            ++it;
+            continue;
+        }
+
+        if (!wait && job.imported.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        // Failed imports keep their placeholder
+        if (!job.imported.get() || job.image->format() == IMGFMT_UNKNOWN) {
+            it = _jobs.erase(it);
+            continue;
+        }
+
+        // Pixels another texture already holds are not uploaded again
+        if (job.share && job.share(job.placeholder)) {
+            it = _jobs.erase(it);
+            continue;
+        }
+
+        const Image& img = *job.image;
+        if (img.type() != IMGTYPE_2D) {
+            // Only 2D textures are streamed
+            job.texture = RHI.createTexture(img, *job.sampler);
+            finish(job);
+
+            it = _jobs.erase(it);
+            continue;
+        }
+
+        job.texture = RHI.allocateTexture(img.type(), img.format(), img.width(), img.height(),
+                                          img.depth(), img.numLevels(), *job.sampler);
+        ++it;
+    }
+
+    Segment& seg = _ring[_current];
+    if (seg.fence) {
+        // A segment is only reused after the GPU has read it
+        GLenum status = glClientWaitSync(seg.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(seg.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+            return;
+
+        glDeleteSync(seg.fence);
+        seg.fence = nullptr;
+    }
+
+    std::vector<Copy> copies;
+    uint8* ptr  = seg.ptr;
+    uint64 used = 0;
+
+    for (Job& job : _jobs) {
+        if (job.texture == -1)
+            continue;
+
+        while (job.level < job.image->numLevels()) {
+            used = (used + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+
+            uint32 rows;
+            uint64 size;
+            uint64 space = (used < _segmentSize) ? _segmentSize - used : 0;
+            if (!nextCopy(job, space, rows, size)) {
+                if (used > 0)
+                    break;
+
+                // Rows larger than a whole segment go straight from memory
+                nextCopy(job, ~0ull, rows, size);
+
+                std::vector<uint8> direct((size_t)size);
+                copyRows(job, rows, &direct[0]);
+                RHI.updateTexture(job.texture, job.level, job.row, rows, size, &direct[0]);
+            } else {
+                if (!ptr) {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, seg.buffer);
+                    ptr = (uint8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)_segmentSize,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+                    if (!ptr)
+                        return; // Error
+                }
+
+                copyRows(job, rows, ptr + used);
+                copies.push_back({ job.texture, job.level, job.row, rows, size, used });
+
+                used += size;
+            }
+
+            job.row += rows;
+            if (job.row >= (uint32)mipDimension(job.image->height(), job.level)) {
+                job.row = 0;
+                job.level++;
+            }
+        }
+
+        if (job.level < job.image->numLevels())
+            break;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, seg.buffer);
+
+    if (!_persistent && ptr)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Sources are offsets into the bound buffer
+    for (const Copy& copy : copies)
+        RHI.updateTexture(copy.texture, copy.level, copy.y, copy.rows, copy.size, (const void*)copy.offset);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!copies.empty()) {
+        seg.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _current  = (_current + 1) % NUM_SEGMENTS;
+    }
+
+    // Swap in the textures that are complete
+    for (auto it = _jobs.begin(); it != _jobs.end(); ) {
+        if (it->texture != -1 && it->level >= it->image->numLevels()) {
+            finish(*it);
+            it = _jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool TextureStreamer::nextCopy(const Job& job, uint64 space, uint32& rows, uint64& size) const {
+    ImageFormat format = uploadFormat(job.image->format());
+
+    uint32 w = mipDimension(job.image->width(),  job.level);
+    uint32 h = mipDimension(job.image->height(), job.level);
+
+    // Compressed levels are copied in rows of 4x4 blocks
+    uint32 step = 1;
+    uint64 rowSize = (uint64)w * formatToBytesPerPixel(format);
+    if (isCompressed(format)) {
+        step    = 4;
+        rowSize = (uint64)formatToBlockSize(format) * ((w + 3) / 4);
+    }
+
+    uint64 units = (h - job.row + step - 1) / step;
+    uint64 fit   = std::min(units, space / rowSize);
+
+    rows = std::min((uint32)fit * step, h - job.row);
+    size = fit * rowSize;
+
+    return fit > 0;
+}
+
+void TextureStreamer::copyRows(const Job& job, uint32 rows, uint8* dst) const {
+    ImageFormat srcFormat = job.image->format();
+    ImageFormat dstFormat = uploadFormat(srcFormat);
+
+    uint32 w = mipDimension(job.image->width(), job.level);
+    const uint8* src = job.image->data(job.level);
+
+    if (isCompressed(srcFormat)) {
+        uint64 rowSize = (uint64)formatToBlockSize(srcFormat) * ((w + 3) / 4);
+        std::memcpy(dst, src + job.row / 4 * rowSize, (size_t)(rowSize * ((rows + 3) / 4)));
+        return;
+    }
+
+    uint64 rowSize = (uint64)w * formatToBytesPerPixel(srcFormat);
+    src += job.row * rowSize;
+
+    if (srcFormat == dstFormat)
+        std::memcpy(dst, src, (size_t)(rowSize * rows));
+    else
+        convertRow(srcFormat, src, dstFormat, dst, w * rows);
+}
+
+void TextureStreamer::finish(Job& job) {
+    RHI.replaceTexture(job.placeholder, job.texture);
+
+    if (job.ready)
+        job.ready(job.placeholder, job.image);
+}
@@ -0,0 +1,102 @@
+#ifndef __PBR_TEXTURESTREAMER_H__
+#define __PBR_TEXTURESTREAMER_H__
+
+#include <deque>
+#include <future>
+#include <functional>
+
+#include <RenderInterface.h>
+
+#include <Texture.h>
+#include <Spectrum.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: Streamer.update();
+#define Streamer TextureStreamer::get()
+
+namespace pbr {
+
+    // Imports the pixels and sampler of a texture, on a worker thread.
+    // Returns false if there is nothing to upload.
+    using TextureImporter = std::function<bool(Image&, TexSampler&)>;
+
+    // Called on the main thread once the texture is on the GPU
+    using TextureReady = std::function<void(RRID, const sref<Image>&)>;
+
+    // Called on the main thread once the pixels are imported, before any
+    // storage is allocated. Returns true if the placeholder id was made an
+    // alias of a texture with the same pixels, which are then not uploaded.
+    using TextureShare = std::function<bool(RRID)>;
+
+    // Uploads textures in the background. Images are imported on the
+    // worker threads and copied into a ring of pixel unpack buffers, a
+    // bounded number of bytes per frame, while a 1x1 placeholder takes the
+    // place of each texture. Textures keep the id of their placeholder.
+    class TextureStreamer {
+    public:
+        ~TextureStreamer();
+
+        static TextureStreamer& get();
+
+        // Creates the staging ring, frameBudget bytes are uploaded per frame
+        void initialize(uint64 frameBudget = 4 << 20);
+
+        // Queues a texture and returns the id of its placeholder
+        RRID request(const TextureImporter& import, const Color& placeholder,
+                     const TextureReady& ready = nullptr, const TextureShare& share = nullptr);
+
+        // Uploads the next frameBudget bytes, from the main thread
+        void update();
+
+        // Uploads every queued texture before returning
+        void flush();
+
+        bool isIdle() const;
+
+        void cleanup();
+
+    private:
+        TextureStreamer();
+
+        struct Job {
+            RRID placeholder;
+            RRID texture;
+
+            sref<Image>      image;
+            sref<TexSampler> sampler;
+            TextureReady     ready;
+            TextureShare     share;
+
+            std::future<bool> imported;
+
+            uint32 level;
+            uint32 row;
+        };
+
+        struct Segment {
+            GLuint buffer;
+            GLsync fence;
+            uint8* ptr;
+        };
+
+        // Copies whatever fits in the next segment. With wait, the GPU
+        // is waited for instead of skipping a frame.
+        void uploadFrame(bool wait);
+
+        // Rows of the next copy of a job, clamped to the bytes left
+        bool nextCopy(const Job& job, uint64 space, uint32& rows, uint64& size) const;
+        void copyRows(const Job& job, uint32 rows, uint8* dst) const;
+
+        void finish(Job& job);
+
+        std::deque<Job>  _jobs;
+        std::vector<Segment> _ring;
+
+        uint64 _segmentSize;
+        uint32 _current;
+        bool   _persistent;
+    };
+
+}
+
+#endif
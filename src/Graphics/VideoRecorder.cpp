@@ -0,0 +1,294 @@
+#include <VideoRecorder.h>
+
+#include <cstring>
+#include <sstream>
+
+#include <FrameCapture.h>
+#include <PixelOps.h>
+
+#ifdef PBR_WINDOWS
+#define popen  _popen
+#define pclose _pclose
+#define PIPE_MODE "wb"
+#else
+#define PIPE_MODE "w"
+#endif
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR uint32 DEFAULT_MAX_QUEUED = 4;
+
+    static const char  FRAME_HEADER[]    = "FRAME\n";
+    static PBR_CONSTEXPR uint64 FRAME_HEADER_SIZE = sizeof(FRAME_HEADER) - 1;
+}
+
+VideoRecorder::VideoRecorder() : _file(nullptr), _pipe(false), _format(VIDEO_Y4M),
+    _width(0), _height(0), _maxQueued(DEFAULT_MAX_QUEUED), _dropFrames(true), _recording(false),
+    _nextIndex(0), _nextWrite(0), _settleIndex(0), _queued(0), _stopping(false), _writeFailed(false),
+    _written(0), _dropped(0), _blocked(0) {
+
+}
+
+VideoRecorder::~VideoRecorder() {
+    stop();
+}
+
+bool VideoRecorder::start(const std::string& filePath, int32 width, int32 height, uint32 fps, VideoFormat format) {
+    if (_recording || width <= 0 || height <= 0 || fps == 0)
+        return false;
+
+    _pipe = !filePath.empty() && filePath[0] == '|';
+    if (_pipe)
+        _file = popen(filePath.substr(1).c_str(), PIPE_MODE);
+    else
+        _file = fopen(filePath.c_str(), "wb");
+
+    if (!_file)
+        return false; // Error
+
+    if (format == VIDEO_Y4M) {
+        std::stringstream header;
+        header << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1"
+               << " Ip A1:1 C444 XCOLORRANGE=LIMITED\n";
+
+        std::string str = header.str();
+        if (fwrite(str.data(), 1, str.size(), _file) != str.size()) {
+            _pipe ? pclose(_file) : fclose(_file);
+            _file = nullptr;
+            return false; // Error
+        }
+    }
+
+    _format = format;
+    _width  = width;
+    _height = height;
+
+    _nextIndex   = 0;
+    _nextWrite   = 0;
+    _settleIndex = 0;
+    _queued      = 0;
+    _stopping    = false;
+    _writeFailed = false;
+
+    _written = 0;
+    _dropped = 0;
+    _blocked = 0;
+
+    _recording = true;
+    _writer = std::thread(&VideoRecorder::writerLoop, this);
+
+    return true;
+}
+
+bool VideoRecorder::captureFrame() {
+    if (!_recording)
+        return false;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_writeFailed)
+        return false;
+
+    if (_queued >= _maxQueued) {
+        // Frames that can't arrive anymore are still counted as queued
+        if (Capture.isIdle())
+            settle();
+
+        if (_dropFrames && _queued >= _maxQueued) {
+            _dropped++;
+            return true;
+        }
+
+        if (_queued >= _maxQueued)
+            _blocked++;
+
+        // The reads only move forward from the main thread
+        while (_queued >= _maxQueued && !_writeFailed) {
+            lock.unlock();
+            Capture.update();
+            lock.lock();
+
+            if (Capture.isIdle())
+                settle();
+
+            _frameWritten.wait_for(lock, std::chrono::milliseconds(1));
+        }
+
+        if (_writeFailed)
+            return false;
+    }
+
+    uint64 index = _nextIndex++;
+    _queued++;
+
+    lock.unlock();
+
+    bool issued = Capture.readPixels(0, 0, _width, _height, IMGFMT_RGB8, [this, index](Image& img) {
+        encodeFrame(index, img);
+        return true;
+    });
+
+    if (!issued) {
+        lock.lock();
+        _nextIndex--;
+        _queued--;
+        _dropped++;
+    }
+
+    return true;
+}
+
+void VideoRecorder::stop() {
+    if (!_recording)
+        return;
+
+    // Every frame read back is encoded once the captures are flushed
+    Capture.flush();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        settle();
+        _stopping = true;
+    }
+
+    _frameQueued.notify_one();
+    _writer.join();
+
+    _pipe ? pclose(_file) : fclose(_file);
+    _file = nullptr;
+
+    _frames.clear();
+    _recording = false;
+}
+
+bool VideoRecorder::isRecording() const {
+    return _recording;
+}
+
+int32 VideoRecorder::width() const {
+    return _width;
+}
+
+int32 VideoRecorder::height() const {
+    return _height;
+}
+
+void VideoRecorder::setMaxQueuedFrames(uint32 maxFrames) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _maxQueued = std::max(maxFrames, 1u);
+}
+
+void VideoRecorder::setDropFrames(bool drop) {
+    _dropFrames = drop;
+}
+
+uint64 VideoRecorder::framesWritten() const {
+    return _written;
+}
+
+uint64 VideoRecorder::framesDropped() const {
+    return _dropped;
+}
+
+uint64 VideoRecorder::framesBlocked() const {
+    return _blocked;
+}
+
+void VideoRecorder::encodeFrame(uint64 index, const Image& img) {
+    uint32 w = (uint32)img.width();
+    uint32 h = (uint32)img.height();
+
+    uint64 planeSize = (uint64)w * h;
+    uint64 rowSize   = (uint64)w * 3;
+
+    Frame frame;
+    frame.size = (_format == VIDEO_Y4M) ? FRAME_HEADER_SIZE + planeSize * 3 : planeSize * 3;
+    frame.data = Pixels.allocate(frame.size);
+
+    // OpenGL rows start at the bottom
+    const uint8* src = img.data();
+    if (_format == VIDEO_Y4M) {
+        memcpy(frame.data.get(), FRAME_HEADER, (size_t)FRAME_HEADER_SIZE);
+
+        uint8* y  = frame.data.get() + FRAME_HEADER_SIZE;
+        uint8* cb = y  + planeSize;
+        uint8* cr = cb + planeSize;
+
+        for (uint32 r = 0; r < h; ++r) {
+            uint64 offset = (uint64)r * w;
+            rgbToYCbCr(src + (h - 1 - r) * rowSize, 3, y + offset, cb + offset, cr + offset, w);
+        }
+    } else {
+        for (uint32 r = 0; r < h; ++r)
+            memcpy(frame.data.get() + r * rowSize, src + (h - 1 - r) * rowSize, (size_t)rowSize);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _frames.emplace(index, std::move(frame));
+    }
+
+    _frameQueued.notify_one();
+}
+
+void VideoRecorder::writerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        auto next = _frames.find(_nextWrite);
+        if (next == _frames.end()) {
+            if (_nextWrite < _settleIndex) {
+                // Skips the frames lost before the settle point
+                _nextWrite = _frames.empty() ? _settleIndex : std::min(_frames.begin()->first, _settleIndex);
+                continue;
+            }
+
+            if (_stopping && _frames.empty())
+                break;
+
+            _frameQueued.wait(lock);
+            continue;
+        }
+
+        Frame frame = std::move(next->second);
+        _frames.erase(next);
+
+        _nextWrite++;
+        _queued--;
+
+        bool failed = _writeFailed;
+        lock.unlock();
+
+        _frameWritten.notify_one();
+
+        if (!failed) {
+            if (fwrite(frame.data.get(), 1, (size_t)frame.size, _file) == frame.size)
+                _written++;
+            else
+                failed = true;
+        }
+
+        // The block goes back to the allocator before waiting again
+        frame.data.reset();
+
+        lock.lock();
+
+        if (failed) {
+            _writeFailed = true;
+            _dropped++;
+        }
+    }
+}
+
+void VideoRecorder::settle() {
+    // No read is in flight, frames not encoded by now are lost
+    uint32 lost = _queued - (uint32)_frames.size();
+
+    _dropped     += lost;
+    _queued      -= lost;
+    _settleIndex  = _nextIndex;
+
+    if (lost > 0)
+        _frameQueued.notify_one();
+}
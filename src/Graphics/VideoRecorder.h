@@ -0,0 +1,106 @@
+#ifndef __PBR_VIDEORECORDER_H__
+#define __PBR_VIDEORECORDER_H__
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+
+#include <Image.h>
+#include <PixelAllocator.h>
+
+namespace pbr {
+
+    enum VideoFormat : uint32 {
+        VIDEO_Y4M = 0, // YUV4MPEG2, 4:4:4 limited range BT.709
+        VIDEO_RGB = 1  // Raw RGB8 frames, rows top down
+    };
+
+    // Records the rendered frames to a file or a pipe. Frames are read back
+    // through FrameCapture, converted on the workers and written in order
+    // by a thread of the recorder, so the render loop never waits on the
+    // output unless the queue of frames not yet written is full.
+    class VideoRecorder {
+    public:
+        VideoRecorder();
+        ~VideoRecorder();
+
+        VideoRecorder(const VideoRecorder&) = delete;
+        VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+        // Writes to filePath, or to the command after a leading '|'
+        // ex: start("| ffmpeg -i - -c:v libx264 video.mp4", w, h);
+        bool start(const std::string& filePath, int32 width, int32 height,
+                   uint32 fps = 60, VideoFormat format = VIDEO_Y4M);
+
+        // Reads the frame back, from the main thread before the buffers
+        // are swapped. Returns false once the output can't be written.
+        bool captureFrame();
+
+        // Writes the frames left and closes the output
+        void stop();
+
+        bool isRecording() const;
+
+        int32 width()  const;
+        int32 height() const;
+
+        // Frames read back and not written yet, past which frames are
+        // dropped, or waited for if dropping is disabled. 4 by default.
+        void setMaxQueuedFrames(uint32 maxFrames);
+        void setDropFrames(bool drop);
+
+        uint64 framesWritten() const;
+        uint64 framesDropped() const;
+        uint64 framesBlocked() const;
+
+    private:
+        struct Frame {
+            PixelBuffer data;
+            uint64 size;
+        };
+
+        void encodeFrame(uint64 index, const Image& img);
+        void writerLoop();
+
+        // Frames still missing once the reads are done were lost on the
+        // way and are skipped
+        void settle();
+
+        FILE* _file;
+        bool  _pipe;
+
+        VideoFormat _format;
+        int32 _width;
+        int32 _height;
+
+        uint32 _maxQueued;
+        bool   _dropFrames;
+        bool   _recording;
+
+        std::thread _writer;
+        std::mutex  _mutex;
+        std::condition_variable _frameQueued;
+        std::condition_variable _frameWritten;
+
+        // Encoded frames by index, waiting for their turn
+        std::map<uint64, Frame> _frames;
+
+        uint64 _nextIndex;   // Index of the next frame read back
+        uint64 _nextWrite;   // Index of the next frame to write
+        uint64 _settleIndex; // Frames below this index won't arrive anymore
+        uint32 _queued;      // Frames read back and not taken by the writer
+
+        bool _stopping;
+        bool _writeFailed;
+
+        std::atomic<uint64> _written;
+        std::atomic<uint64> _dropped;
+        std::atomic<uint64> _blocked;
+    };
+
+}
+
+#endif
@@ -10,6 +10,7 @@ namespace pbr {
     class PBR_SHARED Material {
     public:
         Material() { }
+        virtual ~Material() { }
 
         void use() const;
         RRID program() const;
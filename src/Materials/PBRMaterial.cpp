@@ -2,7 +2,25 @@
 
 using namespace pbr;
 
-PBRMaterial::PBRMaterial() : _metallic(1.0f), _roughness(0.0f), _f0(0.04f) {
+namespace {
+    float maxLod(RRID ggxTex) {
+        sref<Texture> tex = RHI.getTexture(ggxTex);
+        if (!tex)
+            return 0.0f;
+
+        return (float)(tex->format().levels - 1);
+    }
+
+    void setMap(RRID& map, RRID id) {
+        RRID old = map;
+        map = id;
+
+        if (old != -1)
+            Resource.releaseTexture(old);
+    }
+}
+
+PBRMaterial::PBRMaterial() : _metallic(1.0f), _roughness(0.0f), _f0(0.04f), _ggxTex(-1), _maxGGXLod(0.0f) {
     _prog = Resource.getShader("unreal")->id();
 
     _brdfTex = Resource.getTexture("brdf")->rrid();
@@ -17,9 +35,16 @@ PBRMaterial::PBRMaterial() : _metallic(1.0f), _roughness(0.0f), _f0(0.04f) {
     _roughness = -1;
 }
 
+PBRMaterial::~PBRMaterial() {
+    setMap(_diffuseTex,  -1);
+    setMap(_normalTex,   -1);
+    setMap(_metallicTex, -1);
+    setMap(_roughTex,    -1);
+}
+
 void PBRMaterial::update(const Skybox& skybox) {
-    _irradianceTex = skybox.irradianceTex();
     _ggxTex = skybox.ggxTex();
+    _maxGGXLod = maxLod(_ggxTex);
 }
 
 void PBRMaterial::uploadData() const {
@@ -51,11 +76,9 @@ void PBRMaterial::uploadData() const {
         RHI.setSampler("roughTex", 4);
     }
 
-    RHI.bindTexture(6, _irradianceTex);
-    RHI.setSampler("irradianceTex", 6);
-
     RHI.bindTexture(7, _ggxTex);
     RHI.setSampler("ggxTex", 7);
+    RHI.setFloat("maxGGXLod", _maxGGXLod);
     
     RHI.bindTexture(8, _brdfTex);
     RHI.setSampler("brdfTex", 8);
@@ -63,20 +86,17 @@ void PBRMaterial::uploadData() const {
     //RHI.useProgram(0);
 }
 
-void PBRMaterial::setIrradianceTex(RRID id) {
-    _irradianceTex = id;
-}
-
 void PBRMaterial::setBrdfTex(RRID id) {
     _brdfTex = id;
 }
 
 void PBRMaterial::setGGXTex(RRID id) {
     _ggxTex = id;
+    _maxGGXLod = maxLod(id);
 }
 
 void PBRMaterial::setDiffuse(RRID diffTex) {
-    _diffuseTex = diffTex;
+    setMap(_diffuseTex, diffTex);
 }
 
 void PBRMaterial::setDiffuse(const Color& diffuse) {
@@ -84,7 +104,7 @@ void PBRMaterial::setDiffuse(const Color& diffuse) {
 }
 
 void PBRMaterial::setNormal(RRID normalTex) {
-    _normalTex = normalTex;
+    setMap(_normalTex, normalTex);
 }
 
 void PBRMaterial::setSpecular(const Color& spec) {
@@ -92,7 +112,7 @@ void PBRMaterial::setSpecular(const Color& spec) {
 }
 
 void PBRMaterial::setMetallic(RRID metalTex) {
-    _metallicTex = metalTex;
+    setMap(_metallicTex, metalTex);
 }
 
 void PBRMaterial::setMetallic(float metallic) {
@@ -100,7 +120,7 @@ void PBRMaterial::setMetallic(float metallic) {
 }
 
 void PBRMaterial::setRoughness(RRID roughTex) {
-    _roughTex = roughTex;
+    setMap(_roughTex, roughTex);
 }
 
 void PBRMaterial::setRoughness(float roughness) {
@@ -127,6 +147,10 @@ RRID PBRMaterial::diffuseTex() const {
     return _diffuseTex;
 }
 
+RRID PBRMaterial::normalTex() const {
+    return _normalTex;
+}
+
 RRID PBRMaterial::metallicTex() const {
     return _metallicTex;
 }
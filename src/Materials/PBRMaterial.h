@@ -16,10 +16,13 @@ namespace pbr {
     class PBR_SHARED PBRMaterial : public Material {
     public:
         PBRMaterial();
+        ~PBRMaterial();
 
         void update(const Skybox& skybox);
         void uploadData() const;
 
+        // Map setters take over a registry reference to the texture, and
+        // drop the one of the map they replace
         void setDiffuse(RRID diffTex);
         void setDiffuse(const Color& diffuse);
 
@@ -32,7 +35,6 @@ namespace pbr {
         void setRoughness(RRID roughTex);
         void setRoughness(float roughness);
 
-        void setIrradianceTex(RRID id);
         void setBrdfTex(RRID id);
         void setGGXTex(RRID id);
 
@@ -42,6 +44,7 @@ namespace pbr {
         Color diffuse()   const;
 
         RRID diffuseTex()  const;
+        RRID normalTex()   const;
         RRID metallicTex() const;
         RRID roughTex()    const;
 
@@ -57,9 +60,11 @@ namespace pbr {
         RRID _roughTex;
 
         // PBR maps
-        RRID _irradianceTex;
         RRID _brdfTex;
         RRID _ggxTex;
+
+        // Level the shader samples at roughness 1
+        float _maxGGXLod;
     };
 
 }
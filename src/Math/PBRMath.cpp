@@ -1,5 +1,7 @@
 #include <PBRMath.h>
 
+#include <cstring>
+
 namespace pbr {
     namespace math {
 
@@ -131,6 +133,43 @@ namespace pbr {
             return true;
         }
 
+        uint64 hashBytes(const void* data, uint64 size, uint64 seed) {
+            const uint8* bytes = (const uint8*)data;
+
+            static PBR_CONSTEXPR uint64 M = 0xC6A4A7935BD1E995ull;
+            static PBR_CONSTEXPR int32  R = 47;
+
+            uint64 h = seed ^ (size * M);
+
+            uint64 numWords = size / 8;
+            for (uint64 w = 0; w < numWords; ++w) {
+                uint64 k;
+                memcpy(&k, bytes + w * 8, 8);
+
+                k *= M;
+                k ^= k >> R;
+                k *= M;
+
+                h ^= k;
+                h *= M;
+            }
+
+            const uint8* tail = bytes + numWords * 8;
+            uint32 rest = size & 7;
+            if (rest > 0) {
+                for (uint32 b = 0; b < rest; ++b)
+                    h ^= (uint64)tail[b] << (8 * b);
+
+                h *= M;
+            }
+
+            h ^= h >> R;
+            h *= M;
+            h ^= h >> R;
+
+            return h;
+        }
+
         bool newtonRaphson(Float x0, Float* sol, std::function<Float(Float)> f, std::function<Float(Float)> df, uint32 iters) {
             Float xn = x0;
             for (uint32 i = 0; i < iters; ++i) {
@@ -71,6 +71,9 @@ namespace math {
     PBR_SHARED bool solQuadratic(Float a, Float b, Float c, Float* x0, Float* x1);
     PBR_SHARED bool solSystem2x2(const Matrix2x2& A, const Vector2& b, Float* x0, Float* x1);
 
+    // MurmurHash64A of a block of memory
+    PBR_SHARED uint64 hashBytes(const void* data, uint64 size, uint64 seed = 0);
+
     PBR_SHARED bool newtonRaphson(Float x0, Float* sol, std::function<Float(Float)> f, std::function<Float(Float)> df, uint32 iters);
 
     // Short typedefs for external usage
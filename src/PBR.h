@@ -32,6 +32,20 @@
 #define PBR_GNUC
 #endif
 
+// SIMD instruction sets available at compile time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBR_SSE2
+#endif
+
+#if defined(__AVX2__)
+#define PBR_AVX2
+#endif
+
+// MSVC has no F16C flag, but every AVX2 CPU supports it
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define PBR_F16C
+#endif
+
 #if defined(_MSC_VER) && _MSC_VER == 1800
 #define PBR_MSVC2013
 #endif
@@ -0,0 +1,809 @@
+#include <BlockCompress.h>
+#include <PixelOps.h>
+#include <SIMD.h>
+
+#include <cstring>
+
+using namespace pbr;
+using namespace pbr::simd;
+
+namespace {
+    static PBR_CONSTEXPR float MAX_ERROR = 1e30f;
+
+    // Interpolation weights of 4-bit BC7 indices, out of 64
+    static const uint32 BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Pixels of a block, one array per channel so they load as vectors
+    struct BlockPixels {
+        float c[4][16];
+
+        BlockPixels(const uint8* rgba) {
+            for (uint32 i = 0; i < 16; ++i)
+                for (uint32 ch = 0; ch < 4; ++ch)
+                    c[ch][i] = rgba[i * 4 + ch];
+        }
+    };
+
+    struct BitWriter {
+        uint8* data;
+        uint32 pos;
+
+        BitWriter(uint8* data) : data(data), pos(0) {
+            memset(data, 0, 16);
+        }
+
+        void write(uint32 value, uint32 bits) {
+            for (uint32 b = 0; b < bits; ++b, ++pos)
+                data[pos >> 3] |= ((value >> b) & 1) << (pos & 7);
+        }
+    };
+
+    struct BitReader {
+        const uint8* data;
+        uint32 pos;
+
+        BitReader(const uint8* data) : data(data), pos(0) { }
+
+        uint32 read(uint32 bits) {
+            uint32 value = 0;
+            for (uint32 b = 0; b < bits; ++b, ++pos)
+                value |= ((data[pos >> 3] >> (pos & 7)) & 1) << b;
+
+            return value;
+        }
+    };
+
+    inline float clampByte(float v) {
+        return std::min(std::max(v, 0.0f), 255.0f);
+    }
+
+    // Picks the closest palette entry for every pixel, comparing channels
+    // [firstChan, firstChan + nChan). Returns the total squared error.
+    float selectIndices(const BlockPixels& px, uint32 firstChan, uint32 nChan,
+                        const float (*palette)[4], uint32 numEntries, uint8* indices, float* errors) {
+        float total = 0.0f;
+
+        for (uint32 i = 0; i < 16; i += WIDTH) {
+            vfloat best    = set1(MAX_ERROR);
+            vfloat bestIdx = set1(0.0f);
+
+            for (uint32 k = 0; k < numEntries; ++k) {
+                vfloat err = set1(0.0f);
+                for (uint32 ch = firstChan; ch < firstChan + nChan; ++ch) {
+                    vfloat d = sub(load(px.c[ch] + i), set1(palette[k][ch]));
+                    err = add(err, mul(d, d));
+                }
+
+                vfloat closer = greater(best, err);
+                best    = select(closer, err, best);
+                bestIdx = select(closer, set1((float)k), bestIdx);
+            }
+
+            float idx[WIDTH];
+            store(errors + i, best);
+            store(idx, bestIdx);
+
+            for (uint32 j = 0; j < WIDTH; ++j) {
+                indices[i + j] = (uint8)idx[j];
+                total += errors[i + j];
+            }
+        }
+
+        return total;
+    }
+
+    // Mean and principal axis of the weighted pixels, by power iteration
+    void principalAxis(const BlockPixels& px, uint32 nChan, const float* weight, float* mean, float* axis) {
+        float total = 0.0f;
+        float cov[4][4] = { };
+
+        for (uint32 ch = 0; ch < nChan; ++ch)
+            mean[ch] = 0.0f;
+
+        for (uint32 i = 0; i < 16; ++i) {
+            float w = weight ? weight[i] : 1.0f;
+            total += w;
+
+            for (uint32 ch = 0; ch < nChan; ++ch)
+                mean[ch] += w * px.c[ch][i];
+        }
+
+        for (uint32 ch = 0; ch < nChan; ++ch)
+            mean[ch] /= total;
+
+        for (uint32 i = 0; i < 16; ++i) {
+            float w = weight ? weight[i] : 1.0f;
+
+            float d[4];
+            for (uint32 ch = 0; ch < nChan; ++ch)
+                d[ch] = px.c[ch][i] - mean[ch];
+
+            for (uint32 a = 0; a < nChan; ++a)
+                for (uint32 b = 0; b < nChan; ++b)
+                    cov[a][b] += w * d[a] * d[b];
+        }
+
+        // Start from the channel with the largest spread
+        uint32 widest = 0;
+        for (uint32 ch = 1; ch < nChan; ++ch)
+            if (cov[ch][ch] > cov[widest][widest])
+                widest = ch;
+
+        for (uint32 ch = 0; ch < nChan; ++ch)
+            axis[ch] = cov[widest][ch];
+
+        for (uint32 iter = 0; iter < 8; ++iter) {
+            float v[4] = { };
+            float norm = 0.0f;
+
+            for (uint32 a = 0; a < nChan; ++a) {
+                for (uint32 b = 0; b < nChan; ++b)
+                    v[a] += cov[a][b] * axis[b];
+
+                norm = std::max(norm, std::abs(v[a]));
+            }
+
+            if (norm == 0.0f)
+                break;
+
+            for (uint32 ch = 0; ch < nChan; ++ch)
+                axis[ch] = v[ch] / norm;
+        }
+
+        float len = 0.0f;
+        for (uint32 ch = 0; ch < nChan; ++ch)
+            len += axis[ch] * axis[ch];
+
+        // Flat blocks have no axis, any direction works
+        len = std::sqrt(len);
+        for (uint32 ch = 0; ch < nChan; ++ch)
+            axis[ch] = (len > 0.0f) ? axis[ch] / len : 1.0f / std::sqrt((float)nChan);
+    }
+
+    // Endpoints along the principal axis that enclose the weighted pixels
+    void axisEndpoints(const BlockPixels& px, uint32 nChan, const float* weight, float* e0, float* e1) {
+        float mean[4], axis[4];
+        principalAxis(px, nChan, weight, mean, axis);
+
+        float tMin = MAX_ERROR, tMax = -MAX_ERROR;
+        for (uint32 i = 0; i < 16; ++i) {
+            if (weight && weight[i] == 0.0f)
+                continue;
+
+            float t = 0.0f;
+            for (uint32 ch = 0; ch < nChan; ++ch)
+                t += (px.c[ch][i] - mean[ch]) * axis[ch];
+
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+
+        for (uint32 ch = 0; ch < nChan; ++ch) {
+            e0[ch] = clampByte(mean[ch] + axis[ch] * tMin);
+            e1[ch] = clampByte(mean[ch] + axis[ch] * tMax);
+        }
+    }
+
+    // Least squares endpoints for pixels placed at fraction t between them
+    bool fitEndpoints(const BlockPixels& px, uint32 firstChan, uint32 nChan,
+                      const float* t, const float* weight, float* e0, float* e1) {
+        float A = 0.0f, B = 0.0f, C = 0.0f;
+        float X0[4] = { }, X1[4] = { };
+
+        for (uint32 i = 0; i < 16; ++i) {
+            float w = weight ? weight[i] : 1.0f;
+            float s = 1.0f - t[i];
+
+            A += w * s * s;
+            B += w * s * t[i];
+            C += w * t[i] * t[i];
+
+            for (uint32 ch = firstChan; ch < firstChan + nChan; ++ch) {
+                X0[ch] += w * s * px.c[ch][i];
+                X1[ch] += w * t[i] * px.c[ch][i];
+            }
+        }
+
+        float det = A * C - B * B;
+        if (std::abs(det) < 1e-6f)
+            return false;
+
+        for (uint32 ch = firstChan; ch < firstChan + nChan; ++ch) {
+            e0[ch] = clampByte((C * X0[ch] - B * X1[ch]) / det);
+            e1[ch] = clampByte((A * X1[ch] - B * X0[ch]) / det);
+        }
+
+        return true;
+    }
+
+    /* ==============================================================================
+            DXT1 color blocks
+     ============================================================================== */
+
+    inline uint32 expand5(uint32 v) { return (v << 3) | (v >> 2); }
+    inline uint32 expand6(uint32 v) { return (v << 2) | (v >> 4); }
+
+    inline uint16 packRGB565(const float* c) {
+        uint32 r = (uint32)(c[0] * 31.0f / 255.0f + 0.5f);
+        uint32 g = (uint32)(c[1] * 63.0f / 255.0f + 0.5f);
+        uint32 b = (uint32)(c[2] * 31.0f / 255.0f + 0.5f);
+
+        return (uint16)((r << 11) | (g << 5) | b);
+    }
+
+    // Palette as the decoder builds it. Blocks with c0 <= c1 are in the
+    // 3 color mode, unless the format always uses 4 colors.
+    void colorPalette(uint16 c0, uint16 c1, bool fourColor, uint8 (*pal)[4]) {
+        uint32 p0[3] = { expand5(c0 >> 11), expand6((c0 >> 5) & 0x3F), expand5(c0 & 0x1F) };
+        uint32 p1[3] = { expand5(c1 >> 11), expand6((c1 >> 5) & 0x3F), expand5(c1 & 0x1F) };
+
+        for (uint32 ch = 0; ch < 3; ++ch) {
+            pal[0][ch] = (uint8)p0[ch];
+            pal[1][ch] = (uint8)p1[ch];
+
+            if (fourColor) {
+                pal[2][ch] = (uint8)((2 * p0[ch] + p1[ch]) / 3);
+                pal[3][ch] = (uint8)((p0[ch] + 2 * p1[ch]) / 3);
+            } else {
+                pal[2][ch] = (uint8)((p0[ch] + p1[ch]) / 2);
+                pal[3][ch] = 0;
+            }
+        }
+
+        pal[0][3] = pal[1][3] = pal[2][3] = 255;
+        pal[3][3] = fourColor ? 255 : 0;
+    }
+
+    // Endpoint pairs whose 2/3 interpolation best matches every 8-bit value,
+    // so flat blocks keep their exact color
+    struct SingleColorTables {
+        uint8 match5[256][2];
+        uint8 match6[256][2];
+
+        SingleColorTables() {
+            build(match5, 32, expand5);
+            build(match6, 64, expand6);
+        }
+
+        static void build(uint8 (*match)[2], uint32 size, uint32 (*expand)(uint32)) {
+            for (int32 v = 0; v < 256; ++v) {
+                int32 bestErr = 1 << 30;
+
+                for (uint32 e0 = 0; e0 < size; ++e0) {
+                    for (uint32 e1 = 0; e1 < size; ++e1) {
+                        int32 x0 = expand(e0);
+                        int32 x1 = expand(e1);
+
+                        // Close endpoints are preferred, decoders round the
+                        // interpolation differently
+                        int32 err = std::abs((2 * x0 + x1) / 3 - v) * 100 + std::abs(x0 - x1) * 3;
+                        if (err < bestErr) {
+                            bestErr = err;
+                            match[v][0] = (uint8)e0;
+                            match[v][1] = (uint8)e1;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    const SingleColorTables& singleColorTables() {
+        static const SingleColorTables tables;
+        return tables;
+    }
+
+    void writeColorBlock(uint16 c0, uint16 c1, uint32 bits, uint8* out) {
+        out[0] = (uint8)(c0 & 0xFF);
+        out[1] = (uint8)(c0 >> 8);
+        out[2] = (uint8)(c1 & 0xFF);
+        out[3] = (uint8)(c1 >> 8);
+        memcpy(out + 4, &bits, 4);
+    }
+
+    bool isFlatColor(const BlockPixels& px) {
+        for (uint32 i = 1; i < 16; ++i)
+            for (uint32 ch = 0; ch < 3; ++ch)
+                if (px.c[ch][i] != px.c[ch][0])
+                    return false;
+
+        return true;
+    }
+
+    // Color part of DXT blocks. With punchThrough, pixels with alpha below
+    // 128 take the transparent entry of the 3 color mode.
+    void encodeColor(const BlockPixels& px, bool punchThrough, uint8* out) {
+        float  weight[16];
+        uint32 numOpaque = 0;
+        for (uint32 i = 0; i < 16; ++i) {
+            weight[i] = (!punchThrough || px.c[3][i] >= 128.0f) ? 1.0f : 0.0f;
+            numOpaque += (uint32)weight[i];
+        }
+
+        if (numOpaque == 0) {
+            writeColorBlock(0, 0, 0xFFFFFFFF, out);
+            return;
+        }
+
+        bool threeColor = numOpaque < 16;
+
+        if (!threeColor && isFlatColor(px)) {
+            const SingleColorTables& tables = singleColorTables();
+            const uint8* r = tables.match5[(uint32)px.c[0][0]];
+            const uint8* g = tables.match6[(uint32)px.c[1][0]];
+            const uint8* b = tables.match5[(uint32)px.c[2][0]];
+
+            uint16 c0 = (uint16)((r[0] << 11) | (g[0] << 5) | b[0]);
+            uint16 c1 = (uint16)((r[1] << 11) | (g[1] << 5) | b[1]);
+
+            // Every pixel takes the 2/3 entry, which moves when swapping
+            if (c0 > c1)
+                writeColorBlock(c0, c1, 0xAAAAAAAA, out);
+            else if (c0 < c1)
+                writeColorBlock(c1, c0, 0xFFFFFFFF, out);
+            else
+                writeColorBlock(c0, c1, 0, out);
+
+            return;
+        }
+
+        float e0[4], e1[4];
+        axisEndpoints(px, 3, weight, e0, e1);
+
+        // Inset the endpoints, the extremes are better covered by the
+        // interpolated colors
+        if (!threeColor) {
+            for (uint32 ch = 0; ch < 3; ++ch) {
+                float inset = (e1[ch] - e0[ch]) / 16.0f;
+                e0[ch] += inset;
+                e1[ch] -= inset;
+            }
+        }
+
+        uint8  indices[16], bestIndices[16];
+        float  errors[16];
+        float  bestErr = MAX_ERROR;
+        uint16 bestC0 = 0, bestC1 = 0;
+
+        for (uint32 iter = 0; iter < 3; ++iter) {
+            uint16 c0 = packRGB565(e0);
+            uint16 c1 = packRGB565(e1);
+
+            // 4 color blocks need c0 > c1, 3 color blocks c0 <= c1
+            if (threeColor ? c0 > c1 : c0 < c1)
+                std::swap(c0, c1);
+
+            bool fourColor = c0 > c1;
+
+            uint8 pal[4][4];
+            float fpal[4][4];
+            colorPalette(c0, c1, fourColor, pal);
+            for (uint32 k = 0; k < 4; ++k)
+                for (uint32 ch = 0; ch < 4; ++ch)
+                    fpal[k][ch] = pal[k][ch];
+
+            selectIndices(px, 0, 3, fpal, fourColor ? 4 : 3, indices, errors);
+
+            float err = 0.0f;
+            for (uint32 i = 0; i < 16; ++i) {
+                if (weight[i] == 0.0f)
+                    indices[i] = 3;
+                else
+                    err += errors[i];
+            }
+
+            if (err < bestErr) {
+                bestErr = err;
+                bestC0  = c0;
+                bestC1  = c1;
+                memcpy(bestIndices, indices, 16);
+            }
+
+            if (bestErr == 0.0f)
+                break;
+
+            // Refit the endpoints to the chosen indices
+            static const float fourT[4]  = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            static const float threeT[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+            float t[16];
+            for (uint32 i = 0; i < 16; ++i)
+                t[i] = fourColor ? fourT[indices[i]] : threeT[indices[i]];
+
+            if (!fitEndpoints(px, 0, 3, t, weight, e0, e1))
+                break;
+        }
+
+        uint32 bits = 0;
+        for (uint32 i = 0; i < 16; ++i)
+            bits |= (uint32)bestIndices[i] << (2 * i);
+
+        writeColorBlock(bestC0, bestC1, bits, out);
+    }
+
+    void decodeColor(const uint8* block, bool fourColor, uint8* rgba) {
+        uint16 c0 = (uint16)(block[0] | (block[1] << 8));
+        uint16 c1 = (uint16)(block[2] | (block[3] << 8));
+
+        uint32 bits;
+        memcpy(&bits, block + 4, 4);
+
+        uint8 pal[4][4];
+        colorPalette(c0, c1, fourColor || c0 > c1, pal);
+
+        for (uint32 i = 0; i < 16; ++i)
+            memcpy(rgba + i * 4, pal[(bits >> (2 * i)) & 3], 4);
+    }
+
+    /* ==============================================================================
+            BC4 single channel blocks, also the alpha of DXT5
+     ============================================================================== */
+
+    void bc4Palette(uint32 a0, uint32 a1, uint8* pal) {
+        pal[0] = (uint8)a0;
+        pal[1] = (uint8)a1;
+
+        if (a0 > a1) {
+            for (uint32 i = 1; i < 7; ++i)
+                pal[i + 1] = (uint8)(((7 - i) * a0 + i * a1 + 3) / 7);
+        } else {
+            for (uint32 i = 1; i < 5; ++i)
+                pal[i + 1] = (uint8)(((5 - i) * a0 + i * a1 + 2) / 5);
+
+            pal[6] = 0;
+            pal[7] = 255;
+        }
+    }
+
+    float selectBC4(const BlockPixels& px, uint32 chan, uint32 a0, uint32 a1, uint8* indices) {
+        uint8 pal[8];
+        bc4Palette(a0, a1, pal);
+
+        float fpal[8][4];
+        for (uint32 k = 0; k < 8; ++k)
+            fpal[k][chan] = pal[k];
+
+        float errors[16];
+        return selectIndices(px, chan, 1, fpal, 8, indices, errors);
+    }
+
+    void encodeBC4(const BlockPixels& px, uint32 chan, uint8* out) {
+        const float* values = px.c[chan];
+
+        float lo = 255.0f, hi = 0.0f;
+        float innerLo = 255.0f, innerHi = 0.0f;
+        for (uint32 i = 0; i < 16; ++i) {
+            lo = std::min(lo, values[i]);
+            hi = std::max(hi, values[i]);
+
+            if (values[i] > 0.0f && values[i] < 255.0f) {
+                innerLo = std::min(innerLo, values[i]);
+                innerHi = std::max(innerHi, values[i]);
+            }
+        }
+
+        uint8  indices[16], bestIndices[16] = { };
+        uint32 bestA0 = (uint32)hi, bestA1 = (uint32)lo;
+        float  bestErr = MAX_ERROR;
+
+        if (hi > lo) {
+            // 8 value mode, refined towards the least squares endpoints
+            float e0[4], e1[4];
+            e0[chan] = hi;
+            e1[chan] = lo;
+
+            for (uint32 iter = 0; iter < 3; ++iter) {
+                uint32 a0 = (uint32)(e0[chan] + 0.5f);
+                uint32 a1 = (uint32)(e1[chan] + 0.5f);
+                if (a0 < a1)
+                    std::swap(a0, a1);
+                if (a0 == a1)
+                    break;
+
+                float err = selectBC4(px, chan, a0, a1, indices);
+                if (err < bestErr) {
+                    bestErr = err;
+                    bestA0  = a0;
+                    bestA1  = a1;
+                    memcpy(bestIndices, indices, 16);
+                }
+
+                if (bestErr == 0.0f)
+                    break;
+
+                float t[16];
+                for (uint32 i = 0; i < 16; ++i)
+                    t[i] = (indices[i] < 2) ? (float)indices[i] : (indices[i] - 1) / 7.0f;
+
+                if (!fitEndpoints(px, chan, 1, t, nullptr, e0, e1))
+                    break;
+            }
+
+            // 6 value mode, for blocks that also hold 0 or 255
+            if (bestErr > 0.0f && (lo == 0.0f || hi == 255.0f) && innerLo <= innerHi) {
+                uint32 a0 = (uint32)innerLo;
+                uint32 a1 = (uint32)innerHi;
+
+                float err = selectBC4(px, chan, a0, a1, indices);
+                if (err < bestErr) {
+                    bestErr = err;
+                    bestA0  = a0;
+                    bestA1  = a1;
+                    memcpy(bestIndices, indices, 16);
+                }
+            }
+        }
+
+        uint64 bits = 0;
+        for (uint32 i = 0; i < 16; ++i)
+            bits |= (uint64)bestIndices[i] << (3 * i);
+
+        out[0] = (uint8)bestA0;
+        out[1] = (uint8)bestA1;
+        for (uint32 b = 0; b < 6; ++b)
+            out[2 + b] = (uint8)(bits >> (8 * b));
+    }
+
+    void decodeBC4(const uint8* block, uint32 chan, uint8* rgba) {
+        uint8 pal[8];
+        bc4Palette(block[0], block[1], pal);
+
+        uint64 bits = 0;
+        for (uint32 b = 0; b < 6; ++b)
+            bits |= (uint64)block[2 + b] << (8 * b);
+
+        for (uint32 i = 0; i < 16; ++i)
+            rgba[i * 4 + chan] = pal[(bits >> (3 * i)) & 7];
+    }
+
+    /* ==============================================================================
+            BC7 mode 6, one subset with RGBA endpoints and 4-bit indices
+     ============================================================================== */
+
+    void bc7Palette(const uint32* e0, const uint32* e1, uint8 (*pal)[4]) {
+        for (uint32 k = 0; k < 16; ++k)
+            for (uint32 ch = 0; ch < 4; ++ch)
+                pal[k][ch] = (uint8)(((64 - BC7_WEIGHTS[k]) * e0[ch] + BC7_WEIGHTS[k] * e1[ch] + 32) >> 6);
+    }
+
+    void encodeBC7(const BlockPixels& px, uint8* out) {
+        float e0[4], e1[4];
+        axisEndpoints(px, 4, nullptr, e0, e1);
+
+        uint8  indices[16], bestIndices[16];
+        float  errors[16];
+        float  bestErr = MAX_ERROR;
+        uint32 bestQ0[4] = { }, bestQ1[4] = { };
+        uint32 bestP0 = 0, bestP1 = 0;
+
+        for (uint32 iter = 0; iter < 3; ++iter) {
+            // Endpoints are 7 bits per channel plus a shared low bit
+            for (uint32 p = 0; p < 4; ++p) {
+                uint32 p0 = p & 1;
+                uint32 p1 = p >> 1;
+
+                uint32 q0[4], q1[4], v0[4], v1[4];
+                for (uint32 ch = 0; ch < 4; ++ch) {
+                    q0[ch] = (uint32)std::min(std::max((e0[ch] - p0) * 0.5f + 0.5f, 0.0f), 127.0f);
+                    q1[ch] = (uint32)std::min(std::max((e1[ch] - p1) * 0.5f + 0.5f, 0.0f), 127.0f);
+                    v0[ch] = (q0[ch] << 1) | p0;
+                    v1[ch] = (q1[ch] << 1) | p1;
+                }
+
+                uint8 pal[16][4];
+                float fpal[16][4];
+                bc7Palette(v0, v1, pal);
+                for (uint32 k = 0; k < 16; ++k)
+                    for (uint32 ch = 0; ch < 4; ++ch)
+                        fpal[k][ch] = pal[k][ch];
+
+                float err = selectIndices(px, 0, 4, fpal, 16, indices, errors);
+                if (err < bestErr) {
+                    bestErr = err;
+                    bestP0  = p0;
+                    bestP1  = p1;
+                    memcpy(bestQ0, q0, sizeof(q0));
+                    memcpy(bestQ1, q1, sizeof(q1));
+                    memcpy(bestIndices, indices, 16);
+                }
+            }
+
+            if (bestErr == 0.0f)
+                break;
+
+            float t[16];
+            for (uint32 i = 0; i < 16; ++i)
+                t[i] = BC7_WEIGHTS[bestIndices[i]] / 64.0f;
+
+            if (!fitEndpoints(px, 0, 4, t, nullptr, e0, e1))
+                break;
+        }
+
+        // The first index is stored without its top bit, which must be 0
+        if (bestIndices[0] >= 8) {
+            std::swap(bestQ0, bestQ1);
+            std::swap(bestP0, bestP1);
+
+            for (uint32 i = 0; i < 16; ++i)
+                bestIndices[i] = 15 - bestIndices[i];
+        }
+
+        BitWriter writer(out);
+        writer.write(1 << 6, 7);
+
+        for (uint32 ch = 0; ch < 4; ++ch) {
+            writer.write(bestQ0[ch], 7);
+            writer.write(bestQ1[ch], 7);
+        }
+
+        writer.write(bestP0, 1);
+        writer.write(bestP1, 1);
+
+        writer.write(bestIndices[0], 3);
+        for (uint32 i = 1; i < 16; ++i)
+            writer.write(bestIndices[i], 4);
+    }
+
+    bool decodeBC7(const uint8* block, uint8* rgba) {
+        if ((block[0] & 0x7F) != (1 << 6)) {
+            memset(rgba, 0, 64);
+            return false; // Error
+        }
+
+        BitReader reader(block);
+        reader.read(7);
+
+        uint32 e0[4], e1[4];
+        for (uint32 ch = 0; ch < 4; ++ch) {
+            e0[ch] = reader.read(7) << 1;
+            e1[ch] = reader.read(7) << 1;
+        }
+
+        uint32 p0 = reader.read(1);
+        uint32 p1 = reader.read(1);
+        for (uint32 ch = 0; ch < 4; ++ch) {
+            e0[ch] |= p0;
+            e1[ch] |= p1;
+        }
+
+        uint8 pal[16][4];
+        bc7Palette(e0, e1, pal);
+
+        for (uint32 i = 0; i < 16; ++i)
+            memcpy(rgba + i * 4, pal[reader.read(i == 0 ? 3 : 4)], 4);
+
+        return true;
+    }
+}
+
+void pbr::encodeBlock(ImageFormat format, const uint8* rgba, uint8* block) {
+    BlockPixels px(rgba);
+
+    switch (format) {
+        case IMGFMT_DXT1:
+            encodeColor(px, true, block);
+            break;
+        case IMGFMT_DXT3:
+            // Explicit 4-bit alpha
+            for (uint32 i = 0; i < 16; i += 2) {
+                uint32 a0 = (rgba[i * 4 + 3] * 15 + 127) / 255;
+                uint32 a1 = (rgba[i * 4 + 7] * 15 + 127) / 255;
+                block[i / 2] = (uint8)(a0 | (a1 << 4));
+            }
+
+            encodeColor(px, false, block + 8);
+            break;
+        case IMGFMT_DXT5:
+            encodeBC4(px, 3, block);
+            encodeColor(px, false, block + 8);
+            break;
+        case IMGFMT_ATI1N:
+            encodeBC4(px, 0, block);
+            break;
+        case IMGFMT_ATI2N:
+            encodeBC4(px, 0, block);
+            encodeBC4(px, 1, block + 8);
+            break;
+        case IMGFMT_BC7:
+            encodeBC7(px, block);
+            break;
+        default:
+            // Error
+            break;
+    }
+}
+
+bool pbr::decodeBlock(ImageFormat format, const uint8* block, uint8* rgba) {
+    // Channels missing from the format read as 0, with alpha 1
+    static const uint8 empty[4] = { 0, 0, 0, 255 };
+    for (uint32 i = 0; i < 16; ++i)
+        memcpy(rgba + i * 4, empty, 4);
+
+    switch (format) {
+        case IMGFMT_DXT1:
+            decodeColor(block, false, rgba);
+            break;
+        case IMGFMT_DXT3:
+            decodeColor(block + 8, true, rgba);
+            for (uint32 i = 0; i < 16; ++i)
+                rgba[i * 4 + 3] = (uint8)(((block[i / 2] >> (4 * (i & 1))) & 0xF) * 17);
+            break;
+        case IMGFMT_DXT5:
+            decodeColor(block + 8, true, rgba);
+            decodeBC4(block, 3, rgba);
+            break;
+        case IMGFMT_ATI1N:
+            decodeBC4(block, 0, rgba);
+            break;
+        case IMGFMT_ATI2N:
+            decodeBC4(block, 0, rgba);
+            decodeBC4(block + 8, 1, rgba);
+            break;
+        case IMGFMT_BC7:
+            return decodeBC7(block, rgba);
+        default:
+            return false; // Error
+    }
+
+    return true;
+}
+
+float pbr::computePSNR(const Image& reference, const Image& image, uint32 lvl) {
+    if (reference.width() != image.width() || reference.height() != image.height() ||
+        reference.depth() != image.depth() || lvl >= reference.numLevels() || lvl >= image.numLevels())
+        return 0.0f;
+
+    // Compressed images are compared through decoded copies, that read
+    // the blocks in place
+    Image copies[2];
+    const Image* images[2] = { &reference, &image };
+    for (uint32 i = 0; i < 2; ++i) {
+        const Image* img = images[i];
+        if (!isCompressed(img->format()))
+            continue;
+
+        copies[i].viewImage(img->format(), img->width(), img->height(), img->depth(), img->data(0), img->numLevels());
+        if (!copies[i].decompress())
+            return 0.0f;
+
+        images[i] = &copies[i];
+    }
+
+    ImageFormat fmtA = images[0]->format();
+    ImageFormat fmtB = images[1]->format();
+    if (!isRowConvertible(fmtA) || !isRowConvertible(fmtB))
+        return 0.0f;
+
+    uint32 nA = formatToNumChannels(fmtA);
+    uint32 nB = formatToNumChannels(fmtB);
+    uint32 nChan = std::min(nA, nB);
+
+    uint32 w = mipDimension(image.width(), lvl);
+    uint32 rows = mipDimension(image.height(), lvl) * mipDimension(image.depth(), lvl);
+
+    uint64 rowSizeA = (uint64)w * formatToBytesPerPixel(fmtA);
+    uint64 rowSizeB = (uint64)w * formatToBytesPerPixel(fmtB);
+
+    std::vector<float> rowA((size_t)w * nA);
+    std::vector<float> rowB((size_t)w * nB);
+
+    double sum = 0.0;
+    for (uint32 y = 0; y < rows; ++y) {
+        decodeRow(fmtA, images[0]->data(lvl) + y * rowSizeA, &rowA[0], w);
+        decodeRow(fmtB, images[1]->data(lvl) + y * rowSizeB, &rowB[0], w);
+
+        for (uint32 x = 0; x < w; ++x) {
+            for (uint32 ch = 0; ch < nChan; ++ch) {
+                double d = rowA[x * nA + ch] - rowB[x * nB + ch];
+                sum += d * d;
+            }
+        }
+    }
+
+    // Normalized formats peak at 1
+    double mse = sum / ((double)w * rows * nChan);
+    if (mse == 0.0)
+        return FLOAT_INFINITY;
+
+    return (float)(10.0 * std::log10(1.0 / mse));
+}
@@ -0,0 +1,24 @@
+#ifndef __PBR_BLOCKCOMPRESS_H__
+#define __PBR_BLOCKCOMPRESS_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // Encodes one 4x4 block of RGBA8 pixels, stored row by row. BC4 keeps
+    // the red channel, BC5 red and green, and DXT1 switches to its 1-bit
+    // alpha mode on blocks with alpha below 128. BC7 blocks use mode 6.
+    void encodeBlock(ImageFormat format, const uint8* rgba, uint8* block);
+
+    // Decodes one block to RGBA8. Only mode 6 BC7 blocks are supported,
+    // false is returned for any other mode.
+    bool decodeBlock(ImageFormat format, const uint8* block, uint8* rgba);
+
+    // Peak signal to noise ratio of a level against a reference, in dB,
+    // over the channels both images have. Compressed images are decoded.
+    float computePSNR(const Image& reference, const Image& image, uint32 lvl = 0);
+
+}
+
+#endif
@@ -0,0 +1,505 @@
+#include <EXR.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <PixelOps.h>
+
+#include <cstring>
+#include <fstream>
+#include <atomic>
+
+#include <zlib.h>
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR uint32 EXR_MAGIC   = 20000630;
+    static PBR_CONSTEXPR uint32 EXR_VERSION = 2;
+
+    // Version flags of the features we do not read
+    static PBR_CONSTEXPR uint32 EXR_TILED = 0x200;
+    static PBR_CONSTEXPR uint32 EXR_DEEP  = 0x800;
+    static PBR_CONSTEXPR uint32 EXR_MULTI = 0x1000;
+
+    enum EXRPixelType : int32 {
+        EXR_UINT  = 0,
+        EXR_HALF  = 1,
+        EXR_FLOAT = 2
+    };
+
+    struct EXRChannel {
+        std::string  name;
+        EXRPixelType type;
+        uint32 size;   // Bytes per value
+        int32  dst;    // Channel in the image, -1 if skipped
+    };
+
+    uint32 linesPerBlock(uint8 compression) {
+        return (compression == EXR_ZIP) ? 16 : 1;
+    }
+
+    struct Reader {
+        const uint8* data;
+        uint64 size;
+        uint64 pos;
+
+        bool read(void* dst, uint64 n) {
+            if (pos + n > size)
+                return false;
+
+            memcpy(dst, data + pos, (size_t)n);
+            pos += n;
+
+            return true;
+        }
+
+        bool readString(std::string& str) {
+            str.clear();
+            while (pos < size) {
+                char c = (char)data[pos++];
+                if (c == '\0')
+                    return true;
+
+                str += c;
+            }
+
+            return false;
+        }
+    };
+
+    bool readChannels(Reader& attr, std::vector<EXRChannel>& channels) {
+        std::string name;
+        while (attr.readString(name) && !name.empty()) {
+            EXRChannel channel;
+            channel.name = name;
+            channel.dst  = -1;
+
+            uint8 linear[4];
+            int32 xSampling, ySampling;
+            if (!attr.read(&channel.type, 4) || !attr.read(linear, 4) ||
+                !attr.read(&xSampling, 4) || !attr.read(&ySampling, 4))
+                return false;
+
+            // Subsampled channels are not supported
+            if (xSampling != 1 || ySampling != 1 || channel.type > EXR_FLOAT)
+                return false;
+
+            channel.size = (channel.type == EXR_HALF) ? 2 : 4;
+            channels.push_back(channel);
+        }
+
+        return !channels.empty();
+    }
+
+    // Undoes the byte predictor and the split done before ZIP and RLE
+    void unpredict(uint8* src, uint8* dst, uint64 size) {
+        for (uint64 i = 1; i < size; ++i)
+            src[i] = (uint8)(src[i - 1] + src[i] - 128);
+
+        const uint8* t1 = src;
+        const uint8* t2 = src + (size + 1) / 2;
+
+        for (uint64 i = 0; i < size; i += 2) {
+            dst[i] = *t1++;
+            if (i + 1 < size)
+                dst[i + 1] = *t2++;
+        }
+    }
+
+    void predict(const uint8* src, uint8* dst, uint64 size) {
+        uint8* t1 = dst;
+        uint8* t2 = dst + (size + 1) / 2;
+
+        for (uint64 i = 0; i < size; i += 2) {
+            *t1++ = src[i];
+            if (i + 1 < size)
+                *t2++ = src[i + 1];
+        }
+
+        uint8 prev = dst[0];
+        for (uint64 i = 1; i < size; ++i) {
+            uint8 cur = dst[i];
+            dst[i] = (uint8)(cur - prev + 128);
+            prev = cur;
+        }
+    }
+
+    bool decodeRLE(const uint8* src, uint64 srcSize, uint8* dst, uint64 dstSize) {
+        uint64 in = 0, out = 0;
+        while (in < srcSize) {
+            int32 count = (int8)src[in++];
+            if (count < 0) {
+                // Literal bytes
+                count = -count;
+                if (in + count > srcSize || out + count > dstSize)
+                    return false;
+
+                memcpy(dst + out, src + in, count);
+                in  += count;
+                out += count;
+            } else {
+                // Repeated byte
+                if (in >= srcSize || out + count + 1 > dstSize)
+                    return false;
+
+                memset(dst + out, src[in++], count + 1);
+                out += count + 1;
+            }
+        }
+
+        return out == dstSize;
+    }
+
+    void encodeRLE(const uint8* src, uint64 size, std::vector<uint8>& out) {
+        static PBR_CONSTEXPR uint64 MIN_RUN = 3;
+        static PBR_CONSTEXPR uint64 MAX_RUN = 127;
+
+        uint64 run = 0;
+        while (run < size) {
+            uint64 end = run + 1;
+            while (end < size && src[end] == src[run] && end - run - 1 < MAX_RUN)
+                end++;
+
+            if (end - run >= MIN_RUN) {
+                out.push_back((uint8)(end - run - 1));
+                out.push_back(src[run]);
+            } else {
+                // Literal bytes until the next run of MIN_RUN
+                end = run;
+                while (end < size && end - run < MAX_RUN &&
+                       !(end + 2 < size && src[end] == src[end + 1] && src[end] == src[end + 2]))
+                    end++;
+
+                out.push_back((uint8)(int8)-(int32)(end - run));
+                out.insert(out.end(), src + run, src + end);
+            }
+
+            run = end;
+        }
+    }
+
+    template<typename T>
+    void writeAttr(std::string& header, const char* name, const char* type, const T& value) {
+        int32 size = sizeof(T);
+
+        header.append(name, strlen(name) + 1);
+        header.append(type, strlen(type) + 1);
+        header.append((const char*)&size, 4);
+        header.append((const char*)&value, sizeof(T));
+    }
+}
+
+bool pbr::loadEXR(const std::string& filePath, Image& image) {
+    MappedFile file;
+    if (!file.open(filePath))
+        return false;
+
+    Reader reader = { file.data(), file.size(), 0 };
+
+    uint32 magic, version;
+    if (!reader.read(&magic, 4) || !reader.read(&version, 4))
+        return false;
+
+    if (magic != EXR_MAGIC || (version & 0xFF) != EXR_VERSION ||
+        (version & (EXR_TILED | EXR_DEEP | EXR_MULTI)))
+        return false;
+
+    // Attributes
+    std::vector<EXRChannel> channels;
+    uint8 compression = 255;
+    int32 window[4]   = { 0, 0, -1, -1 };
+
+    std::string name, type;
+    while (reader.readString(name) && !name.empty()) {
+        int32 size;
+        if (!reader.readString(type) || !reader.read(&size, 4) ||
+            size < 0 || reader.pos + size > reader.size)
+            return false;
+
+        Reader attr = { reader.data, reader.pos + size, reader.pos };
+        reader.pos += size;
+
+        if (name == "channels" && type == "chlist") {
+            if (!readChannels(attr, channels))
+                return false;
+        } else if (name == "compression") {
+            if (!attr.read(&compression, 1))
+                return false;
+        } else if (name == "dataWindow" && type == "box2i") {
+            if (!attr.read(window, sizeof(window)))
+                return false;
+        }
+    }
+
+    if (compression > EXR_ZIP)
+        return false;
+
+    int32 width  = window[2] - window[0] + 1;
+    int32 height = window[3] - window[1] + 1;
+    if (width <= 0 || height <= 0 || channels.empty())
+        return false;
+
+    // Pick the channels to load, their order in the file is alphabetical
+    static const char* rgba[] = { "R", "G", "B", "A" };
+
+    uint32 nChan = 0;
+    bool   isFloat = false;
+    for (uint32 c = 0; c < 4; ++c) {
+        for (EXRChannel& channel : channels) {
+            if (channel.name == rgba[c] && nChan == c) {
+                channel.dst = nChan++;
+                isFloat |= channel.type != EXR_HALF;
+            }
+        }
+    }
+
+    // Luminance only images
+    if (nChan == 0) {
+        for (EXRChannel& channel : channels) {
+            if (channel.name == "Y") {
+                channel.dst = nChan++;
+                isFloat |= channel.type != EXR_HALF;
+            }
+        }
+    }
+
+    for (const EXRChannel& channel : channels) {
+        if (channel.dst >= 0 && channel.type == EXR_UINT)
+            return false;
+    }
+
+    if (nChan == 0)
+        return false;
+
+    static const ImageFormat halfFormats[]  = { IMGFMT_R16F, IMGFMT_RG16F, IMGFMT_RGB16F, IMGFMT_RGBA16F };
+    static const ImageFormat floatFormats[] = { IMGFMT_R32F, IMGFMT_RG32F, IMGFMT_RGB32F, IMGFMT_RGBA32F };
+
+    ImageFormat format = isFloat ? floatFormats[nChan - 1] : halfFormats[nChan - 1];
+
+    // Offset table
+    uint32 blockLines = linesPerBlock(compression);
+    uint32 numBlocks  = (height + blockLines - 1) / blockLines;
+
+    std::vector<uint64> offsets(numBlocks);
+    if (!reader.read(&offsets[0], sizeof(uint64) * numBlocks))
+        return false;
+
+    uint64 lineSize = 0;
+    for (const EXRChannel& channel : channels)
+        lineSize += (uint64)width * channel.size;
+
+    image.init(format, width, height, 1);
+
+    uint32 pixelSize = formatToBytesPerPixel(format);
+    uint32 valueSize = formatToBytesPerChannel(format);
+    uint64 rowSize   = (uint64)width * pixelSize;
+
+    // Blocks are independent, decode them in parallel
+    std::atomic<bool> success(true);
+    Workers.parallelFor(numBlocks, [&](uint32 b) {
+        Reader block = { file.data(), file.size(), offsets[b] };
+
+        int32 y, dataSize;
+        if (!block.read(&y, 4) || !block.read(&dataSize, 4) ||
+            dataSize < 0 || block.pos + dataSize > block.size ||
+            y < window[1] || y > window[3] || (y - window[1]) % blockLines != 0) {
+            success = false;
+            return;
+        }
+
+        uint32 numLines = std::min<uint32>(blockLines, window[3] - y + 1);
+        uint64 rawSize  = numLines * lineSize;
+
+        const uint8* raw = block.data + block.pos;
+
+        // Blocks that did not compress are stored as they are
+        std::vector<uint8> buffer;
+        if ((uint64)dataSize != rawSize) {
+            if (compression == EXR_NONE) {
+                success = false;
+                return;
+            }
+
+            std::vector<uint8> tmp((size_t)rawSize);
+            if (compression == EXR_RLE) {
+                if (!decodeRLE(raw, dataSize, &tmp[0], rawSize)) {
+                    success = false;
+                    return;
+                }
+            } else {
+                uLongf tmpSize = (uLongf)rawSize;
+                if (uncompress(&tmp[0], &tmpSize, raw, (uLong)dataSize) != Z_OK || tmpSize != rawSize) {
+                    success = false;
+                    return;
+                }
+            }
+
+            buffer.resize((size_t)rawSize);
+            unpredict(&tmp[0], &buffer[0], rawSize);
+            raw = &buffer[0];
+        }
+
+        // Scanlines hold one plane per channel, move them to pixels
+        for (uint32 l = 0; l < numLines; ++l) {
+            const uint8* src = raw + l * lineSize;
+            uint8* row = image.data(0) + (uint64)(y - window[1] + l) * rowSize;
+
+            for (const EXRChannel& channel : channels) {
+                if (channel.dst >= 0) {
+                    uint8* dst = row + channel.dst * valueSize;
+
+                    if (channel.size == valueSize) {
+                        for (int32 x = 0; x < width; ++x)
+                            memcpy(dst + x * pixelSize, src + x * valueSize, valueSize);
+                    } else {
+                        // Half channel in a float image
+                        for (int32 x = 0; x < width; ++x) {
+                            float v = halfToFloat(((const uint16*)src)[x]);
+                            memcpy(dst + x * pixelSize, &v, sizeof(float));
+                        }
+                    }
+                }
+
+                src += (uint64)width * channel.size;
+            }
+        }
+    });
+
+    return success;
+}
+
+bool pbr::saveEXR(const std::string& filePath, const Image& image, uint32 lvl, EXRCompression compression) {
+    ImageFormat format = image.format();
+    if (format < IMGFMT_R16F || format > IMGFMT_RGBA32F || lvl >= image.numLevels() || image.depth() > 1)
+        return false;
+
+    uint32 width  = mipDimension(image.width(),  lvl);
+    uint32 height = mipDimension(image.height(), lvl);
+    uint32 nChan  = image.numChannels();
+
+    uint32 valueSize = formatToBytesPerChannel(format);
+    uint32 pixelSize = formatToBytesPerPixel(format);
+    int32  pixelType = (valueSize == 2) ? EXR_HALF : EXR_FLOAT;
+
+    // Channels must be listed in alphabetical order
+    static const char*  names[4][4] = { { "Y" }, { "G", "R" }, { "B", "G", "R" }, { "A", "B", "G", "R" } };
+    static const uint32 order[4][4] = { { 0 }, { 1, 0 }, { 2, 1, 0 }, { 3, 2, 1, 0 } };
+
+    std::string chlist;
+    for (uint32 c = 0; c < nChan; ++c) {
+        int32 fields[4] = { pixelType, 0, 1, 1 };
+
+        chlist.append(names[nChan - 1][c], 2);
+        chlist.append((const char*)fields, sizeof(fields));
+    }
+    chlist.append(1, '\0');
+
+    // Header
+    std::string header;
+    uint32 magic   = EXR_MAGIC;
+    uint32 version = EXR_VERSION;
+    header.append((const char*)&magic,   4);
+    header.append((const char*)&version, 4);
+
+    int32 chlistSize = (int32)chlist.size();
+    header.append("channels\0chlist\0", 16);
+    header.append((const char*)&chlistSize, 4);
+    header.append(chlist);
+
+    int32 window[4] = { 0, 0, (int32)width - 1, (int32)height - 1 };
+    float center[2] = { 0.0f, 0.0f };
+
+    writeAttr(header, "compression",        "compression", (uint8)compression);
+    writeAttr(header, "dataWindow",         "box2i",       window);
+    writeAttr(header, "displayWindow",      "box2i",       window);
+    writeAttr(header, "lineOrder",          "lineOrder",   (uint8)0);
+    writeAttr(header, "pixelAspectRatio",   "float",       1.0f);
+    writeAttr(header, "screenWindowCenter", "v2f",         center);
+    writeAttr(header, "screenWindowWidth",  "float",       1.0f);
+    header.append(1, '\0');
+
+    // Encode blocks in parallel
+    uint32 blockLines = linesPerBlock(compression);
+    uint32 numBlocks  = (height + blockLines - 1) / blockLines;
+
+    uint64 lineSize = (uint64)width * pixelSize;
+    uint64 rowSize  = image.size(lvl) / height;
+
+    std::vector<std::vector<uint8>> blocks(numBlocks);
+    std::atomic<bool> success(true);
+    Workers.parallelFor(numBlocks, [&](uint32 b) {
+        uint32 y = b * blockLines;
+        uint32 numLines = std::min(blockLines, height - y);
+        uint64 rawSize  = numLines * lineSize;
+
+        // Pixels to one plane per channel
+        std::vector<uint8> raw((size_t)rawSize);
+        for (uint32 l = 0; l < numLines; ++l) {
+            const uint8* row = image.data(lvl) + (uint64)(y + l) * rowSize;
+            uint8* dst = &raw[l * lineSize];
+
+            for (uint32 c = 0; c < nChan; ++c) {
+                const uint8* src = row + order[nChan - 1][c] * valueSize;
+                for (uint32 x = 0; x < width; ++x)
+                    memcpy(dst + x * valueSize, src + x * pixelSize, valueSize);
+
+                dst += (uint64)width * valueSize;
+            }
+        }
+
+        std::vector<uint8>& out = blocks[b];
+
+        uLongf compSize = 0;
+        if (compression != EXR_NONE) {
+            std::vector<uint8> tmp((size_t)rawSize);
+            predict(&raw[0], &tmp[0], rawSize);
+
+            if (compression == EXR_RLE) {
+                out.resize(8);
+                encodeRLE(&tmp[0], rawSize, out);
+                compSize = (uLongf)(out.size() - 8);
+            } else {
+                compSize = compressBound((uLong)rawSize);
+                out.resize(8 + compSize);
+                if (compress(&out[8], &compSize, &tmp[0], (uLong)rawSize) != Z_OK) {
+                    success = false;
+                    return;
+                }
+            }
+        }
+
+        // Keep the block raw if compression does not pay off
+        int32 dataSize = (int32)rawSize;
+        if (compression != EXR_NONE && compSize < rawSize) {
+            dataSize = (int32)compSize;
+            out.resize(8 + compSize);
+        } else {
+            out.resize(8 + rawSize);
+            memcpy(&out[8], &raw[0], (size_t)rawSize);
+        }
+
+        int32 blockY = (int32)y;
+        memcpy(&out[0], &blockY,   4);
+        memcpy(&out[4], &dataSize, 4);
+    });
+
+    if (!success)
+        return false;
+
+    std::vector<uint64> offsets(numBlocks);
+    uint64 offset = header.size() + sizeof(uint64) * numBlocks;
+    for (uint32 b = 0; b < numBlocks; ++b) {
+        offsets[b] = offset;
+        offset += blocks[b].size();
+    }
+
+    std::ofstream file(filePath, std::ios::out | std::ios::binary);
+    file.write(header.data(), header.size());
+    file.write((const char*)&offsets[0], sizeof(uint64) * numBlocks);
+
+    for (uint32 b = 0; b < numBlocks; ++b)
+        file.write((const char*)&blocks[b][0], blocks[b].size());
+
+    file.close();
+
+    return !file.fail();
+}
@@ -0,0 +1,28 @@
+#ifndef __PBR_EXR_H__
+#define __PBR_EXR_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // Supported compressions, with their ids in the file
+    enum EXRCompression : uint8 {
+        EXR_NONE = 0,
+        EXR_RLE  = 1,
+        EXR_ZIPS = 2, // One scanline per block
+        EXR_ZIP  = 3  // 16 scanlines per block
+    };
+
+    // Single part scanline OpenEXR images with R, G, B, A or Y channels.
+    // Half channels stay half, as IMGFMT_R16F to IMGFMT_RGBA16F, and
+    // files with any float channel load as 32-bit float formats.
+    bool loadEXR(const std::string& filePath, Image& image);
+
+    // Writes one level of a half or float image
+    bool saveEXR(const std::string& filePath, const Image& image, uint32 lvl = 0,
+                 EXRCompression compression = EXR_ZIP);
+
+}
+
+#endif
@@ -0,0 +1,841 @@
+#include <IBL.h>
+
+#include <PBRMath.h>
+#include <PixelOps.h>
+#include <ThreadPool.h>
+#include <SIMD.h>
+
+#include <cstring>
+
+using namespace pbr;
+using namespace pbr::math;
+using namespace pbr::simd;
+
+namespace {
+    // Texels filtered by a single task
+    static PBR_CONSTEXPR uint32 TILE_SIZE = 32;
+
+    // Radiance decoded to RGB32F with its full mip chain
+    struct RadianceCube {
+        Cubemap cube;
+        uint32  size;
+        uint32  levels;
+
+        bool init(const Cubemap& env) {
+            ImageFormat format = env.format();
+            if (!isRowConvertible(format) || env.width() != env.height() || env.numChannels() < 3)
+                return false;
+
+            size = env.width();
+            cube.init(IMGFMT_RGB32F, size, size, 1);
+
+            uint32 nChan = env.numChannels();
+            Workers.parallelFor(6, [&](uint32 f) {
+                std::vector<float> row((size_t)size * nChan);
+                uint64 rowSize = env.size((CubemapFace)f) / size;
+
+                for (uint32 y = 0; y < size; ++y) {
+                    float* dst = (float*)cube.data((CubemapFace)f) + (uint64)y * size * 3;
+                    decodeRow(format, env.data((CubemapFace)f) + y * rowSize, &row[0], size);
+                    remapChannels(&row[0], nChan, dst, 3, size);
+                }
+            });
+
+            if (!cube.generateMipmaps())
+                return false;
+
+            levels = cube.numLevels();
+            return true;
+        }
+
+        void bilinear(uint32 face, uint32 lvl, float s, float t, float* rgb) const {
+            int32 w = (int32)mipDimension(size, lvl);
+            const float* img = (const float*)cube.data((CubemapFace)face, lvl);
+
+            // Texel centers, clamped to the face
+            float x = std::min(std::max(s * w - 0.5f, 0.0f), (float)(w - 1));
+            float y = std::min(std::max(t * w - 0.5f, 0.0f), (float)(w - 1));
+
+            int32 x0 = (int32)x, y0 = (int32)y;
+            int32 x1 = std::min(x0 + 1, w - 1);
+            int32 y1 = std::min(y0 + 1, w - 1);
+            float fx = x - x0, fy = y - y0;
+
+            const float* p00 = img + (y0 * w + x0) * 3;
+            const float* p10 = img + (y0 * w + x1) * 3;
+            const float* p01 = img + (y1 * w + x0) * 3;
+            const float* p11 = img + (y1 * w + x1) * 3;
+
+            for (uint32 c = 0; c < 3; ++c) {
+                float top    = p00[c] + (p10[c] - p00[c]) * fx;
+                float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                rgb[c] += (top + (bottom - top) * fy);
+            }
+        }
+
+        // Accumulates weight times the radiance at a fractional level
+        void trilinear(uint32 face, float s, float t, float lod, float weight, float* rgb) const {
+            lod = std::min(lod, (float)(levels - 1));
+
+            uint32 lvl  = (uint32)lod;
+            float  frac = lod - lvl;
+
+            float texel[3] = { 0.0f, 0.0f, 0.0f };
+            bilinear(face, lvl, s, t, texel);
+
+            for (uint32 c = 0; c < 3; ++c)
+                rgb[c] += texel[c] * weight * (1.0f - frac);
+
+            if (frac > 0.0f) {
+                float next[3] = { 0.0f, 0.0f, 0.0f };
+                bilinear(face, lvl + 1, s, t, next);
+
+                for (uint32 c = 0; c < 3; ++c)
+                    rgb[c] += next[c] * weight * frac;
+            }
+        }
+    };
+
+    // Directions to sample around the normal, in its tangent space, padded
+    // with zero weights to a multiple of the vector width
+    struct LevelSamples {
+        std::vector<float> x, y, z;
+        std::vector<float> weight;
+        std::vector<float> lod;
+
+        float weightSum;
+
+        void add(float lx, float ly, float lz, float w, float l) {
+            x.push_back(lx);
+            y.push_back(ly);
+            z.push_back(lz);
+            weight.push_back(w);
+            lod.push_back(l);
+        }
+
+        void pad() {
+            while (x.size() % WIDTH != 0)
+                add(0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+        }
+    };
+
+    float radicalInverse(uint32 bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    // GGX lobe of a roughness, with N = V = R as in [Karis, 2013]. Each
+    // sample reads the mip whose texels cover the solid angle it stands for.
+    void buildSamples(float roughness, uint32 numSamples, uint32 envSize, float minLod, LevelSamples& samples) {
+        samples.weightSum = 0.0f;
+
+        if (roughness == 0.0f) {
+            samples.add(0.0f, 0.0f, 1.0f, 1.0f, minLod);
+            samples.weightSum = 1.0f;
+            samples.pad();
+            return;
+        }
+
+        float a  = roughness * roughness;
+        float a2 = a * a;
+
+        float texelAngle = 4.0f * (float)PI / (6.0f * envSize * envSize);
+
+        for (uint32 i = 0; i < numSamples; ++i) {
+            float u = (float)i / numSamples;
+            float v = radicalInverse(i);
+
+            float phi      = 2.0f * (float)PI * u;
+            float cosTheta = std::sqrt((1.0f - v) / (1.0f + (a2 - 1.0f) * v));
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+            float hx = sinTheta * std::cos(phi);
+            float hy = sinTheta * std::sin(phi);
+            float hz = cosTheta;
+
+            // Reflect V = N about H
+            float lz = 2.0f * hz * hz - 1.0f;
+            if (lz <= 0.0f)
+                continue;
+
+            float lx = 2.0f * hz * hx;
+            float ly = 2.0f * hz * hy;
+
+            // pdf of L is D(H) * NdotH / (4 * VdotH), where NdotH = VdotH
+            float d   = (hz * hz * (a2 - 1.0f) + 1.0f);
+            float pdf = a2 / ((float)PI * d * d) / 4.0f;
+
+            float sampleAngle = 1.0f / (numSamples * pdf);
+            float lod = std::max(0.5f * std::log2(sampleAngle / texelAngle) + 1.0f, minLod);
+
+            samples.add(lx, ly, lz, lz, lod);
+            samples.weightSum += lz;
+        }
+
+        samples.pad();
+    }
+
+    // Direction through a texel of a face, s and t in [-1, 1]
+    void faceDirection(uint32 face, float s, float t, float* dir) {
+        switch (face) {
+            case CUBE_X_POS: dir[0] =  1.0f; dir[1] =   -t; dir[2] =   -s; break;
+            case CUBE_X_NEG: dir[0] = -1.0f; dir[1] =   -t; dir[2] =    s; break;
+            case CUBE_Y_POS: dir[0] =     s; dir[1] = 1.0f; dir[2] =    t; break;
+            case CUBE_Y_NEG: dir[0] =     s; dir[1] = -1.0f; dir[2] =  -t; break;
+            case CUBE_Z_POS: dir[0] =     s; dir[1] =   -t; dir[2] = 1.0f; break;
+            default:         dir[0] =    -s; dir[1] =   -t; dir[2] = -1.0f; break;
+        }
+
+        float len = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        dir[0] /= len;
+        dir[1] /= len;
+        dir[2] /= len;
+    }
+
+    // Face and [0, 1] coordinates of WIDTH directions, following the
+    // selection rules of OpenGL cubemaps
+    void directionToFace(vfloat x, vfloat y, vfloat z, float* face, float* s, float* t) {
+        vfloat zero = set1(0.0f);
+        vfloat ones = asFloat(seti(-1));
+
+        vfloat ax = simd::max(x, sub(zero, x));
+        vfloat ay = simd::max(y, sub(zero, y));
+        vfloat az = simd::max(z, sub(zero, z));
+        vfloat ma = simd::max(ax, simd::max(ay, az));
+
+        // Ties go to Z, then Y
+        vfloat isZ = select(greater(ma, az), zero, ones);
+        vfloat isY = select(isZ, zero, select(greater(ma, ay), zero, ones));
+
+        vfloat posX = greater(x, zero);
+        vfloat posY = greater(y, zero);
+        vfloat posZ = greater(z, zero);
+
+        vfloat faceX = select(posX, set1(CUBE_X_POS), set1(CUBE_X_NEG));
+        vfloat faceY = select(posY, set1(CUBE_Y_POS), set1(CUBE_Y_NEG));
+        vfloat faceZ = select(posZ, set1(CUBE_Z_POS), set1(CUBE_Z_NEG));
+
+        vfloat negX = sub(zero, x);
+        vfloat negY = sub(zero, y);
+        vfloat negZ = sub(zero, z);
+
+        vfloat sc = select(isZ, select(posZ, x, negX), select(isY, x, select(posX, negZ, z)));
+        vfloat tc = select(isY, select(posY, z, negZ), negY);
+
+        vfloat half = set1(0.5f);
+        vfloat inv  = div(half, ma);
+
+        store(face, select(isZ, faceZ, select(isY, faceY, faceX)));
+        store(s, add(mul(sc, inv), half));
+        store(t, add(mul(tc, inv), half));
+    }
+
+    void filterTile(const RadianceCube& env, const LevelSamples& samples, uint32 face,
+                    uint32 x0, uint32 y0, uint32 size, float* dst) {
+        uint32 x1 = std::min(x0 + TILE_SIZE, size);
+        uint32 y1 = std::min(y0 + TILE_SIZE, size);
+
+        float faces[WIDTH], s[WIDTH], t[WIDTH];
+
+        for (uint32 y = y0; y < y1; ++y) {
+            for (uint32 x = x0; x < x1; ++x) {
+                float n[3];
+                faceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, n);
+
+                // Tangent frame around the normal
+                float up[3] = { 0.0f, 0.0f, 1.0f };
+                if (std::abs(n[2]) > 0.999f) {
+                    up[0] = 1.0f;
+                    up[2] = 0.0f;
+                }
+
+                float tan[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+                float len = std::sqrt(tan[0] * tan[0] + tan[1] * tan[1] + tan[2] * tan[2]);
+                tan[0] /= len; tan[1] /= len; tan[2] /= len;
+
+                float bit[3] = { n[1] * tan[2] - n[2] * tan[1], n[2] * tan[0] - n[0] * tan[2], n[0] * tan[1] - n[1] * tan[0] };
+
+                float rgb[3] = { 0.0f, 0.0f, 0.0f };
+                for (uint32 i = 0; i < samples.x.size(); i += WIDTH) {
+                    vfloat lx = load(&samples.x[i]);
+                    vfloat ly = load(&samples.y[i]);
+                    vfloat lz = load(&samples.z[i]);
+
+                    vfloat dx = add(add(mul(lx, set1(tan[0])), mul(ly, set1(bit[0]))), mul(lz, set1(n[0])));
+                    vfloat dy = add(add(mul(lx, set1(tan[1])), mul(ly, set1(bit[1]))), mul(lz, set1(n[1])));
+                    vfloat dz = add(add(mul(lx, set1(tan[2])), mul(ly, set1(bit[2]))), mul(lz, set1(n[2])));
+
+                    directionToFace(dx, dy, dz, faces, s, t);
+
+                    for (uint32 j = 0; j < WIDTH; ++j) {
+                        float w = samples.weight[i + j];
+                        if (w > 0.0f)
+                            env.trilinear((uint32)faces[j], s[j], t[j], samples.lod[i + j], w, rgb);
+                    }
+                }
+
+                float* out = dst + ((uint64)y * size + x) * 3;
+                out[0] = rgb[0] / samples.weightSum;
+                out[1] = rgb[1] / samples.weightSum;
+                out[2] = rgb[2] / samples.weightSum;
+            }
+        }
+    }
+}
+
+namespace {
+    // Direction through (s, t) of each face, as coefficients of s, t and 1
+    // for each component, following the same layout as faceDirection
+    static const float FACE_AXES[6][3][3] = {
+        { {  0,  0,  1 }, {  0, -1,  0 }, { -1,  0,  0 } },
+        { {  0,  0, -1 }, {  0, -1,  0 }, {  1,  0,  0 } },
+        { {  1,  0,  0 }, {  0,  0,  1 }, {  0,  1,  0 } },
+        { {  1,  0,  0 }, {  0,  0, -1 }, {  0, -1,  0 } },
+        { {  1,  0,  0 }, {  0, -1,  0 }, {  0,  0,  1 } },
+        { { -1,  0,  0 }, {  0, -1,  0 }, {  0,  0, -1 } }
+    };
+
+    // Bands 0, 1 and 2 of the real SH basis
+    void shBasis(vfloat x, vfloat y, vfloat z, vfloat* basis) {
+        basis[0] = set1(0.282095f);
+        basis[1] = mul(set1(0.488603f), y);
+        basis[2] = mul(set1(0.488603f), z);
+        basis[3] = mul(set1(0.488603f), x);
+        basis[4] = mul(set1(1.092548f), mul(x, y));
+        basis[5] = mul(set1(1.092548f), mul(y, z));
+        basis[6] = mul(set1(0.315392f), sub(mul(set1(3.0f), mul(z, z)), set1(1.0f)));
+        basis[7] = mul(set1(1.092548f), mul(x, z));
+        basis[8] = mul(set1(0.546274f), sub(mul(x, x), mul(y, y)));
+    }
+
+    // Sums of radiance times basis and of the solid angles of a face
+    void integrateFace(const Cubemap& env, uint32 face, double sums[SH_COEFFS][3], double& weightSum) {
+        uint32 size  = env.width();
+        uint32 nChan = env.numChannels();
+        uint32 padded = (size + WIDTH - 1) / WIDTH * WIDTH;
+
+        uint64 rowSize = env.size((CubemapFace)face) / size;
+        const float (*axes)[3] = FACE_AXES[face];
+
+        // Texel centers along a row, padding lanes weigh nothing
+        std::vector<float> sCoord(padded, 0.0f), valid(padded, 0.0f);
+        for (uint32 x = 0; x < size; ++x) {
+            sCoord[x] = 2.0f * (x + 0.5f) / size - 1.0f;
+            valid[x]  = 1.0f;
+        }
+
+        std::vector<float> row((size_t)size * nChan);
+        std::vector<float> planes((size_t)padded * 3, 0.0f);
+
+        float lanes[WIDTH];
+        for (uint32 y = 0; y < size; ++y) {
+            decodeRow(env.format(), env.data((CubemapFace)face) + y * rowSize, &row[0], size);
+
+            for (uint32 x = 0; x < size; ++x) {
+                for (uint32 c = 0; c < 3; ++c)
+                    planes[c * padded + x] = row[x * nChan + c];
+            }
+
+            float  t  = 2.0f * (y + 0.5f) / size - 1.0f;
+            vfloat vt = set1(t);
+
+            vfloat acc[SH_COEFFS][3];
+            vfloat accWeight = set1(0.0f);
+            for (uint32 k = 0; k < SH_COEFFS; ++k)
+                acc[k][0] = acc[k][1] = acc[k][2] = set1(0.0f);
+
+            for (uint32 x = 0; x < padded; x += WIDTH) {
+                vfloat s = load(&sCoord[x]);
+
+                vfloat dir[3];
+                for (uint32 a = 0; a < 3; ++a)
+                    dir[a] = add(add(mul(s, set1(axes[a][0])), mul(vt, set1(axes[a][1]))), set1(axes[a][2]));
+
+                // Solid angle of the texel, up to a constant
+                vfloat len2   = add(add(mul(s, s), mul(vt, vt)), set1(1.0f));
+                vfloat invLen = div(set1(1.0f), simd::sqrt(len2));
+                vfloat weight = mul(div(invLen, len2), load(&valid[x]));
+
+                vfloat basis[SH_COEFFS];
+                shBasis(mul(dir[0], invLen), mul(dir[1], invLen), mul(dir[2], invLen), basis);
+
+                vfloat radiance[3];
+                for (uint32 c = 0; c < 3; ++c)
+                    radiance[c] = mul(load(&planes[c * padded + x]), weight);
+
+                for (uint32 k = 0; k < SH_COEFFS; ++k) {
+                    for (uint32 c = 0; c < 3; ++c)
+                        acc[k][c] = add(acc[k][c], mul(basis[k], radiance[c]));
+                }
+
+                accWeight = add(accWeight, weight);
+            }
+
+            // Rows are summed in double, lanes only hold one row
+            for (uint32 k = 0; k < SH_COEFFS; ++k) {
+                for (uint32 c = 0; c < 3; ++c) {
+                    store(lanes, acc[k][c]);
+                    for (uint32 j = 0; j < WIDTH; ++j)
+                        sums[k][c] += lanes[j];
+                }
+            }
+
+            store(lanes, accWeight);
+            for (uint32 j = 0; j < WIDTH; ++j)
+                weightSum += lanes[j];
+        }
+    }
+}
+
+namespace {
+    // Half vectors of the GGX lobe around N = +Z, padded with zero
+    // weights. Only x and z matter, as V lies in the XZ plane.
+    struct HalfVectors {
+        std::vector<float> x, z;
+        std::vector<float> weight;
+
+        void build(float roughness, uint32 numSamples) {
+            float a  = roughness * roughness;
+            float a2 = a * a;
+
+            uint32 padded = (numSamples + WIDTH - 1) / WIDTH * WIDTH;
+            x.assign(padded, 0.0f);
+            z.assign(padded, 1.0f);
+            weight.assign(padded, 0.0f);
+
+            for (uint32 i = 0; i < numSamples; ++i) {
+                float u = (float)i / numSamples;
+                float v = radicalInverse(i);
+
+                float cosTheta = std::sqrt((1.0f - v) / (1.0f + (a2 - 1.0f) * v));
+                float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+                x[i] = sinTheta * std::cos(2.0f * (float)PI * u);
+                z[i] = cosTheta;
+                weight[i] = 1.0f;
+            }
+        }
+    };
+
+    // Scale and bias of F0 for a view angle [Karis, 2013]. Samples of H
+    // weigh G * VdotH / (NdotH * NdotV), the pdf cancels the rest.
+    void integrateTexel(const HalfVectors& h, float roughness, float NdotV, float numSamples, float* out) {
+        float k = roughness * roughness / 2.0f;
+
+        vfloat vx   = set1(std::sqrt(1.0f - NdotV * NdotV));
+        vfloat vz   = set1(NdotV);
+        vfloat zero = set1(0.0f);
+        vfloat one  = set1(1.0f);
+        vfloat kv   = set1(k);
+        vfloat oneK = set1(1.0f - k);
+
+        // G1 of the view direction over NdotV, the same for every sample
+        vfloat visV = set1(1.0f / (NdotV * (1.0f - k) + k));
+
+        vfloat scale = zero;
+        vfloat bias  = zero;
+
+        for (uint32 i = 0; i < h.x.size(); i += WIDTH) {
+            vfloat hx = load(&h.x[i]);
+            vfloat hz = load(&h.z[i]);
+
+            vfloat VdotH = simd::max(add(mul(vx, hx), mul(vz, hz)), zero);
+            vfloat NdotL = sub(mul(mul(set1(2.0f), VdotH), hz), vz);
+
+            vfloat valid = greater(NdotL, zero);
+            NdotL = simd::max(NdotL, zero);
+
+            vfloat visL = div(NdotL, add(mul(NdotL, oneK), kv));
+            vfloat vis  = div(mul(mul(visL, visV), VdotH), hz);
+            vis = select(valid, mul(vis, load(&h.weight[i])), zero);
+
+            // Schlick's (1 - VdotH)^5
+            vfloat c  = sub(one, VdotH);
+            vfloat c2 = mul(c, c);
+            vfloat fc = mul(mul(c2, c2), c);
+
+            scale = add(scale, mul(sub(one, fc), vis));
+            bias  = add(bias,  mul(fc, vis));
+        }
+
+        float lanes[2][WIDTH];
+        store(lanes[0], scale);
+        store(lanes[1], bias);
+
+        out[0] = out[1] = 0.0f;
+        for (uint32 j = 0; j < WIDTH; ++j) {
+            out[0] += lanes[0][j];
+            out[1] += lanes[1][j];
+        }
+
+        out[0] /= numSamples;
+        out[1] /= numSamples;
+    }
+}
+
+namespace {
+    static const ImageFormat FLOAT_FORMATS[] = { IMGFMT_R32F, IMGFMT_RG32F, IMGFMT_RGB32F, IMGFMT_RGBA32F };
+
+    // Pixels of a plane of floats, decoded from any row convertible format
+    struct FloatPlane {
+        std::vector<float> pixels;
+        int32  width;
+        int32  height;
+        uint32 nChan;
+        bool   wrapX;
+
+        void decode(ImageFormat format, const uint8* src, uint32 w, uint32 h, uint64 rowSize) {
+            width  = (int32)w;
+            height = (int32)h;
+            nChan  = formatToNumChannels(format);
+
+            pixels.resize((size_t)w * h * nChan);
+            Workers.parallelFor(h, [&](uint32 y) {
+                decodeRow(format, src + y * rowSize, &pixels[(size_t)y * w * nChan], w);
+            });
+        }
+
+        const float* texel(int32 x, int32 y) const {
+            if (wrapX)
+                x = ((x % width) + width) % width;
+            else
+                x = std::min(std::max(x, 0), width - 1);
+
+            y = std::min(std::max(y, 0), height - 1);
+
+            return &pixels[((size_t)y * width + x) * nChan];
+        }
+
+        // Accumulates weight times the plane at pixel coordinates x, y
+        void sample(PanoramaFilter filter, float x, float y, float weight, float* out) const {
+            x -= 0.5f;
+            y -= 0.5f;
+
+            int32 x0 = (int32)std::floor(x);
+            int32 y0 = (int32)std::floor(y);
+            float fx = x - x0;
+            float fy = y - y0;
+
+            if (filter == PANO_BILINEAR) {
+                float wx[2] = { 1.0f - fx, fx };
+                float wy[2] = { 1.0f - fy, fy };
+
+                for (int32 j = 0; j < 2; ++j) {
+                    for (int32 i = 0; i < 2; ++i) {
+                        const float* p = texel(x0 + i, y0 + j);
+                        for (uint32 c = 0; c < nChan; ++c)
+                            out[c] += p[c] * wx[i] * wy[j] * weight;
+                    }
+                }
+
+                return;
+            }
+
+            // Catmull-Rom, which rings around bright spots, so the result is
+            // kept positive
+            float wx[4], wy[4];
+            catmullRom(fx, wx);
+            catmullRom(fy, wy);
+
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int32 j = 0; j < 4; ++j) {
+                for (int32 i = 0; i < 4; ++i) {
+                    const float* p = texel(x0 + i - 1, y0 + j - 1);
+                    for (uint32 c = 0; c < nChan; ++c)
+                        sum[c] += p[c] * wx[i] * wy[j];
+                }
+            }
+
+            for (uint32 c = 0; c < nChan; ++c)
+                out[c] += std::max(sum[c], 0.0f) * weight;
+        }
+
+        static void catmullRom(float f, float* w) {
+            float f2 = f * f;
+            float f3 = f2 * f;
+
+            w[0] = 0.5f * (-f3 + 2.0f * f2 - f);
+            w[1] = 0.5f * (3.0f * f3 - 5.0f * f2 + 2.0f);
+            w[2] = 0.5f * (-3.0f * f3 + 4.0f * f2 + f);
+            w[3] = 0.5f * (f3 - f2);
+        }
+    };
+
+    // Centers of samples x samples points in each of count texels of size
+    // texelSize, from start. Padded with the last point.
+    std::vector<float> subsamples(uint32 count, uint32 samples, float start, float texelSize) {
+        uint32 n = count * samples;
+        std::vector<float> coords((n + WIDTH - 1) / WIDTH * WIDTH);
+
+        for (uint32 i = 0; i < coords.size(); ++i) {
+            uint32 k = std::min(i, n - 1);
+            coords[i] = start + (k / samples + (k % samples + 0.5f) / samples) * texelSize;
+        }
+
+        return coords;
+    }
+}
+
+float pbr::ggxLevelRoughness(uint32 level, uint32 numLevels) {
+    if (numLevels <= 1)
+        return 0.0f;
+
+    return (float)level / (float)(numLevels - 1);
+}
+
+bool pbr::prefilterGGX(const Cubemap& env, Cubemap& ggx, uint32 size, uint32 numLevels, uint32 numSamples) {
+    if (size == 0 || numLevels == 0 || numSamples == 0)
+        return false;
+
+    RadianceCube src;
+    if (!src.init(env))
+        return false;
+
+    numLevels = std::min(numLevels, maxMipLevels(size, size));
+
+    // Levels below the source resolution start at the matching mip
+    float minLod = std::max(std::log2((float)src.size / size), 0.0f);
+
+    std::vector<LevelSamples> samples(numLevels);
+    for (uint32 l = 0; l < numLevels; ++l) {
+        float lod = minLod + l;
+        buildSamples(ggxLevelRoughness(l, numLevels), numSamples, src.size, lod, samples[l]);
+    }
+
+    ggx.init(IMGFMT_RGB32F, size, size, numLevels);
+
+    struct Tile {
+        uint32 level, face, x, y;
+    };
+
+    std::vector<Tile> tiles;
+    for (uint32 l = 0; l < numLevels; ++l) {
+        uint32 levelSize = mipDimension(size, l);
+        for (uint32 f = 0; f < 6; ++f) {
+            for (uint32 y = 0; y < levelSize; y += TILE_SIZE) {
+                for (uint32 x = 0; x < levelSize; x += TILE_SIZE)
+                    tiles.push_back({ l, f, x, y });
+            }
+        }
+    }
+
+    Workers.parallelFor((uint32)tiles.size(), [&](uint32 i) {
+        const Tile& tile = tiles[i];
+        float* dst = (float*)ggx.data((CubemapFace)tile.face, tile.level);
+
+        filterTile(src, samples[tile.level], tile.face, tile.x, tile.y, mipDimension(size, tile.level), dst);
+    });
+
+    return true;
+}
+
+bool pbr::projectSH(const Cubemap& env, SHCoeffs& sh) {
+    if (!isRowConvertible(env.format()) || env.width() <= 0 || env.width() != env.height() || env.numChannels() < 3)
+        return false;
+
+    double sums[6][SH_COEFFS][3] = {};
+    double weights[6] = {};
+
+    Workers.parallelFor(6, [&](uint32 f) {
+        integrateFace(env, f, sums[f], weights[f]);
+    });
+
+    // Weights add up to the whole sphere
+    double weightSum = 0.0;
+    for (uint32 f = 0; f < 6; ++f)
+        weightSum += weights[f];
+
+    double norm = 4.0 * PI / weightSum;
+
+    memset(&sh, 0, sizeof(SHCoeffs));
+    for (uint32 k = 0; k < SH_COEFFS; ++k) {
+        for (uint32 c = 0; c < 3; ++c) {
+            double sum = 0.0;
+            for (uint32 f = 0; f < 6; ++f)
+                sum += sums[f][k][c];
+
+            sh.c[k][c] = (float)(sum * norm);
+        }
+    }
+
+    return true;
+}
+
+void pbr::convolveLambert(SHCoeffs& sh) {
+    // Cosine lobe per band [Ramamoorthi and Hanrahan, 2001], over pi
+    static const float bands[SH_COEFFS] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f,
+                                            0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    for (uint32 k = 0; k < SH_COEFFS; ++k) {
+        for (uint32 c = 0; c < 3; ++c)
+            sh.c[k][c] *= bands[k];
+    }
+}
+
+void pbr::evaluateSH(const SHCoeffs& sh, const float dir[3], float rgb[3]) {
+    float basis[SH_COEFFS];
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * dir[1];
+    basis[2] = 0.488603f * dir[2];
+    basis[3] = 0.488603f * dir[0];
+    basis[4] = 1.092548f * dir[0] * dir[1];
+    basis[5] = 1.092548f * dir[1] * dir[2];
+    basis[6] = 0.315392f * (3.0f * dir[2] * dir[2] - 1.0f);
+    basis[7] = 1.092548f * dir[0] * dir[2];
+    basis[8] = 0.546274f * (dir[0] * dir[0] - dir[1] * dir[1]);
+
+    for (uint32 c = 0; c < 3; ++c) {
+        rgb[c] = 0.0f;
+        for (uint32 k = 0; k < SH_COEFFS; ++k)
+            rgb[c] += sh.c[k][c] * basis[k];
+    }
+}
+
+bool pbr::integrateBRDF(Image& lut, uint32 size, ImageFormat format, uint32 numSamples) {
+    if (size == 0 || numSamples == 0 || (format != IMGFMT_RG16F && format != IMGFMT_RG32F))
+        return false;
+
+    lut.init(IMGFMT_RG32F, size, size, 1);
+
+    Workers.parallelFor(size, [&](uint32 y) {
+        float roughness = (y + 0.5f) / size;
+
+        HalfVectors h;
+        h.build(roughness, numSamples);
+
+        float* row = (float*)lut.data() + (uint64)y * size * 2;
+        for (uint32 x = 0; x < size; ++x)
+            integrateTexel(h, roughness, (x + 0.5f) / size, (float)numSamples, row + x * 2);
+    });
+
+    return format == IMGFMT_RG32F || lut.convert(format);
+}
+
+std::string pbr::brdfCachePath(const std::string& folder, uint32 size, ImageFormat format, uint32 numSamples) {
+    std::string type = (format == IMGFMT_RG32F) ? "rg32f" : "rg16f";
+
+    return folder + "/brdf-v" + std::to_string(BRDF_LUT_VERSION) + "-" + std::to_string(size) + "-" +
+           std::to_string(numSamples) + "-" + type + ".img";
+}
+
+bool pbr::equirectToCubemap(const Image& pano, Cubemap& cube, uint32 size, PanoramaFilter filter, uint32 samples) {
+    ImageFormat format = pano.format();
+    if (!isRowConvertible(format) || pano.width() <= 0 || pano.height() <= 0 || size == 0 || samples == 0)
+        return false;
+
+    FloatPlane src;
+    src.wrapX = true;
+    src.decode(format, pano.data(), pano.width(), pano.height(), pano.size() / pano.height());
+
+    uint32 nChan = src.nChan;
+    cube.init(FLOAT_FORMATS[nChan - 1], size, size, 1);
+
+    // Face coordinates in [-1, 1] of every sample along a row
+    std::vector<float> sCoord = subsamples(size, samples, -1.0f, 2.0f / size);
+    uint32 rowSamples = size * samples;
+
+    float toX = src.width  / (2.0f * (float)PI);
+    float toY = src.height / (float)PI;
+    float weight = 1.0f / (samples * samples);
+
+    Workers.parallelFor(6 * size, [&](uint32 i) {
+        uint32 face = i / size;
+        uint32 y    = i % size;
+
+        const float (*axes)[3] = FACE_AXES[face];
+
+        float* dst = (float*)cube.data((CubemapFace)face) + (size_t)y * size * nChan;
+        memset(dst, 0, sizeof(float) * size * nChan);
+
+        std::vector<float> px(sCoord.size()), py(sCoord.size());
+
+        for (uint32 sy = 0; sy < samples; ++sy) {
+            vfloat t = set1(-1.0f + (y + (sy + 0.5f) / samples) * 2.0f / size);
+
+            // Longitude and latitude of each sample, in pixels of the panorama
+            for (uint32 x = 0; x < sCoord.size(); x += WIDTH) {
+                vfloat s = load(&sCoord[x]);
+
+                vfloat dir[3];
+                for (uint32 a = 0; a < 3; ++a)
+                    dir[a] = add(add(mul(s, set1(axes[a][0])), mul(t, set1(axes[a][1]))), set1(axes[a][2]));
+
+                vfloat horiz = simd::sqrt(add(mul(dir[0], dir[0]), mul(dir[2], dir[2])));
+
+                vfloat phi   = simd::atan2(dir[0], sub(set1(0.0f), dir[2]));
+                vfloat theta = simd::atan2(horiz, dir[1]);
+
+                store(&px[x], add(mul(phi, set1(toX)), set1(0.5f * src.width)));
+                store(&py[x], mul(theta, set1(toY)));
+            }
+
+            for (uint32 k = 0; k < rowSamples; ++k)
+                src.sample(filter, px[k], py[k], weight, dst + (k / samples) * nChan);
+        }
+    });
+
+    return true;
+}
+
+bool pbr::cubemapToEquirect(const Cubemap& cube, Image& pano, uint32 width, PanoramaFilter filter, uint32 samples) {
+    ImageFormat format = cube.format();
+    if (!isRowConvertible(format) || cube.width() <= 0 || cube.width() != cube.height() || width == 0 || samples == 0)
+        return false;
+
+    uint32 size = cube.width();
+
+    FloatPlane src[6];
+    for (uint32 f = 0; f < 6; ++f) {
+        src[f].wrapX = false;
+        src[f].decode(format, cube.data((CubemapFace)f), size, size, cube.size((CubemapFace)f) / size);
+    }
+
+    uint32 nChan  = src[0].nChan;
+    uint32 height = std::max(width / 2, 1u);
+
+    pano.init(FLOAT_FORMATS[nChan - 1], width, height, 1);
+
+    // Longitude of every sample along a row, the same for all of them
+    std::vector<float> phi = subsamples(width, samples, -(float)PI, 2.0f * (float)PI / width);
+    std::vector<float> sinPhi(phi.size()), cosPhi(phi.size());
+    for (uint32 i = 0; i < phi.size(); ++i) {
+        sinPhi[i] = std::sin(phi[i]);
+        cosPhi[i] = std::cos(phi[i]);
+    }
+
+    uint32 rowSamples = width * samples;
+    float weight = 1.0f / (samples * samples);
+
+    Workers.parallelFor(height, [&](uint32 y) {
+        float* dst = (float*)pano.data() + (size_t)y * width * nChan;
+        memset(dst, 0, sizeof(float) * width * nChan);
+
+        std::vector<float> face(phi.size()), s(phi.size()), t(phi.size());
+
+        for (uint32 sy = 0; sy < samples; ++sy) {
+            float theta = (y + (sy + 0.5f) / samples) * (float)PI / height;
+
+            vfloat sinTheta = set1(std::sin(theta));
+            vfloat cosTheta = set1(std::cos(theta));
+
+            for (uint32 x = 0; x < phi.size(); x += WIDTH) {
+                vfloat dx = mul(sinTheta, load(&sinPhi[x]));
+                vfloat dz = sub(set1(0.0f), mul(sinTheta, load(&cosPhi[x])));
+
+                directionToFace(dx, cosTheta, dz, &face[x], &s[x], &t[x]);
+            }
+
+            for (uint32 k = 0; k < rowSamples; ++k) {
+                src[(uint32)face[k]].sample(filter, s[k] * size, t[k] * size, weight,
+                                            dst + (k / samples) * nChan);
+            }
+        }
+    });
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef __PBR_IBL_H__
+#define __PBR_IBL_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // Levels of the prefiltered GGX cubemaps. unreal.fs samples level
+    // roughness * (levels - 1), so roughness grows linearly with the level.
+    static PBR_CONSTEXPR uint32 GGX_LEVELS  = 5;
+    static PBR_CONSTEXPR uint32 GGX_SAMPLES = 1024;
+
+    float ggxLevelRoughness(uint32 level, uint32 numLevels);
+
+    // Prefilters env with the GGX distribution into a size x size RGB32F
+    // cubemap of numLevels levels. Samples are importance sampled and read
+    // from the mip of env that matches their solid angle, so few of them
+    // are needed without aliasing. Faces, levels and tiles are filtered in
+    // parallel.
+    bool prefilterGGX(const Cubemap& env, Cubemap& ggx, uint32 size, uint32 numLevels = GGX_LEVELS,
+                      uint32 numSamples = GGX_SAMPLES);
+
+    static PBR_CONSTEXPR uint32 SH_COEFFS = 9;
+
+    // RGB coefficients of the first three SH bands, padded to vec4 to be
+    // uploaded as is to std140 uniform blocks
+    struct SHCoeffs {
+        float c[SH_COEFFS][4];
+    };
+
+    // Projects the radiance of env onto SH, weighting texels by their
+    // solid angle. Faces are integrated in parallel.
+    bool projectSH(const Cubemap& env, SHCoeffs& sh);
+
+    // Convolves radiance with the clamped cosine, divided by pi, so sh
+    // evaluates to the light a white Lambertian surface reflects
+    void convolveLambert(SHCoeffs& sh);
+
+    void evaluateSH(const SHCoeffs& sh, const float dir[3], float rgb[3]);
+
+    // Split-sum BRDF table sampled by unreal.fs, NdotV along x and
+    // roughness along y. Bump the version whenever the integrand changes,
+    // so tables cached on disk are integrated again.
+    static PBR_CONSTEXPR uint32 BRDF_LUT_VERSION = 1;
+    static PBR_CONSTEXPR uint32 BRDF_LUT_SIZE    = 128;
+    static PBR_CONSTEXPR uint32 BRDF_SAMPLES     = 1024;
+
+    // Integrates the scale and bias applied to F0 by the GGX specular,
+    // with Smith-Schlick visibility, into a size x size RG16F or RG32F
+    // image. Rows are integrated in parallel.
+    bool integrateBRDF(Image& lut, uint32 size = BRDF_LUT_SIZE, ImageFormat format = IMGFMT_RG16F,
+                       uint32 numSamples = BRDF_SAMPLES);
+
+    // File in folder where the table of these parameters is cached
+    std::string brdfCachePath(const std::string& folder, uint32 size, ImageFormat format,
+                              uint32 numSamples = BRDF_SAMPLES);
+
+    enum PanoramaFilter : uint32 {
+        PANO_BILINEAR = 0,
+        PANO_BICUBIC  = 1
+    };
+
+    // Equirectangular panoramas span longitude along x, with -Z in the
+    // middle, and latitude along y, with +Y on the first row. Pixels are
+    // converted as stored, to the 32 bit float format of as many channels.
+
+    // Projects a panorama onto a cubemap of size x size faces. Texels
+    // average samples x samples points over their area. Rows of every face
+    // are filtered in parallel.
+    bool equirectToCubemap(const Image& pano, Cubemap& cube, uint32 size,
+                           PanoramaFilter filter = PANO_BILINEAR, uint32 samples = 1);
+
+    // Unwraps a cubemap onto a width x width / 2 panorama, for previews and
+    // exports. Faces are filtered on their own, clamped at the edges.
+    bool cubemapToEquirect(const Cubemap& cube, Image& pano, uint32 width,
+                           PanoramaFilter filter = PANO_BILINEAR, uint32 samples = 1);
+
+}
+
+#endif
@@ -1,25 +1,49 @@
 #include <Image.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <PixelOps.h>
+#include <Resample.h>
+#include <ToneMap.h>
+#include <RGBE.h>
+#include <EXR.h>
+#include <BlockCompress.h>
 
 #include <sstream>
 #include <fstream>
+#include <atomic>
 #include <path.h>
 
 #include <lodepng.h>
 
 #include <zlib.h>
 
-/*
-#include <ImfRgba.h>
-#include <ImfRgbaFile.h>
-#include <hdrloader.h>
-
-using namespace Imf;
-using namespace Imath;
-*/
-
 using namespace filesystem;
 using namespace pbr;
 
+namespace {
+    ImageType dimensionsToType(int32 width, int32 height, int32 depth) {
+        if (depth  > 1) return IMGTYPE_3D;
+        if (height > 1) return IMGTYPE_2D;
+        if (width  > 1) return IMGTYPE_1D;
+
+        return IMGTYPE_UNKNOWN;
+    }
+
+    // Byte offset of every level, followed by the total size
+    void levelOffsets(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                      uint32 numLevels, uint64* offsets) {
+        offsets[0] = 0;
+        for (uint32 lvl = 0; lvl < numLevels; ++lvl) {
+            uint64 size = 0;
+            if (format != IMGFMT_UNKNOWN)
+                size = levelSize(format, mipDimension(width, lvl), mipDimension(height, lvl),
+                                 mipDimension(depth, lvl));
+
+            offsets[lvl + 1] = offsets[lvl] + size;
+        }
+    }
+}
+
 uint32 pbr::formatToNumChannels(ImageFormat format) {
     static const uint32 channels[] = {
         0,
@@ -33,11 +57,14 @@ uint32 pbr::formatToNumChannels(ImageFormat format) {
         1, 2, 3, 4,       // 32-bit unsigned integer
         1, 2, 3, 4,       // 16-bit signed integer
         1, 2, 3, 4,       // 32-bit signed integer
-        0, 0, 0, 0, 0, 0, // Packed
+        3, 3, 3, 3, 4, 4, // Packed
         1, 1, 2, 1,       // Depth
-        0, 0, 0, 0, 0     // Compressed
+        0, 0, 0, 0, 0, 0  // Compressed
     };
 
+    if (format >= sizeof(channels) / sizeof(channels[0]))
+        return 0;
+
     return channels[format];
 }
 
@@ -49,15 +76,31 @@ uint32 pbr::formatToBytesPerChannel(ImageFormat format) {
         2, // 16-bit signed
         2, // 16-bit float
         4, // 32-bit float
-        2, // 16-bit unsigned integer
-        4, // 32-bit unsigned integer
         2, // 16-bit signed integer
-        4  // 32-bit signed integer
+        4, // 32-bit signed integer
+        2, // 16-bit unsigned integer
+        4  // 32-bit unsigned integer
     };
 
+    // Packed, depth and compressed formats have no plain channels
+    if (format == IMGFMT_UNKNOWN || format >= IMGFMT_RGBE8)
+        return 0;
+
     return bpc[(format - 1) >> 2];
 }
 
+uint32 pbr::formatToBytesPerPixel(ImageFormat format) {
+    static const uint32 packed[] = {
+        4, 4, 4, 2, 2, 4, // Packed
+        2, 4, 4, 4        // Depth
+    };
+
+    if (format >= IMGFMT_RGBE8 && format <= IMGFMT_D32F)
+        return packed[format - IMGFMT_RGBE8];
+
+    return formatToNumChannels(format) * formatToBytesPerChannel(format);
+}
+
 ImageComponent pbr::formatToImgComp(ImageFormat format) {
     static const ImageComponent cmp[] = {
         UNKNOWN,
@@ -67,33 +110,140 @@ ImageComponent pbr::formatToImgComp(ImageFormat format) {
         SHORT, SHORT, SHORT, SHORT,       // 16-bit signed
         HALF, HALF, HALF, HALF,           // 16-bit float
         FLOAT, FLOAT, FLOAT, FLOAT,       // 32-bit float
-        USHORT, USHORT, USHORT, USHORT,   // 16-bit unsigned integer
-        UINT, UINT, UINT, UINT,           // 32-bit unsigned integer
         SHORT, SHORT, SHORT, SHORT,       // 16-bit signed integer
         INT, INT, INT, INT,               // 32-bit signed integer
+        USHORT, USHORT, USHORT, USHORT,   // 16-bit unsigned integer
+        UINT, UINT, UINT, UINT,           // 32-bit unsigned integer
         UNKNOWN, UNKNOWN, UNKNOWN,        // Packed
         UNKNOWN, UNKNOWN, UNKNOWN,
         FLOAT, FLOAT, FLOAT, FLOAT,       // Depth
         UNKNOWN, UNKNOWN, UNKNOWN,        // Compressed
-        UNKNOWN, UNKNOWN
+        UNKNOWN, UNKNOWN, UNKNOWN
     };
 
+    if (format >= sizeof(cmp) / sizeof(cmp[0]))
+        return UNKNOWN;
+
     return cmp[format];
 }
 
+bool pbr::isCompressed(ImageFormat format) {
+    return format >= IMGFMT_DXT1 && format <= IMGFMT_BC7;
+}
+
+uint32 pbr::formatToBlockSize(ImageFormat format) {
+    // DXT1 and BC4 blocks are 64 bits, the others 128
+    if (format == IMGFMT_DXT1 || format == IMGFMT_ATI1N)
+        return 8;
+
+    return isCompressed(format) ? 16 : 0;
+}
+
+ImageFormat pbr::toFormat(ImageComponent comp, uint32 numChannels) {
+    static const ImageFormat firstFormat[] = {
+        IMGFMT_R8,    // UBYTE
+        IMGFMT_R8S,   // BYTE
+        IMGFMT_R16,   // USHORT
+        IMGFMT_R16S,  // SHORT
+        IMGFMT_R32UI, // UINT
+        IMGFMT_R32I,  // INT
+        IMGFMT_R32F,  // FLOAT
+        IMGFMT_R16F   // HALF
+    };
+
+    if (comp >= UNKNOWN || numChannels == 0 || numChannels > 4)
+        return IMGFMT_UNKNOWN;
+
+    return (ImageFormat)(firstFormat[comp] + numChannels - 1);
+}
+
 uint32 pbr::mipDimension(uint32 baseDim, uint32 level) {
     uint32 dim = baseDim >> level;
     return (dim == 0) ? 1 : dim;
 }
 
+uint32 pbr::maxMipLevels(uint32 width, uint32 height, uint32 depth) {
+    uint32 dim = std::max(std::max(width, height), depth);
+
+    uint32 levels = 1;
+    while (dim >>= 1)
+        levels++;
+
+    return levels;
+}
+
+uint64 pbr::levelSize(ImageFormat format, uint32 width, uint32 height, uint32 depth) {
+    // Compressed levels are made of whole 4x4 blocks
+    if (isCompressed(format))
+        return formatToBlockSize(format) * (((uint64)width + 3) / 4) * (((uint64)height + 3) / 4) * depth;
+
+    return formatToBytesPerPixel(format) * (uint64)width * height * depth;
+}
+
+ImageView::ImageView() : _format(IMGFMT_UNKNOWN), _width(0), _height(0), _depth(0),
+    _numLevels(0), _data(nullptr) {
+    _offsets[0] = 0;
+}
+
+ImageView::ImageView(const Image& img) 
+    : ImageView(img.format(), img.width(), img.height(), img.depth(), img.data(0), img.numLevels()) {
+
+}
+
+ImageView::ImageView(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                     const uint8* data, uint32 numLevels)
+    : _format(format), _width(width), _height(height), _depth(depth), 
+      _numLevels(std::min(numLevels, MAX_IMAGE_LEVELS)), _data(data) {
+    levelOffsets(_format, _width, _height, _depth, _numLevels, _offsets);
+}
+
+ImageType ImageView::type() const {
+    return dimensionsToType(_width, _height, _depth);
+}
+
+ImageFormat ImageView::format() const {
+    return _format;
+}
+
+uint32 ImageView::numLevels() const {
+    return _numLevels;
+}
+
+int32 ImageView::width() const {
+    return _width;
+}
+
+int32 ImageView::height() const {
+    return _height;
+}
+
+int32 ImageView::depth() const {
+    return _depth;
+}
+
+const uint8* ImageView::data(uint32 lvl) const {
+    if (_data == nullptr || lvl >= _numLevels)
+        return nullptr;
+
+    return _data + _offsets[lvl];
+}
+
+uint64 ImageView::size(uint32 lvl) const {
+    if (lvl >= _numLevels)
+        return 0;
+
+    return _offsets[lvl + 1] - _offsets[lvl];
+}
+
+uint64 ImageView::totalSize() const {
+    return _offsets[_numLevels];
+}
+
 Image::Image() {
-    _format = IMGFMT_UNKNOWN;
-    _width  = 0;
-    _height = 0;
-    _depth  = 0;
-    _numLevels = 0;
+    setLayout(IMGFMT_UNKNOWN, 0, 0, 0, 0);
 
-    _data = nullptr;
+    _data   = nullptr;
+    _mapped = nullptr;
 }
 
 Image::~Image() {
@@ -104,20 +254,43 @@ Image::~Image() {
     _numLevels = 0;
 
     _data.reset();
+    _owner.reset();
+    _mapped = nullptr;
 }
 
-ImageFormat toFormat(uint32 numChannels, uint32 bytesPerChannel) {
-    return IMGFMT_UNKNOWN;
+void Image::init(ImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 levels) {
+    setLayout(format, width, height, depth, levels);
+
+    PixelBuffer data = Pixels.allocate(totalSize());
+    setStorage(data);
 }
 
-void Image::init(ImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 levels) {
+void Image::setLayout(ImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 levels) {
     _format    = format;
     _width     = width;
     _height    = height;
     _depth     = depth;
-    _numLevels = levels;
+    _numLevels = std::min(levels, MAX_IMAGE_LEVELS);
+
+    // Precompute level offsets, so levels are reached in constant time
+    levelOffsets(_format, _width, _height, _depth, _numLevels, _offsets);
+}
+
+uint8* Image::pixels() const {
+    if (_mapped)
+        return _mapped;
+
+    return _data.get();
+}
+
+void Image::setStorage(PixelBuffer& data) {
+    _data.swap(data);
+    _owner.reset();
+    _mapped = nullptr;
+}
 
-    _data = std::make_unique<uint8[]>(totalSize());
+bool Image::isMapped() const {
+    return _mapped != nullptr;
 }
 
 uint32 Image::numLevels() const {
@@ -136,81 +309,112 @@ uint32 Image::numChannels() const {
     return formatToNumChannels(_format);
 }
 
-uint32 Image::size(uint32 level) const {
-    uint32 w = mipDimension(_width,  level);
-    uint32 h = mipDimension(_height, level);
-    uint32 d = mipDimension(_depth,  level);
+bool Image::isOpaque() const {
+    if (isCompressed(_format) || pixels() == nullptr)
+        return false;
+
+    if (numChannels() < 4)
+        return true;
+
+    if (!isRowConvertible(_format))
+        return false;
+
+    uint32 bpp = formatToBytesPerPixel(_format);
+    std::atomic<bool> opaque(true);
+
+    Workers.parallelRange(_height * _depth, 64, [&](uint32 begin, uint32 end) {
+        std::vector<uint8> row((size_t)_width * 4);
 
-    uint32 nChannels    = numChannels();
-    uint32 bytesChannel = formatToBytesPerChannel(_format);
+        for (uint32 y = begin; y < end && opaque; ++y) {
+            convertRow(_format, data(0) + (uint64)y * _width * bpp, IMGFMT_RGBA8, &row[0], _width);
+
+            for (uint32 x = 0; x < (uint32)_width; ++x) {
+                if (row[x * 4 + 3] != 255) {
+                    opaque = false;
+                    break;
+                }
+            }
+        }
+    });
 
-    return nChannels * bytesChannel * w * h * d;
+    return opaque;
 }
 
-uint32 Image::totalSize() const {
-    uint32 sizeBytes = 0;
-    for (uint32 i = 0; i < _numLevels; ++i)
-        sizeBytes += size(i);
+uint64 Image::size(uint32 level) const {
+    if (_format == IMGFMT_UNKNOWN)
+        return 0;
 
-    return sizeBytes;
+    return levelSize(_format, mipDimension(_width, level), mipDimension(_height, level),
+                     mipDimension(_depth, level));
 }
 
-bool Image::loadPNG(const std::string& filePath) {
-    static const uint32 toChannels[] = { 1, 0, 3, 0, 2, 0, 4 };
+uint64 Image::totalSize() const {
+    return _offsets[_numLevels];
+}
 
-    std::vector<unsigned char> png;
-    std::vector<unsigned char> image;
+bool Image::loadPNG(const std::string& filePath) {
+    MappedFile file;
+    if (!file.open(filePath))
+        return false;
 
+    // Read the header first, so the file is decoded once, straight into
+    // the format it is kept in
     lodepng::State state;
     unsigned width, height;
-    unsigned error = lodepng::load_file(png, filePath);
-    if (!error)
-        error = lodepng::decode(image, width, height, state, png);
-
-    if (error) {
-        // std::cout << "decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
+    if (lodepng_inspect(&width, &height, &state, file.data(), (size_t)file.size()))
         return false;
-    }
 
-    _width  = width;
-    _height = height;
-    _depth  = 1;
+    const LodePNGColorMode& color = state.info_png.color;
 
-    _numLevels = 1;
+    // Palettes may carry alpha, and depths under 8 bits are expanded
+    ImageFormat format = IMGFMT_UNKNOWN;
+    switch (color.colortype) {
+        case LCT_GREY:
+            format = IMGFMT_R8;
+            break;
+        case LCT_GREY_ALPHA:
+            format = IMGFMT_RG8;
+            break;
+        case LCT_RGB:
+            format = IMGFMT_RGB8;
+            break;
+        case LCT_RGBA:
+        case LCT_PALETTE:
+            format = IMGFMT_RGBA8;
+            break;
+        default:
+            return false;
+    }
 
-    uint32 bitDepth  = state.info_png.color.bitdepth;
-    uint32 nChannels = toChannels[state.info_png.color.colortype];
+    bool is16Bit = color.bitdepth == 16;
+    if (is16Bit)
+        format = (ImageFormat)(format + IMGFMT_R16 - IMGFMT_R8);
 
-    image.clear();
-    state.info_raw.bitdepth = state.info_png.color.bitdepth;
-    state.info_raw.colortype = state.info_png.color.colortype;
-    error = lodepng::decode(image, width, height, state, png);
+    state.info_raw.colortype = (color.colortype == LCT_PALETTE) ? LCT_RGBA : color.colortype;
+    state.info_raw.bitdepth  = is16Bit ? 16 : 8;
 
+    std::vector<unsigned char> image;
+    unsigned error = lodepng::decode(image, width, height, state, file.data(), (size_t)file.size());
     if (error) {
         // std::cout << "decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
         return false;
     }
 
-    _format = IMGFMT_UNKNOWN;
-    switch (nChannels) {
-        case 1:
-            _format = (bitDepth > 8) ? IMGFMT_R16 : IMGFMT_R8;
-            break;
-        case 2:
-            _format = (bitDepth > 8) ? IMGFMT_RG16 : IMGFMT_RG8;
-            break;
-        case 3:
-            _format = (bitDepth > 8) ? IMGFMT_RGB16 : IMGFMT_RGB8;
-            break;
-        case 4:
-            _format = (bitDepth > 8) ? IMGFMT_RGBA16 : IMGFMT_RGBA8;
-            break;
-    }
+    setLayout(format, width, height, 1, 1);
 
-    uint32 size = totalSize();
-    _data = std::make_unique<uint8[]>(size);
+    size_t size = (size_t)totalSize();
+    PixelBuffer data = Pixels.allocate(size);
+
+    // 16-bit samples are stored big endian
+    if (is16Bit) {
+        uint16* dst = (uint16*)data.get();
+        for (size_t i = 0; i < size / 2; ++i)
+            dst[i] = (uint16)((image[i * 2] << 8) | image[i * 2 + 1]);
+    } else {
+        memcpy(data.get(), &image[0], size);
+    }
 
-    memcpy(_data.get(), &image[0], size);
+    setStorage(data);
 
     return true;
 }
@@ -237,7 +441,23 @@ bool Image::savePNG(const std::string& filePath, uint32 lvl) const {
 
     int32 w = mipDimension(_width,  lvl);
     int32 h = mipDimension(_height, lvl);
-    unsigned error = lodepng::encode(image, data(lvl), w, h, state);
+
+    // 16-bit samples are written big endian
+    const uint8* pixels = data(lvl);
+    std::vector<uint8> swapped;
+    if (bitsChannel == 16) {
+        const uint16* src = (const uint16*)pixels;
+
+        swapped.resize((size_t)size(lvl));
+        for (size_t i = 0; i < swapped.size() / 2; ++i) {
+            swapped[i * 2]     = (uint8)(src[i] >> 8);
+            swapped[i * 2 + 1] = (uint8)(src[i] & 0xFF);
+        }
+
+        pixels = &swapped[0];
+    }
+
+    unsigned error = lodepng::encode(image, pixels, w, h, state);
     if (!error)
         error = lodepng::save_file(image, filePath);
 
@@ -250,125 +470,107 @@ bool Image::savePNG(const std::string& filePath, uint32 lvl) const {
 }
 
 bool Image::loadHDR(const std::string& filePath) {
-    /*HDRLoaderResult result;
-
-    if (!HDRLoader::load(filePath.c_str(), result)) {
-        std::cerr << "Could not load HDR image '" << filePath << "'.";
-        return nullptr;
-    }
-
-    init(IMGFMT_RGB32F, result.width, result.height, 1, 1);
-
-    return loadImage((const uint8*)result.cols, 0);*/
+    return loadRGBE(filePath, *this);
+}
 
-    return false;
+bool Image::saveHDR(const std::string& filePath, uint32 lvl) const {
+    return saveRGBE(filePath, *this, lvl);
 }
 
 bool Image::loadEXR(const std::string& filePath) {
-    return false;
+    return pbr::loadEXR(filePath, *this);
 }
 
 bool Image::saveEXR(const std::string& filePath, uint32 lvl) const {
-    // Must be a float format
-    /*if (_format < IMGFMT_R16F && _format > IMGFMT_RGBA32F)
-        return false;
-
-    const float* pixels = (const float*)data(lvl);
-
-    uint32 nPixels = _width * _height;
-    uint32 nChannels = numChannels();
-
-    Rgba *hrgba = new Rgba[nPixels];
-    for (int i = 0; i < nPixels; ++i) {
-        float rgb[3] = { 0, 0, 0 };
-        for (uint32 c = 0; c < nChannels; ++c)
-            rgb[c] = pixels[nChannels * i + c];
-
-        hrgba[i] = Rgba(rgb[0], rgb[1], rgb[2]);
-    }
-
-    // OpenEXR uses inclusive pixel bounds.
-    Box2i displayWindow(V2i(0, 0), V2i(_width - 1, _height - 1));
-    Box2i dataWindow(V2i(0, 0), V2i(0 + _width - 1, 0 + _height - 1));
-
-    try {
-        RgbaOutputFile file(filePath.c_str(), displayWindow, dataWindow,
-                            WRITE_RGB);
-        file.setFrameBuffer(hrgba - 0 - 0 * _width, 1, _width);
-        file.writePixels(_height);
-    } catch (const std::exception &exc) {
-        return false;
-    }
-
-    delete[] hrgba;
-
-    return true;*/
-
-    return false;
+    return pbr::saveEXR(filePath, *this, lvl);
 }
 
 bool Image::loadIMG(const std::string& filePath) {
-    IMGHeader header;
-
-    std::ifstream file(filePath, std::ios::in | std::ios::binary);
-
-    // Read header
-    file.read((char*)&header, sizeof(IMGHeader));
+    sref<MappedFile> file = make_sref<MappedFile>();
+    if (!file->open(filePath) || file->size() < sizeof(IMGHeader))
+        return false;
 
-    if (!(header.id[0] == 'I' && header.id[1] == 'M' &&
-          header.id[2] == 'G' && header.id[3] == ' ')) {
-        file.close();
+    const char* id = (const char*)file->data();
+    if (!(id[0] == 'I' && id[1] == 'M' && id[2] == 'G'))
         return false;
-    }
 
-    init((ImageFormat)header.fmt, header.width, header.height, header.depth, header.levels);
+    ImageFormat format;
+    uint32 width, height, depth, levels;
+    uint64 compSize, totalSize, offset;
+
+    if (id[3] == ' ') {
+        IMGHeader header;
+        memcpy(&header, file->data(), sizeof(IMGHeader));
+
+        format = (ImageFormat)header.fmt;
+        width  = header.width;
+        height = header.height;
+        depth  = header.depth;
+        levels = header.levels;
+        compSize  = header.compSize;
+        totalSize = header.totalSize;
+        offset    = sizeof(IMGHeader);
+    } else if (id[3] == '2') {
+        if (file->size() < sizeof(IMGHeader2))
+            return false;
 
-    uint8* imgData = new uint8[header.totalSize];
+        IMGHeader2 header;
+        memcpy(&header, file->data(), sizeof(IMGHeader2));
 
-    uint8* ptr = imgData;
+        if (header.version > IMG_VERSION)
+            return false;
 
-    for (uint32 lvl = 0; lvl < header.levels; ++lvl) {
-        uint32 sz = size(lvl);
-        file.read((char*)ptr, sz);
-        loadImage(ptr, lvl);
-        ptr += sz;
+        format = (ImageFormat)header.fmt;
+        width  = header.width;
+        height = header.height;
+        depth  = header.depth;
+        levels = header.levels;
+        compSize  = header.compSize;
+        totalSize = header.totalSize;
+        offset    = sizeof(IMGHeader2);
+    } else {
+        return false;
     }
 
-    file.close();
+    // IMG payloads are stored uncompressed
+    if (compSize != totalSize || levels > MAX_IMAGE_LEVELS ||
+        file->size() < offset + totalSize)
+        return false;
 
-    delete[] imgData;
+    // Pixels are used directly from the mapping, without any copy
+    if (!mapImage(format, width, height, depth, file, offset, levels))
+        return false;
 
-    if (totalSize() != header.totalSize)
+    if (this->totalSize() != totalSize)
         return false; // Warn
 
     return true;
 }
 
 bool Image::saveIMG(const std::string& filePath) const {
-    IMGHeader header;
+    IMGHeader2 header;
     header.id[0] = 'I';
     header.id[1] = 'M';
     header.id[2] = 'G';
-    header.id[3] = ' ';
-    header.fmt    = format();
-    header.width  = width();
-    header.height = height();
-    header.depth  = depth();
-    header.levels = numLevels();
+    header.id[3] = '2';
+    header.version = IMG_VERSION;
+    header.fmt     = format();
+    header.width   = width();
+    header.height  = height();
+    header.depth   = depth();
+    header.levels  = numLevels();
+    header.reserved  = 0;
     header.totalSize = totalSize();
     header.compSize  = totalSize();
 
     std::ofstream file(filePath, std::ios::out | std::ios::binary);
 
-    file.write((const char*)&header, sizeof(IMGHeader));
-
-    uint32 numlvls = numLevels();
-    for (uint32 lvl = 0; lvl < numlvls; ++lvl)
-        file.write((const char*)data(lvl), size(lvl));
+    file.write((const char*)&header, sizeof(IMGHeader2));
+    file.write((const char*)data(0), (std::streamsize)header.totalSize);
 
     file.close();
 
-    return true;
+    return !file.fail();
 }
 
 bool Image::loadImage(const std::string& filePath) {
@@ -392,41 +594,57 @@ bool Image::loadImage(const std::string& filePath) {
 }
 
 bool Image::loadImage(ImageFormat format, uint32 width, uint32 height, uint32 depth, const uint8* data, uint32 numLevels) {
-    _format = format;
-    _width  = width;
-    _height = height;
-    _depth  = depth;
+    setLayout(format, width, height, depth, numLevels);
 
-    _numLevels = numLevels;
+    size_t size = (size_t)totalSize();
 
-    uint32 size = totalSize();
+    PixelBuffer pixels = Pixels.allocate(size);
+    memcpy(pixels.get(), data, size);
+    setStorage(pixels);
 
-    _data.reset();
-    _data = std::make_unique<uint8[]>(size);
+    return true;
+}
+
+bool Image::mapImage(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                     const sref<MappedFile>& file, uint64 offset, uint32 numLevels) {
+    if (file == nullptr || !file->isOpen())
+        return false;
+
+    setLayout(format, width, height, depth, numLevels);
 
-    memcpy(_data.get(), data, size);
+    // Check if the mapping holds the whole image
+    if (offset + totalSize() > file->size())
+        return false;
+
+    return viewImage(format, width, height, depth, file->data() + offset, numLevels, file);
+}
+
+bool Image::viewImage(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                      uint8* data, uint32 numLevels, const sref<void>& owner) {
+    if (data == nullptr)
+        return false;
+
+    setLayout(format, width, height, depth, numLevels);
+
+    _data.reset();
+    _owner  = owner;
+    _mapped = data;
 
     return true;
 }
 
 bool Image::loadImage(const uint8* data, uint32 lvl) {
-    if (_format == IMGFMT_UNKNOWN || _data == nullptr || 
+    if (_format == IMGFMT_UNKNOWN || pixels() == nullptr || 
         _width == 0 || lvl >= _numLevels)
         return false;
 
-    uint32 offset = 0;
-    for (uint32 l = 0; l < lvl; ++l)
-        offset += size(l);
-
-    uint32 sizeLvl = size(lvl);
-    uint8* start = (uint8*)_data.get() + offset;
-    memcpy((void*)start, data, sizeLvl);
+    memcpy(pixels() + _offsets[lvl], data, (size_t)size(lvl));
 
     return true;
 }
 
 bool Image::saveImage(const std::string& filePath, uint32 lvl) const {
-    if (_data == nullptr || _width == 0 || lvl >= _numLevels)
+    if (pixels() == nullptr || _width == 0 || lvl >= _numLevels)
         return false;
 
     filesystem::path path(filePath);
@@ -441,6 +659,8 @@ bool Image::saveImage(const std::string& filePath, uint32 lvl) const {
             return savePNG(filePath, lvl);
         else if (ext == "exr")
             return saveEXR(filePath, lvl);
+        else if (ext == "hdr")
+            return saveHDR(filePath, lvl);
     }
 
     return false;
@@ -476,69 +696,87 @@ bool Image::saveMipMap(const std::string& filePath) const {
 }
 
 bool Image::flipX() {
-    int32 w, h;
-    uint32 nChan     = numChannels();
-    uint32 bytesChan = formatToBytesPerChannel(_format);
+    // Blocks can't be flipped by moving pixels
+    if (isCompressed(_format))
+        return false;
 
-    std::unique_ptr<uint8[]> newImg = std::make_unique<uint8[]>(totalSize());
+    int32 w, h;
+    uint32 bytesPixel = formatToBytesPerPixel(_format);
+
+    // Mapped pixels are flipped into storage of their own
+    PixelBuffer newImg;
+    uint8* dstPixels = pixels();
+    if (_mapped) {
+        newImg    = Pixels.allocate(totalSize());
+        dstPixels = newImg.get();
+    }
 
     // Flip each mip map level
-    uint32 prevSize = 0;
-    uint32 offset = bytesChan * nChan;
     for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
         w = mipDimension(_width, lvl);
         h = mipDimension(_height, lvl);
 
-        uint8* dst = (uint8*)newImg.get() + prevSize;
-        uint8* src = nullptr;
+        uint64 lineWidth = (uint64)w * bytesPixel;
 
         for (int32 y = 0; y < h; y++) {
-            src = ((uint8*)_data.get() + prevSize) + (y + 1) * w * offset;
-            for (int32 x = 0; x < w; x++) {
-                memcpy(dst, src, offset);
-
-                dst += offset;
-                src -= offset;
+            const uint8* src = data(lvl) + y * lineWidth;
+            uint8* dst = dstPixels + _offsets[lvl] + y * lineWidth;
+
+            if (src == dst) {
+                // Swap pixels from both ends of the row towards its middle
+                for (int32 x = 0; x < w / 2; x++)
+                    std::swap_ranges(dst + x * bytesPixel, dst + (x + 1) * bytesPixel,
+                                     dst + (w - 1 - x) * bytesPixel);
+            } else {
+                for (int32 x = 0; x < w; x++)
+                    memcpy(dst + x * bytesPixel, src + (w - 1 - x) * bytesPixel, bytesPixel);
             }
         }
-
-        prevSize += size(lvl);
     }
 
-    _data.swap(newImg);
+    if (newImg)
+        setStorage(newImg);
 
     return true;
 }
 
 bool Image::flipY() {
+    if (isCompressed(_format))
+        return false;
+
     int32 w, h;
-    uint32 nChannels    = numChannels();
-    uint32 bytesChannel = formatToBytesPerChannel(_format);
+    uint32 bytesPixel = formatToBytesPerPixel(_format);
 
-    std::unique_ptr<uint8[]> newImg = std::make_unique<uint8[]>(totalSize());
+    PixelBuffer newImg;
+    uint8* dstPixels = pixels();
+    if (_mapped) {
+        newImg    = Pixels.allocate(totalSize());
+        dstPixels = newImg.get();
+    }
 
     // Flip each mip map level
-    uint32 prevSize = 0;
     for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
         w = mipDimension(_width,  lvl);
         h = mipDimension(_height, lvl);
 
-        uint32 lineWidth = w * nChannels * bytesChannel;
-
-        uint8* dst = newImg.get() + prevSize;
-        uint8* src = (_data.get() + prevSize) + (h - 1) * lineWidth;
+        uint64 lineWidth = (uint64)w * bytesPixel;
 
-        for (int32 y = 0; y < h; y++) {
-            memcpy(dst, src, lineWidth);
+        const uint8* src = data(lvl);
+        uint8* dst = dstPixels + _offsets[lvl];
 
-            dst += lineWidth;
-            src -= lineWidth;
+        if (src == dst) {
+            // Swap rows from both ends of the level towards its middle
+            for (int32 y = 0; y < h / 2; y++)
+                std::swap_ranges(dst + y * lineWidth, dst + (y + 1) * lineWidth,
+                                 dst + (h - 1 - y) * lineWidth);
+        } else {
+            for (int32 y = 0; y < h; y++)
+                memcpy(dst + y * lineWidth, src + (h - 1 - y) * lineWidth, (size_t)lineWidth);
         }
-
-        prevSize += size(lvl);
     }
 
-    _data.swap(newImg);
+    if (newImg)
+        setStorage(newImg);
 
     return true;
 }
@@ -550,108 +788,373 @@ bool Image::toGrayscale() {
 
     uint32 nChan     = numChannels();
     uint32 bytesChan = formatToBytesPerChannel(_format);
-    uint32 graySize  = bytesChan * _width * _height;
-    for (uint32 l = 1; l < _numLevels; l++)
-        graySize += bytesChan * mipDimension(_width, l) * mipDimension(_height, l);
 
     // Only process integer images
     if ((_format >= IMGFMT_R16F && _format <= IMGFMT_RGBA32F) 
-        || nChan < 3 || bytesChan > 2)
+        || nChan < 3 || bytesChan == 0 || bytesChan > 2)
         return false;
 
-    if (bytesChan == 2)
-        graySize *= 2;
+    // Keep the source layout, the offsets are recomputed for the gray format
+    uint64 srcOffsets[MAX_IMAGE_LEVELS + 1];
+    memcpy(srcOffsets, _offsets, sizeof(_offsets));
+    uint8* srcPixels = pixels();
 
-    std::unique_ptr<uint8[]> newImg = std::make_unique<uint8[]>(graySize);
+    ImageFormat grayFormat = (_format <= IMGFMT_RGBA8) ? IMGFMT_R8 : IMGFMT_R16;
+
+    setLayout(grayFormat, _width, _height, _depth, _numLevels);
+
+    // Gray pixels are never ahead of the pixels they are read from, so
+    // owned images are converted in place
+    PixelBuffer newImg;
+    uint8* dstPixels = srcPixels;
+    if (_mapped) {
+        newImg    = Pixels.allocate(totalSize());
+        dstPixels = newImg.get();
+    }
 
     int32 w, h;
-    uint32 prevSize = 0;
-    uint32 prevSizeGray = 0;
     for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
         w = mipDimension(_width,  lvl);
         h = mipDimension(_height, lvl);
 
-        uint32 nPixels = w * h;
-        if (_format <= IMGFMT_RGBA8) {
-            uint8* src  = _data.get()  + prevSize;
-            uint8* dest = newImg.get() + prevSizeGray;
+        uint64 nPixels = (uint64)w * h;
+        if (grayFormat == IMGFMT_R8) {
+            uint8* src8  = srcPixels + srcOffsets[lvl];
+            uint8* dest  = dstPixels + _offsets[lvl];
 
             do {
-                *dest++ = (77 * src[0] + 151 * src[1] + 28 * src[2] + 128) >> 8;
-                src += nChan;
+                *dest++ = (77 * src8[0] + 151 * src8[1] + 28 * src8[2] + 128) >> 8;
+                src8 += nChan;
             } while (--nPixels);
         } else {
-            uint16* src  = (uint16*)_data.get()  + (prevSize / 2);
-            uint16* dest = (uint16*)newImg.get() + prevSizeGray;
+            uint16* src16 = (uint16*)(srcPixels + srcOffsets[lvl]);
+            uint16* dest  = (uint16*)(dstPixels + _offsets[lvl]);
 
             do {
-                *dest++ = (77 * src[0] + 151 * src[1] + 28 * src[2] + 128) >> 8;
-                src += nChan;
+                *dest++ = (77 * src16[0] + 151 * src16[1] + 28 * src16[2] + 128) >> 8;
+                src16 += nChan;
             } while (--nPixels);
         }
+    }
+
+    if (newImg)
+        setStorage(newImg);
+
+    return true;
+}
+
+bool Image::toneMap(float exp) {
+    RendererBuffer params;
+    memset(&params, 0, sizeof(RendererBuffer));
+
+    params.gamma = 1.0f;
+    params.exp   = exp;
+
+    return toneMap(REINHART, params);
+}
 
-        prevSizeGray += w * h;
-        prevSize     += size(lvl);
+bool Image::toneMap(ToneOperator op, const RendererBuffer& params) {
+    static PBR_CONSTEXPR uint64 BATCH_SIZE = 1 << 20;
+
+    // Only process half and float images
+    if (_format < IMGFMT_R16F || _format > IMGFMT_RGBA32F)
+        return false;
+
+    static const ImageFormat ldrFormats[] = { IMGFMT_R8, IMGFMT_RG8, IMGFMT_RGB8, IMGFMT_RGBA8 };
+
+    uint32 nChan = numChannels();
+    bool   half  = compType() == HALF;
+
+    uint64 srcOffsets[MAX_IMAGE_LEVELS + 1];
+    memcpy(srcOffsets, _offsets, sizeof(_offsets));
+    ImageFormat srcFormat = _format;
+    uint8* srcPixels = pixels();
+
+    setLayout(ldrFormats[nChan - 1], _width, _height, _depth, _numLevels);
+
+    // Owned images are mapped in place, a batch of rows at a time. The
+    // batch is staged first, as the smaller output rows would overwrite
+    // source rows other tasks still read.
+    PixelBuffer newImg;
+    uint8* dstPixels = srcPixels;
+    if (_mapped) {
+        newImg    = Pixels.allocate(totalSize());
+        dstPixels = newImg.get();
     }
 
-    if (_format <= IMGFMT_RGBA8)
-        _format = IMGFMT_R8;
-    else 
-        _format = IMGFMT_R16;
+    bool inPlace = dstPixels == srcPixels;
+    std::vector<uint8> staging;
+
+    for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
+        uint32 w = mipDimension(_width, lvl);
+        uint32 rows = mipDimension(_height, lvl) * mipDimension(_depth, lvl);
+
+        const uint8* src = srcPixels + srcOffsets[lvl];
+        uint8* dst = dstPixels + _offsets[lvl];
+
+        uint64 rowValues = (uint64)w * nChan;
+        uint64 srcRowSize = rowValues * formatToBytesPerChannel(srcFormat);
 
-    _data.swap(newImg);
+        uint32 batch = rows;
+        if (inPlace) {
+            batch = (uint32)std::min<uint64>(std::max<uint64>(BATCH_SIZE / rowValues, 1), rows);
+            staging.resize((size_t)(batch * rowValues));
+        }
+
+        // Rows are mapped in parallel, in bands of about 64K values
+        uint32 grain = (uint32)std::max<uint64>(65536 / rowValues, 1);
+
+        for (uint32 first = 0; first < rows; first += batch) {
+            uint32 count = std::min(batch, rows - first);
+            uint8* out = inPlace ? &staging[0] : dst + first * rowValues;
+
+            Workers.parallelRange(count, grain, [&](uint32 begin, uint32 end) {
+                std::vector<float> buffer(half ? (size_t)rowValues : 0);
+
+                for (uint32 y = begin; y < end; ++y) {
+                    const uint8* in = src + (first + y) * srcRowSize;
+
+                    const float* row = (const float*)in;
+                    if (half) {
+                        decodeRow(srcFormat, in, &buffer[0], w);
+                        row = &buffer[0];
+                    }
+
+                    toneMapRow(op, params, row, out + y * rowValues, w, nChan);
+                }
+            });
+
+            if (inPlace)
+                memcpy(dst + first * rowValues, &staging[0], (size_t)(count * rowValues));
+        }
+    }
+
+    if (newImg)
+        setStorage(newImg);
 
     return true;
 }
 
-bool Image::toneMap(float exp) {
-    uint32 nChan     = numChannels();
-    uint32 bytesChan = formatToBytesPerChannel(_format);
+bool Image::generateMipmaps(MipFilter filter, bool sRGB) {
+    // Only uncompressed 1D and 2D images
+    if (!isRowConvertible(_format) || _depth > 1)
+        return false;
+
+    uint32 nChan  = numChannels();
+    uint32 levels = maxMipLevels(_width, _height);
+
+    uint64 rowSize = (uint64)_width * formatToBytesPerPixel(_format);
+    uint64 baseSize = size(0);
+    const uint8* base = data(0);
+
+    // Filter in float, decoding the base level once
+    std::vector<float> src((size_t)_width * _height * nChan);
+    Workers.parallelFor(_height, [&](uint32 y) {
+        decodeRow(_format, base + y * rowSize, &src[(uint64)y * _width * nChan], _width, sRGB);
+    });
+
+    setLayout(_format, _width, _height, _depth, levels);
+
+    PixelBuffer newImg = Pixels.allocate(totalSize());
+    memcpy(newImg.get(), base, (size_t)baseSize);
+
+    // Each level is filtered from the one above it
+    std::vector<float> dst;
+    for (uint32 lvl = 1; lvl < levels; ++lvl) {
+        uint32 srcW = mipDimension(_width,  lvl - 1);
+        uint32 srcH = mipDimension(_height, lvl - 1);
+        uint32 w = mipDimension(_width,  lvl);
+        uint32 h = mipDimension(_height, lvl);
+
+        dst.resize((size_t)w * h * nChan);
+        resample(filter, nChan, &src[0], srcW, srcH, &dst[0], w, h);
+
+        uint8* out = newImg.get() + _offsets[lvl];
+        uint64 lvlRowSize = size(lvl) / h;
+        Workers.parallelFor(h, [&](uint32 y) {
+            encodeRow(_format, &dst[(uint64)y * w * nChan], out + y * lvlRowSize, w, sRGB);
+        });
+
+        src.swap(dst);
+    }
 
-    uint32 mappedSize = 3 * _width * _height;
-    for (uint32 l = 1; l < _numLevels; l++)
-        mappedSize += 3 * mipDimension(_width, l) * mipDimension(_height, l);
+    setStorage(newImg);
 
-    // Only process 32-bit float images
-    if ((_format < IMGFMT_R32F && _format > IMGFMT_RGBA32F)
-        || nChan < 3)
+    return true;
+}
+
+bool Image::convert(ImageFormat format, bool sRGB) {
+    static PBR_CONSTEXPR uint32 BATCH_SIZE = 1 << 16;
+    static PBR_CONSTEXPR uint32 GRAIN_SIZE = 4096;
+
+    if (!isRowConvertible(_format) || !isRowConvertible(format))
         return false;
 
-    std::unique_ptr<uint8[]> newImg = std::make_unique<uint8[]>(mappedSize);
+    if (format == _format)
+        return true;
 
-    int32 w, h;
-    uint32 prevSize = 0;
-    uint32 prevSizeMapped = 0;
+    ImageFormat srcFormat = _format;
+    uint32 srcBpp = formatToBytesPerPixel(srcFormat);
+    uint32 dstBpp = formatToBytesPerPixel(format);
+    uint64 numPixels = totalSize() / srcBpp;
+    uint8* srcPixels = pixels();
+
+    // Levels are contiguous in both layouts, so all of them are converted
+    // as a single run of pixels
+    setLayout(format, _width, _height, _depth, _numLevels);
+
+    if (dstBpp > srcBpp || _mapped) {
+        PixelBuffer newImg = Pixels.allocate(totalSize());
+
+        for (uint64 first = 0; first < numPixels; first += BATCH_SIZE) {
+            uint32 count = (uint32)std::min<uint64>(BATCH_SIZE, numPixels - first);
+
+            Workers.parallelRange(count, GRAIN_SIZE, [&](uint32 begin, uint32 end) {
+                uint64 p = first + begin;
+                convertRow(srcFormat, srcPixels + p * srcBpp, format, newImg.get() + p * dstBpp, end - begin, sRGB);
+            });
+        }
+
+        setStorage(newImg);
+
+        return true;
+    }
+
+    // Smaller pixels are converted in place, one batch at a time. The
+    // batch is staged first, as its tasks would overwrite each other's
+    // source pixels otherwise.
+    std::vector<uint8> staging((size_t)BATCH_SIZE * dstBpp);
+    for (uint64 first = 0; first < numPixels; first += BATCH_SIZE) {
+        uint32 count = (uint32)std::min<uint64>(BATCH_SIZE, numPixels - first);
+
+        Workers.parallelRange(count, GRAIN_SIZE, [&](uint32 begin, uint32 end) {
+            uint64 p = first + begin;
+            convertRow(srcFormat, srcPixels + p * srcBpp, format, &staging[(size_t)begin * dstBpp], end - begin, sRGB);
+        });
+
+        memcpy(srcPixels + first * dstBpp, &staging[0], (size_t)count * dstBpp);
+    }
+
+    return true;
+}
+
+bool Image::compress(ImageFormat format) {
+    if (!isCompressed(format) || !isRowConvertible(_format) || _depth > 1)
+        return false;
+
+    ImageFormat srcFormat = _format;
+    uint32 srcBpp = formatToBytesPerPixel(srcFormat);
+
+    uint64 srcOffsets[MAX_IMAGE_LEVELS + 1];
+    memcpy(srcOffsets, _offsets, sizeof(_offsets));
+    uint8* srcPixels = pixels();
+
+    setLayout(format, _width, _height, _depth, _numLevels);
+
+    PixelBuffer newImg = Pixels.allocate(totalSize());
+
+    uint32 blockSize = formatToBlockSize(format);
     for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
-        w = mipDimension(_width, lvl);
-        h = mipDimension(_height, lvl);
+        uint32 w = mipDimension(_width,  lvl);
+        uint32 h = mipDimension(_height, lvl);
+        uint32 blocksX = (w + 3) / 4;
+        uint32 blocksY = (h + 3) / 4;
+
+        const uint8* src = srcPixels + srcOffsets[lvl];
+        uint8* dst = newImg.get() + _offsets[lvl];
+
+        Workers.parallelRange(blocksY, 1, [&](uint32 begin, uint32 end) {
+            std::vector<uint8> rows((size_t)w * 4 * 4);
+            uint8 block[64];
+
+            for (uint32 by = begin; by < end; ++by) {
+                // Each band of 4 rows is converted to RGBA8, the last
+                // row and column are repeated to fill partial blocks
+                for (uint32 r = 0; r < 4; ++r) {
+                    uint32 y = std::min(by * 4 + r, h - 1);
+                    convertRow(srcFormat, src + (uint64)y * w * srcBpp, IMGFMT_RGBA8, &rows[(size_t)r * w * 4], w);
+                }
+
+                for (uint32 bx = 0; bx < blocksX; ++bx) {
+                    for (uint32 r = 0; r < 4; ++r) {
+                        for (uint32 c = 0; c < 4; ++c) {
+                            uint32 x = std::min(bx * 4 + c, w - 1);
+                            memcpy(block + (r * 4 + c) * 4, &rows[((size_t)r * w + x) * 4], 4);
+                        }
+                    }
+
+                    encodeBlock(format, block, dst + ((uint64)by * blocksX + bx) * blockSize);
+                }
+            }
+        });
+    }
+
+    setStorage(newImg);
+
+    return true;
+}
 
-        uint32 nPixels = w * h;
+bool Image::decompress() {
+    if (!isCompressed(_format) || _depth > 1)
+        return false;
 
-        uint8* src = _data.get()  + prevSize;
-        uint8* dst = newImg.get() + prevSizeMapped;
+    ImageFormat srcFormat = _format;
+    ImageFormat format = IMGFMT_RGBA8;
+    if (srcFormat == IMGFMT_ATI1N)
+        format = IMGFMT_R8;
+    else if (srcFormat == IMGFMT_ATI2N)
+        format = IMGFMT_RG8;
 
-        float* srcf = (float*)src;
-        do {
-            float resR = exp * srcf[0] / (exp * srcf[0] + 1.0f);
-            *dst++ = math::clamp<uint8>(uint8(255.0f * resR), 0u, 255u);
+    uint64 srcOffsets[MAX_IMAGE_LEVELS + 1];
+    memcpy(srcOffsets, _offsets, sizeof(_offsets));
+    uint8* srcPixels = pixels();
 
-            float resG = exp * srcf[1] / (exp * srcf[1] + 1.0f);
-            *dst++ = math::clamp<uint8>(uint8(255.0f * resG), 0u, 255u);
+    setLayout(format, _width, _height, _depth, _numLevels);
 
-            float resB = exp * srcf[2] / (exp * srcf[2] + 1.0f);
-            *dst++ = math::clamp<uint8>(uint8(255.0f * resB), 0u, 255u);
+    PixelBuffer newImg = Pixels.allocate(totalSize());
 
-            srcf += nChan;
-        } while (--nPixels);
+    uint32 bpp = formatToBytesPerPixel(format);
+    uint32 blockSize = formatToBlockSize(srcFormat);
+    std::atomic<bool> success(true);
 
-        prevSizeMapped += 3 * w * h;
-        prevSize       += size(lvl);
+    for (uint32 lvl = 0; lvl < _numLevels; ++lvl) {
+        uint32 w = mipDimension(_width,  lvl);
+        uint32 h = mipDimension(_height, lvl);
+        uint32 blocksX = (w + 3) / 4;
+        uint32 blocksY = (h + 3) / 4;
+
+        const uint8* src = srcPixels + srcOffsets[lvl];
+        uint8* dst = newImg.get() + _offsets[lvl];
+
+        Workers.parallelRange(blocksY, 1, [&](uint32 begin, uint32 end) {
+            std::vector<uint8> rows((size_t)blocksX * 4 * 4 * 4);
+            uint8 block[64];
+
+            for (uint32 by = begin; by < end; ++by) {
+                for (uint32 bx = 0; bx < blocksX; ++bx) {
+                    if (!decodeBlock(srcFormat, src + ((uint64)by * blocksX + bx) * blockSize, block))
+                        success = false;
+
+                    for (uint32 r = 0; r < 4; ++r)
+                        memcpy(&rows[((size_t)r * blocksX * 4 + bx * 4) * 4], block + r * 16, 16);
+                }
+
+                // Rows past the bottom edge of the level are dropped
+                for (uint32 r = 0; r < 4 && by * 4 + r < h; ++r) {
+                    uint8* out = dst + (uint64)(by * 4 + r) * w * bpp;
+                    convertRow(IMGFMT_RGBA8, &rows[(size_t)r * blocksX * 4 * 4], format, out, w);
+                }
+            }
+        });
     }
 
-    _format = IMGFMT_RGB8;
+    // The compressed pixels are kept when any block failed
+    if (!success) {
+        setLayout(srcFormat, _width, _height, _depth, _numLevels);
+        return false; // Error
+    }
 
-    _data.swap(newImg);
+    setStorage(newImg);
 
     return true;
 }
@@ -673,36 +1176,40 @@ int32 Image::depth() const {
 }
 
 uint8* Image::data(uint32 lvl) const {
-    if (_data == nullptr || lvl >= _numLevels)
+    if (pixels() == nullptr || lvl >= _numLevels)
         return nullptr;
 
-    // Compute offset to image level
-    uint32 offset = 0;
-    for (uint32 l = 0; l < lvl; ++l)
-        offset += size(l);
-
-    uint8* start = _data.get() + offset;
+    return pixels() + _offsets[lvl];
+}
 
-    return start;
+ImageView Image::view() const {
+    return ImageView(*this);
 }
 
 ImageType Image::type() const {
-    if (_depth  > 1) return IMGTYPE_3D;
-    //if (_depth == 0) return IMGTYPE_CUBE;
-    if (_height > 1) return IMGTYPE_2D;
-    if (_width  > 1) return IMGTYPE_1D;
-
-    return IMGTYPE_UNKNOWN;
+    return dimensionsToType(_width, _height, _depth);
 }
 
 
 Cubemap::Cubemap() { }
 
 void Cubemap::init(ImageFormat format, uint32 width, uint32 height, uint32 numLevels) {
-    if (width != 0 && height != 0) {
-        for (uint32 i = 0; i < 6; i++)
-            _faces[i].init(format, width, height, 1, numLevels);
-    }
+    if (width == 0 || height == 0)
+        return;
+
+    uint64 offsets[MAX_IMAGE_LEVELS + 1];
+    levelOffsets(format, width, height, 1, std::min(numLevels, MAX_IMAGE_LEVELS), offsets);
+
+    // Faces share one allocation, each starting on its own cache line
+    uint64 faceSize = offsets[std::min(numLevels, MAX_IMAGE_LEVELS)];
+    uint64 stride   = (faceSize + PIXEL_ALIGNMENT - 1) & ~(PIXEL_ALIGNMENT - 1);
+
+    // The faces release the block with their last reference
+    PixelBuffer block = Pixels.allocate(6 * stride);
+    PixelDeleter deleter = block.get_deleter();
+    sref<uint8> storage(block.release(), deleter);
+
+    setFaces(format, width, height, storage.get(), stride, numLevels, storage);
 }
 
 bool Cubemap::loadCubemap(const std::string& filePath) {
@@ -732,9 +1239,34 @@ bool Cubemap::loadCubemap(ImageFormat format, uint32 width, uint32 height, const
         height == 0 || numLevels == 0)
         return false;
 
-    for (uint32 i = 0; i < 6; ++i)
-        if (!_faces[i].loadImage(format, width, height, 1, data, numLevels))
+    init(format, width, height, numLevels);
+
+    uint64 faceSize = _faces[0].totalSize();
+    for (uint32 f = 0; f < 6; ++f)
+        memcpy(_faces[f].data(0), data + f * faceSize, (size_t)faceSize);
+
+    return true;
+}
+
+bool Cubemap::viewCubemap(ImageFormat format, uint32 width, uint32 height, uint8* data,
+                          uint32 numLevels, const sref<void>& owner) {
+    if (data == nullptr || width == 0 ||
+        height == 0 || numLevels == 0)
+        return false;
+
+    uint64 offsets[MAX_IMAGE_LEVELS + 1];
+    levelOffsets(format, width, height, 1, std::min(numLevels, MAX_IMAGE_LEVELS), offsets);
+
+    return setFaces(format, width, height, data, offsets[std::min(numLevels, MAX_IMAGE_LEVELS)],
+                    numLevels, owner);
+}
+
+bool Cubemap::setFaces(ImageFormat format, uint32 width, uint32 height, uint8* data,
+                       uint64 stride, uint32 numLevels, const sref<void>& owner) {
+    for (uint32 f = 0; f < 6; ++f) {
+        if (!_faces[f].viewImage(format, width, height, 1, data + f * stride, numLevels, owner))
             return false;
+    }
 
     return true;
 }
@@ -772,6 +1304,25 @@ bool Cubemap::saveCubemap(const std::string& filePath) {
     return true;
 }
 
+bool Cubemap::generateMipmaps(MipFilter filter, bool sRGB) {
+    std::atomic<bool> success(true);
+    Workers.parallelFor(6, [&](uint32 f) {
+        if (!_faces[f].generateMipmaps(filter, sRGB))
+            success = false;
+    });
+
+    return success;
+}
+
+bool Cubemap::convert(ImageFormat format, bool sRGB) {
+    for (uint32 f = 0; f < 6; ++f) {
+        if (!_faces[f].convert(format, sRGB))
+            return false;
+    }
+
+    return true;
+}
+
 uint8* Cubemap::data(CubemapFace face, uint32 lvl) const {
     return _faces[face].data(lvl);
 }
@@ -812,126 +1363,262 @@ Image* Cubemap::face(CubemapFace face) {
     return &_faces[face];
 }
 
-bool Cubemap::loadCUBE(const std::string& filePath) {
-    CUBEHeader header;
+ImageView Cubemap::view(CubemapFace face) const {
+    return _faces[face].view();
+}
 
-    std::ifstream file(filePath, std::ios::in | std::ios::binary);
-    
-    // Read header
-    file.read((char*)&header, sizeof(CUBEHeader));
+bool Cubemap::loadCUBE(const std::string& filePath) {
+    sref<MappedFile> file = make_sref<MappedFile>();
+    if (!file->open(filePath) || file->size() < sizeof(CUBEHeader))
+        return false;
 
     // Validate file signature
-    if (!(header.id[0] == 'C' && header.id[1] == 'U' &&
-          header.id[2] == 'B' && header.id[3] == 'E')) {
-        file.close();
+    const char* id = (const char*)file->data();
+    if (id[0] != 'C' || id[1] != 'U' || id[2] != 'B')
         return false;
-    }
 
-    uint8* imgData = new uint8[header.totalSize];
+    if (id[3] == 'E')
+        return loadCUBE1(file);
+    else if (id[3] == '2')
+        return loadCUBE2(file);
+
+    return false;
+}
+
+bool Cubemap::loadCUBE1(const sref<MappedFile>& file) {
+    CUBEHeader header;
+    memcpy(&header, file->data(), sizeof(CUBEHeader));
 
-    // Check if file is compressed
-    if (header.totalSize != header.compSize) {
-        uint8* srcBuffer = new uint8[header.compSize];
-        file.read((char*)srcBuffer, header.compSize);
-        file.close();
+    if (file->size() < sizeof(CUBEHeader) + (uint64)header.compSize)
+        return false;
 
-        uLong dstLen = header.totalSize;
-        uLong srcLen = header.compSize;
-        int result = uncompress(imgData, &dstLen, srcBuffer, srcLen);
+    const uint8* payload = file->data() + sizeof(CUBEHeader);
 
-        if (result != Z_OK) {
-            delete[] srcBuffer;
-            delete[] imgData;
+    // Uncompressed files are used directly from the mapping
+    if (header.totalSize == header.compSize) {
+        if (!viewCubemap((ImageFormat)header.fmt, header.width, header.height,
+                         file->data() + sizeof(CUBEHeader), header.levels, file))
             return false;
-        }
 
-        delete[] srcBuffer;
-    } else {
-        // Else read it directly from the file
-        file.read((char*)imgData, header.totalSize);
-        file.close();
+        return totalSize() == header.totalSize;
     }
 
     // Initialize the image
     init((ImageFormat)header.fmt, header.width, header.height, header.levels);
 
-    uint8* ptr = imgData;
+    if (totalSize() != header.totalSize)
+        return false; // Warn
+
+    // Inflate straight into each face, faces are stored one after the other
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+
+    if (inflateInit(&stream) != Z_OK)
+        return false;
+
+    stream.next_in  = (Bytef*)payload;
+    stream.avail_in = header.compSize;
+
+    int result = Z_OK;
+    for (uint32 f = 0; f < 6 && result == Z_OK; ++f) {
+        stream.next_out  = _faces[f].data(0);
+        stream.avail_out = (uInt)_faces[f].totalSize();
+
+        while (result == Z_OK && stream.avail_out > 0)
+            result = inflate(&stream, Z_NO_FLUSH);
+
+        // The stream must not end before the last face is filled
+        if (result == Z_STREAM_END && (f < 5 || stream.avail_out != 0))
+            result = Z_DATA_ERROR;
+    }
+
+    // Output is full, the stream should have nothing left
+    if (result == Z_OK) {
+        uint8 extra;
+        stream.next_out  = &extra;
+        stream.avail_out = 1;
+
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (stream.avail_out == 0)
+            result = Z_DATA_ERROR;
+    }
+
+    inflateEnd(&stream);
+
+    return result == Z_STREAM_END;
+}
+
+bool Cubemap::loadCUBE2(const sref<MappedFile>& file) {
+    if (file->size() < sizeof(CUBEHeader2))
+        return false;
+
+    CUBEHeader2 header;
+    memcpy(&header, file->data(), sizeof(CUBEHeader2));
+
+    if (header.version > CUBE_VERSION || header.levels == 0 ||
+        header.levels > MAX_IMAGE_LEVELS || header.numChunks != 6 * header.levels)
+        return false;
+
+    if (header.fmt == IMGFMT_UNKNOWN || header.fmt > IMGFMT_BC7)
+        return false;
+
+    uint64 tableSize = sizeof(CUBEChunk) * header.numChunks;
+    if (file->size() < sizeof(CUBEHeader2) + tableSize)
+        return false;
+
+    std::vector<CUBEChunk> chunks(header.numChunks);
+    memcpy(&chunks[0], file->data() + sizeof(CUBEHeader2), tableSize);
+
+    // Validate the chunk table against the image layout
+    bool storedRaw = true;
     for (uint32 f = 0; f < 6; ++f) {
-        for (uint32 lvl = 0; lvl < header.levels; ++lvl) {            
-            uint32 size = _faces[f].size(lvl);
-            //file.read((char*)ptr, size);
-            _faces[f].loadImage(ptr, lvl);
-            ptr += size;
+        for (uint32 lvl = 0; lvl < header.levels; ++lvl) {
+            const CUBEChunk& chunk = chunks[f * header.levels + lvl];
+
+            uint64 expected = levelSize((ImageFormat)header.fmt, mipDimension(header.width, lvl),
+                                        mipDimension(header.height, lvl), 1);
+
+            // Written so that corrupt offsets cannot wrap around
+            if (chunk.size != expected || chunk.offset > file->size() ||
+                chunk.compSize > file->size() - chunk.offset)
+                return false;
+
+            // Raw chunks of a face must be laid out contiguously to be mapped
+            if (chunk.compSize != chunk.size)
+                storedRaw = false;
+            else if (lvl > 0) {
+                const CUBEChunk& prev = chunks[f * header.levels + lvl - 1];
+                if (prev.offset + prev.size != chunk.offset)
+                    storedRaw = false;
+            }
         }
     }
 
-    //file.close();
+    // Uncompressed files are used directly from the mapping
+    if (storedRaw) {
+        for (uint32 f = 0; f < 6; ++f) {
+            if (!_faces[f].mapImage((ImageFormat)header.fmt, header.width, header.height, 1,
+                                    file, chunks[f * header.levels].offset, header.levels))
+                return false;
+        }
 
-    delete[] imgData;
+        return true;
+    }
 
-    if (totalSize() != header.totalSize)
-        return false; // Warn
+    init((ImageFormat)header.fmt, header.width, header.height, header.levels);
 
-    return true;
+    // Inflate every chunk in parallel, directly into its face and level
+    std::atomic<bool> success(true);
+    Workers.parallelFor(header.numChunks, [&](uint32 c) {
+        const CUBEChunk& chunk = chunks[c];
+        const uint8* src = file->data() + chunk.offset;
+        uint8* dst = _faces[c / header.levels].data(c % header.levels);
+
+        if (chunk.compSize == chunk.size) {
+            memcpy(dst, src, (size_t)chunk.size);
+            return;
+        }
+
+        // zlib lengths may be 32-bit, larger chunks are always stored raw
+        if (chunk.size > (uLong)-1) {
+            success = false;
+            return;
+        }
+
+        uLongf dstLen = (uLongf)chunk.size;
+        int result = uncompress(dst, &dstLen, src, (uLong)chunk.compSize);
+        if (result != Z_OK || dstLen != chunk.size)
+            success = false;
+    });
+
+    return success;
 }
 
 bool Cubemap::saveCUBE(const std::string& filePath) const {
-    CUBEHeader header;
+    uint32 levels = numLevels();
+
+    CUBEHeader2 header;
     header.id[0] = 'C';
     header.id[1] = 'U';
     header.id[2] = 'B';
-    header.id[3] = 'E';
-    header.fmt    = format();
-    header.width  = width();
-    header.height = height();
-    header.levels = numLevels();
-    header.totalSize = totalSize();
-    header.compSize  = header.totalSize;
+    header.id[3] = '2';
+    header.version   = CUBE_VERSION;
+    header.fmt       = format();
+    header.width     = width();
+    header.height    = height();
+    header.levels    = levels;
+    header.numChunks = 6 * levels;
+    header.reserved  = 0;
+
+    // Compress every face and level in parallel
+    std::vector<std::vector<uint8>> buffers(header.numChunks);
+    std::vector<CUBEChunk> chunks(header.numChunks);
+
+    std::atomic<bool> success(true);
+    Workers.parallelFor(header.numChunks, [&](uint32 c) {
+        const Image& face = _faces[c / levels];
+        uint32 lvl = c % levels;
+
+        // zlib lengths may be 32-bit, so store large chunks as is
+        if (face.size(lvl) > (uLong)-1 / 2) {
+            chunks[c].size     = face.size(lvl);
+            chunks[c].compSize = face.size(lvl);
+            return;
+        }
 
-    // Copy image data into contiguous buffer
-    uint8* imgData = new uint8[header.totalSize];
-    uint8* auxPtr  = imgData;
-    for (uint32 f = 0; f < 6; ++f) {
-        for (uint32 lvl = 0; lvl < header.levels; ++lvl) {
-            size_t size = _faces[f].size(lvl);
-            memcpy(auxPtr, (const char*)_faces[f].data(lvl), size);
-            auxPtr += size;
+        uLong srcLen = (uLong)face.size(lvl);
+        uLong dstLen = compressBound(srcLen);
+
+        std::vector<uint8>& buffer = buffers[c];
+        buffer.resize(dstLen);
+
+        if (compress(&buffer[0], &dstLen, face.data(lvl), srcLen) != Z_OK) {
+            success = false;
+            return;
         }
-    }
 
-    // Compress buffer with zlib
-    uLong  dstLen    = compressBound(header.totalSize);
-    uint8* dstBuffer = new uint8[dstLen];
-    int result = compress(dstBuffer, &dstLen, imgData, header.totalSize);
+        // Store the chunk as is if compression does not pay off
+        if (dstLen >= srcLen)
+            buffer.clear();
+        else
+            buffer.resize(dstLen);
+
+        chunks[c].size     = srcLen;
+        chunks[c].compSize = buffer.empty() ? srcLen : dstLen;
+    });
 
-    if (result != Z_OK) {
-        delete[] dstBuffer;
-        delete[] imgData;
+    if (!success)
         return false;
-    }
 
-    // Store the compressed size
-    header.compSize = dstLen;
+    uint64 offset = sizeof(CUBEHeader2) + sizeof(CUBEChunk) * header.numChunks;
+    for (uint32 c = 0; c < header.numChunks; ++c) {
+        chunks[c].offset = offset;
+        offset += chunks[c].compSize;
+    }
 
     // Write to file
     std::ofstream file(filePath, std::ios::out | std::ios::binary);
-    file.write((const char*)&header, sizeof(CUBEHeader));
-    file.write((const char*)dstBuffer, dstLen);
-    file.close();
+    file.write((const char*)&header, sizeof(CUBEHeader2));
+    file.write((const char*)&chunks[0], sizeof(CUBEChunk) * header.numChunks);
+
+    for (uint32 c = 0; c < header.numChunks; ++c) {
+        if (buffers[c].empty())
+            file.write((const char*)_faces[c / levels].data(c % levels), (std::streamsize)chunks[c].size);
+        else
+            file.write((const char*)&buffers[c][0], (std::streamsize)chunks[c].compSize);
+    }
 
-    // Release memory
-    delete[] imgData;
-    delete[] dstBuffer;
+    file.close();
 
-    return true;
+    return !file.fail();
 }
 
-uint32 Cubemap::size(CubemapFace face, uint32 lvl) const {
+uint64 Cubemap::size(CubemapFace face, uint32 lvl) const {
     return _faces[face].size(lvl);
 }
 
-uint32 Cubemap::totalSize() const {
-    uint32 size = 0;
+uint64 Cubemap::totalSize() const {
+    uint64 size = 0;
     for (uint32 f = 0; f < 6; ++f)
         size += _faces[f].totalSize();
     return size;
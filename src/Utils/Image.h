@@ -3,9 +3,13 @@
 
 #include <PBR.h>
 #include <PBRMath.h>
+#include <ToneMap.h>
+#include <PixelAllocator.h>
 
 namespace pbr {
 
+    class MappedFile;
+
     enum ImageType : uint32 {
         IMGTYPE_1D   = 0,
         IMGTYPE_2D   = 1,
@@ -108,10 +112,71 @@ namespace pbr {
         IMGFMT_BC7   = 56
     };
 
+    enum MipFilter : uint32 {
+        MIPFILTER_BOX     = 0,
+        MIPFILTER_KAISER  = 1,
+        MIPFILTER_LANCZOS = 2
+    };
+
     uint32 formatToNumChannels(ImageFormat format);
     uint32 formatToBytesPerChannel(ImageFormat format);
+    uint32 formatToBytesPerPixel(ImageFormat format);
     ImageComponent formatToImgComp(ImageFormat format);
+
+    bool isCompressed(ImageFormat format);
+
+    // Bytes of a 4x4 block of a compressed format
+    uint32 formatToBlockSize(ImageFormat format);
+
+    // Format with the given component and channel count. 8 and 16-bit
+    // integers give the normalized formats.
+    ImageFormat toFormat(ImageComponent comp, uint32 numChannels);
+
     uint32 mipDimension(uint32 baseDim, uint32 level);
+    uint32 maxMipLevels(uint32 width, uint32 height, uint32 depth = 1);
+
+    // Bytes of a single level with the given dimensions
+    uint64 levelSize(ImageFormat format, uint32 width, uint32 height, uint32 depth);
+
+    // Enough levels for a full chain of any 32-bit dimension
+    static PBR_CONSTEXPR uint32 MAX_IMAGE_LEVELS = 32;
+
+    class Image;
+
+    // Non-owning view of the pixels of an image, with every level laid out
+    // after the previous one. The memory must outlive the view.
+    class ImageView {
+    public:
+        ImageView();
+        ImageView(const Image& img);
+        ImageView(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                  const uint8* data, uint32 numLevels = 1);
+
+        ImageType   type()   const;
+        ImageFormat format() const;
+
+        uint32 numLevels() const;
+
+        int32 width()  const;
+        int32 height() const;
+        int32 depth()  const;
+
+        const uint8* data(uint32 lvl = 0) const;
+
+        uint64 size(uint32 lvl = 0) const;
+        uint64 totalSize() const;
+
+    private:
+        ImageFormat _format;
+        int32  _width;
+        int32  _height;
+        int32  _depth;
+        uint32 _numLevels;
+
+        uint64 _offsets[MAX_IMAGE_LEVELS + 1];
+
+        const uint8* _data;
+    };
 
     class Image {
     public:
@@ -129,6 +194,15 @@ namespace pbr {
         // Loads a mipmap level from memory
         bool loadImage(const uint8* data, uint32 lvl);
 
+        // Uses the pixels of a mapped file, starting at offset, as storage
+        bool mapImage(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                      const sref<MappedFile>& file, uint64 offset, uint32 numLevels = 1);
+
+        // Uses external memory as storage, without copying it. The memory
+        // is kept alive by owner, or must outlive the image without one.
+        bool viewImage(ImageFormat format, uint32 width, uint32 height, uint32 depth,
+                       uint8* data, uint32 numLevels = 1, const sref<void>& owner = nullptr);
+
         bool saveImage (const std::string& filePath, uint32 lvl = 0) const;
         bool saveMipMap(const std::string& filePath) const;
 
@@ -139,21 +213,57 @@ namespace pbr {
         bool   hasMipMap() const;
         uint32 numLevels() const;
 
+        // The pixels live in a mapping or external memory, that transforms
+        // never write to
+        bool   isMapped()  const;
+
         int32 width()  const;
         int32 height() const;
         int32 depth()  const;
 
         uint8* data(uint32 lvl = 0) const;
 
+        ImageView view() const;
+
+        // Transforms reuse the storage of the image, mapped images are
+        // copied to storage of their own instead
         bool flipX();
         bool flipY();
         bool toGrayscale();
         bool toneMap(float exposure = 1.0f);
+
+        // Converts a half or float image to 8-bit, with the same tone curve
+        // and gamma correction as the renderer
+        bool toneMap(ToneOperator op, const RendererBuffer& params);
+
+        // Rebuilds the full mip chain from the base level. With sRGB, the
+        // color of RGB8 and RGBA8 images is filtered in linear space.
+        bool generateMipmaps(MipFilter filter = MIPFILTER_BOX, bool sRGB = false);
+
+        // Converts every level to another uncompressed format, adding or
+        // dropping channels as remapChannels does. Conversions to smaller
+        // pixels are done in place. With sRGB, the color of 8-bit formats
+        // is sRGB encoded on both sides.
+        bool convert(ImageFormat format, bool sRGB = false);
+
+        // Block compresses every level of a 2D image. Levels are encoded
+        // in parallel bands of blocks.
+        bool compress(ImageFormat format);
+
+        // Decodes a compressed image to RGBA8, or to R8 and RG8 for BC4
+        // and BC5. BC7 is only decoded for mode 6 blocks, the ones
+        // compress writes. Images with blocks that cannot be decoded are
+        // left compressed and false is returned.
+        bool decompress();
         
-        uint32 size(uint32 lvl = 0) const;
-        uint32 totalSize()   const;
+        uint64 size(uint32 lvl = 0) const;
+        uint64 totalSize()   const;
         uint32 numChannels() const;
 
+        // Whether every texel of the first level has full alpha. False for
+        // compressed images.
+        bool isOpaque() const;
+
     private:
         bool loadPNG  (const std::string& filePath);
         bool loadIMG  (const std::string& filePath);
@@ -162,6 +272,11 @@ namespace pbr {
         bool saveIMG  (const std::string& filePath) const;
         bool savePNG  (const std::string& filePath, uint32 lvl = 0) const;
         bool saveEXR  (const std::string& filePath, uint32 lvl = 0) const;
+        bool saveHDR  (const std::string& filePath, uint32 lvl = 0) const;
+
+        uint8* pixels() const;
+        void   setStorage(PixelBuffer& data);
+        void   setLayout(ImageFormat format, uint32 width, uint32 height, uint32 depth, uint32 numLevels);
 
         ImageFormat _format;
         int32  _width;
@@ -169,7 +284,15 @@ namespace pbr {
         int32  _depth;
         uint32 _numLevels;
 
-        std::unique_ptr<uint8[]> _data;
+        // Byte offset of every level, the last entry holds the total size
+        uint64 _offsets[MAX_IMAGE_LEVELS + 1];
+
+        PixelBuffer _data;
+
+        // Storage of mapped and viewed images, _data is empty meanwhile.
+        // _owner keeps the memory alive, if there is one.
+        sref<void> _owner;
+        uint8* _mapped;
     };
 
     enum CubemapFace : uint32 {
@@ -181,6 +304,8 @@ namespace pbr {
         CUBE_Z_NEG = 5
     };
 
+    // Faces are views into a single allocation, unless loaded or
+    // transformed one at a time
     class Cubemap {
     public:
         Cubemap();
@@ -189,11 +314,22 @@ namespace pbr {
 
         bool loadCubemap(const std::string& filePath);
         bool loadCubemap(const std::string paths[6]);
+
+        // Loads the six faces, stored one after the other in data
         bool loadCubemap(ImageFormat format, uint32 width, uint32 height, const uint8* data, uint32 numLevels = 1);
         bool loadFace   (CubemapFace face, const uint8* data, uint32 lvl);
 
+        // Same as loadCubemap, but the faces are used in place. The memory
+        // is kept alive by owner, or must outlive the cubemap without one.
+        bool viewCubemap(ImageFormat format, uint32 width, uint32 height, uint8* data,
+                         uint32 numLevels = 1, const sref<void>& owner = nullptr);
+
         bool saveCubemap(const std::string& filePath);
 
+        // Builds the mip chain of every face in parallel
+        bool generateMipmaps(MipFilter filter = MIPFILTER_BOX, bool sRGB = false);
+        bool convert(ImageFormat format, bool sRGB = false);
+
         uint8* data(CubemapFace face, uint32 lvl = 0) const;
 
         ImageType      type()     const;
@@ -207,8 +343,10 @@ namespace pbr {
         const Image* face(CubemapFace face) const;
         Image* face(CubemapFace face);
 
-        uint32 size(CubemapFace face, uint32 lvl = 0) const;
-        uint32 totalSize()   const;
+        ImageView view(CubemapFace face) const;
+
+        uint64 size(CubemapFace face, uint32 lvl = 0) const;
+        uint64 totalSize()   const;
         uint32 numChannels() const;
 
         bool   hasMipMap() const;
@@ -216,8 +354,14 @@ namespace pbr {
 
     private:
         bool loadCUBE(const std::string& filePath);
+        bool loadCUBE1(const sref<MappedFile>& file);
+        bool loadCUBE2(const sref<MappedFile>& file);
         bool saveCUBE(const std::string& filePath) const;
 
+        // Views faces that start stride bytes apart
+        bool setFaces(ImageFormat format, uint32 width, uint32 height, uint8* data,
+                      uint64 stride, uint32 numLevels, const sref<void>& owner);
+
         Image _faces[6];
     };
 
@@ -232,6 +376,22 @@ namespace pbr {
         uint32 levels;
     }; // 32 Bytes
 
+    static PBR_CONSTEXPR uint32 IMG_VERSION = 2;
+
+    // 64-bit IMG container, for images above 4 GB
+    struct IMGHeader2 {
+        char id[4];       // "IMG2"
+        uint32 version;
+        uint32 fmt;
+        uint32 width;
+        uint32 height;
+        uint32 depth;
+        uint32 levels;
+        uint32 reserved;
+        uint64 compSize;
+        uint64 totalSize;
+    }; // 48 Bytes
+
     struct CUBEHeader {
         char id[4];
         uint32 fmt;
@@ -242,6 +402,27 @@ namespace pbr {
         uint32 levels;
     }; // 28 Bytes
 
+    static PBR_CONSTEXPR uint32 CUBE_VERSION = 2;
+
+    // Chunked CUBE container. Every face and level is compressed on its own,
+    // so chunks can be inflated in parallel straight into their destination.
+    struct CUBEHeader2 {
+        char id[4];       // "CUB2"
+        uint32 version;
+        uint32 fmt;
+        uint32 width;
+        uint32 height;
+        uint32 levels;
+        uint32 numChunks; // 6 * levels, ordered by face and then level
+        uint32 reserved;
+    }; // 32 Bytes, followed by the chunk table
+
+    struct CUBEChunk {
+        uint64 offset;    // From the start of the file
+        uint64 compSize;  // Equal to size if the chunk is stored uncompressed
+        uint64 size;
+    }; // 24 Bytes
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include <MappedFile.h>
+
+#ifdef PBR_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace pbr;
+
+#ifdef PBR_WINDOWS
+
+MappedFile::MappedFile() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(nullptr) { }
+
+bool MappedFile::open(const std::string& filePath) {
+    close();
+
+    _file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (_mapping == nullptr) {
+        close();
+        return false;
+    }
+
+    _data = (uint8*)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (_data == nullptr) {
+        close();
+        return false;
+    }
+
+    _size = (uint64)fileSize.QuadPart;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        UnmapViewOfFile(_data);
+
+    if (_mapping)
+        CloseHandle(_mapping);
+
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+
+    _data    = nullptr;
+    _size    = 0;
+    _mapping = nullptr;
+    _file    = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : _data(nullptr), _size(0) { }
+
+bool MappedFile::open(const std::string& filePath) {
+    close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (ptr == MAP_FAILED)
+        return false;
+
+    madvise(ptr, (size_t)st.st_size, MADV_WILLNEED);
+
+    _data = (uint8*)ptr;
+    _size = (uint64)st.st_size;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        munmap(_data, (size_t)_size);
+
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::isOpen() const {
+    return _data != nullptr;
+}
+
+uint8* MappedFile::data() const {
+    return _data;
+}
+
+uint64 MappedFile::size() const {
+    return _size;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef __PBR_MAPPEDFILE_H__
+#define __PBR_MAPPEDFILE_H__
+
+#include <PBR.h>
+
+namespace pbr {
+
+    // Maps an entire file into the address space of the process.
+    // Pages are private (copy-on-write), so writes never reach the file.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& filePath);
+        void close();
+
+        bool isOpen() const;
+
+        uint8* data() const;
+        uint64 size() const;
+
+    private:
+        uint8* _data;
+        uint64 _size;
+
+#ifdef PBR_WINDOWS
+        void* _file;
+        void* _mapping;
+#endif
+    };
+
+}
+
+#endif
\ No newline at end of file
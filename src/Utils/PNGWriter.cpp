@@ -0,0 +1,153 @@
+#include <PNGWriter.h>
+
+#include <cstring>
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR uint32 CHUNK_SIZE = 256 << 10;
+
+    static const uint8 PNG_SIGNATURE[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+    enum PNGFilter : uint8 {
+        FILTER_SUB = 1
+    };
+
+    void writeBE(uint8* dst, uint32 val) {
+        dst[0] = (uint8)(val >> 24);
+        dst[1] = (uint8)(val >> 16);
+        dst[2] = (uint8)(val >> 8);
+        dst[3] = (uint8)(val);
+    }
+}
+
+PNGWriter::PNGWriter() : _open(false), _width(0), _height(0), _nChan(0), _rows(0) {
+    memset(&_stream, 0, sizeof(z_stream));
+}
+
+PNGWriter::~PNGWriter() {
+    if (_open)
+        deflateEnd(&_stream);
+}
+
+bool PNGWriter::open(const std::string& filePath, uint32 width, uint32 height, uint32 nChan) {
+    if (_open || width == 0 || height == 0 || (nChan != 3 && nChan != 4))
+        return false;
+
+    _file.open(filePath, std::ios::out | std::ios::binary);
+    if (!_file.is_open())
+        return false; // Error
+
+    memset(&_stream, 0, sizeof(z_stream));
+    if (deflateInit(&_stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        _file.close();
+        return false; // Error
+    }
+
+    _open   = true;
+    _width  = width;
+    _height = height;
+    _nChan  = nChan;
+    _rows   = 0;
+
+    _filtered.resize((size_t)width * nChan + 1);
+    _chunk.resize(CHUNK_SIZE);
+
+    _stream.next_out  = &_chunk[0];
+    _stream.avail_out = CHUNK_SIZE;
+
+    // Width, height, bit depth, color type, compression, filter, interlace
+    uint8 header[13];
+    writeBE(header,     width);
+    writeBE(header + 4, height);
+    header[8]  = 8;
+    header[9]  = (nChan == 4) ? 6 : 2;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    _file.write((const char*)PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+
+    return writeChunk("IHDR", header, sizeof(header));
+}
+
+bool PNGWriter::writeRow(const uint8* row) {
+    if (!_open || _rows >= _height)
+        return false;
+
+    // Each byte minus the one of the previous pixel, which suits the
+    // smooth gradients of renders
+    uint32 rowSize = _width * _nChan;
+
+    _filtered[0] = FILTER_SUB;
+    memcpy(&_filtered[1], row, _nChan);
+    for (uint32 i = _nChan; i < rowSize; ++i)
+        _filtered[i + 1] = (uint8)(row[i] - row[i - _nChan]);
+
+    _stream.next_in  = &_filtered[0];
+    _stream.avail_in = rowSize + 1;
+
+    _rows++;
+
+    return deflateRows(Z_NO_FLUSH);
+}
+
+bool PNGWriter::close() {
+    if (!_open)
+        return false;
+
+    bool success = _rows == _height && deflateRows(Z_FINISH) && writeChunk("IEND", nullptr, 0);
+
+    deflateEnd(&_stream);
+    _open = false;
+
+    _file.close();
+
+    _filtered.clear();
+    _chunk.clear();
+
+    return success && !_file.fail();
+}
+
+bool PNGWriter::deflateRows(int flush) {
+    while (true) {
+        int ret = deflate(&_stream, flush);
+        if (ret == Z_STREAM_ERROR)
+            return false; // Error
+
+        bool done = (flush == Z_FINISH) ? ret == Z_STREAM_END : _stream.avail_in == 0;
+
+        // Full chunks are written as they fill, the last one once done
+        if (_stream.avail_out == 0 || (done && flush == Z_FINISH)) {
+            uint32 size = CHUNK_SIZE - _stream.avail_out;
+            if (size > 0 && !writeChunk("IDAT", &_chunk[0], size))
+                return false;
+
+            _stream.next_out  = &_chunk[0];
+            _stream.avail_out = CHUNK_SIZE;
+        }
+
+        if (done)
+            return true;
+    }
+}
+
+bool PNGWriter::writeChunk(const char* type, const uint8* data, uint32 size) {
+    uint8 length[4];
+    writeBE(length, size);
+
+    uLong crc = crc32(0, (const Bytef*)type, 4);
+    if (size > 0)
+        crc = crc32(crc, data, size);
+
+    uint8 footer[4];
+    writeBE(footer, (uint32)crc);
+
+    _file.write((const char*)length, 4);
+    _file.write(type, 4);
+    if (size > 0)
+        _file.write((const char*)data, size);
+    _file.write((const char*)footer, 4);
+
+    return !_file.fail();
+}
@@ -0,0 +1,49 @@
+#ifndef __PBR_PNGWRITER_H__
+#define __PBR_PNGWRITER_H__
+
+#include <fstream>
+
+#include <PBR.h>
+
+#include <zlib.h>
+
+namespace pbr {
+
+    // Writes an 8-bit RGB or RGBA png a row at a time, top to bottom, so
+    // images larger than memory can be saved as they are produced. Rows
+    // are compressed as they come and only the last one is kept.
+    class PNGWriter {
+    public:
+        PNGWriter();
+        ~PNGWriter();
+
+        PNGWriter(const PNGWriter&) = delete;
+        PNGWriter& operator=(const PNGWriter&) = delete;
+
+        bool open(const std::string& filePath, uint32 width, uint32 height, uint32 nChan);
+
+        bool writeRow(const uint8* row);
+
+        // Fails if rows are missing
+        bool close();
+
+    private:
+        bool deflateRows(int flush);
+        bool writeChunk(const char* type, const uint8* data, uint32 size);
+
+        std::ofstream _file;
+        z_stream      _stream;
+        bool          _open;
+
+        uint32 _width;
+        uint32 _height;
+        uint32 _nChan;
+        uint32 _rows;
+
+        std::vector<uint8> _filtered;
+        std::vector<uint8> _chunk;
+    };
+
+}
+
+#endif
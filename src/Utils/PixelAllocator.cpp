@@ -0,0 +1,175 @@
+#include <PixelAllocator.h>
+
+#ifdef PBR_WINDOWS
+#include <malloc.h>
+#else
+#include <cstdlib>
+#include <sys/mman.h>
+#endif
+
+using namespace pbr;
+
+namespace {
+    static PBR_CONSTEXPR uint32 CLASSES_PER_OCTAVE = 4;
+    static PBR_CONSTEXPR uint32 NUM_CLASSES = 64 * CLASSES_PER_OCTAVE;
+
+    static PBR_CONSTEXPR uint64 MIN_BLOCK_SIZE   = 64;
+    static PBR_CONSTEXPR uint64 HUGE_PAGE_SIZE   = 2 << 20;
+    static PBR_CONSTEXPR uint64 DEFAULT_CAPACITY = 256 << 20; // 256 MB
+
+    uint32 highestBit(uint64 val) {
+        uint32 bit = 0;
+        while (val >>= 1)
+            bit++;
+
+        return bit;
+    }
+
+    // Sizes in (2^n, 2^(n+1)] are split in CLASSES_PER_OCTAVE steps
+    uint32 sizeToClass(uint64 size) {
+        size = std::max(size, MIN_BLOCK_SIZE);
+
+        uint32 octave = highestBit(size - 1);
+        uint64 step   = (1ull << octave) / CLASSES_PER_OCTAVE;
+
+        return octave * CLASSES_PER_OCTAVE + (uint32)((size - 1 - (1ull << octave)) / step);
+    }
+
+    uint64 classToSize(uint32 sizeClass) {
+        uint32 octave = sizeClass / CLASSES_PER_OCTAVE;
+        uint64 step   = (1ull << octave) / CLASSES_PER_OCTAVE;
+
+        return (1ull << octave) + (sizeClass % CLASSES_PER_OCTAVE + 1) * step;
+    }
+
+    uint8* alignedAlloc(uint64 size, uint64 alignment) {
+#ifdef PBR_WINDOWS
+        return (uint8*)_aligned_malloc((size_t)size, (size_t)alignment);
+#else
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, (size_t)alignment, (size_t)size) != 0)
+            return nullptr;
+
+        return (uint8*)ptr;
+#endif
+    }
+
+    void alignedFree(uint8* ptr) {
+#ifdef PBR_WINDOWS
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+}
+
+void PixelDeleter::operator()(uint8* ptr) const {
+    Pixels.release(ptr, sizeClass);
+}
+
+PixelAllocator::PixelAllocator() : _free(NUM_CLASSES), _capacity(DEFAULT_CAPACITY),
+    _cachedSize(0), _hugePages(false) {
+
+}
+
+PixelAllocator& PixelAllocator::get() {
+    // Never destroyed, as images may be freed during static destruction
+    static PixelAllocator* allocator = new PixelAllocator();
+    return *allocator;
+}
+
+PixelBuffer PixelAllocator::allocate(uint64 size) {
+    uint32 sizeClass = sizeToClass(size);
+    uint64 blockSize = classToSize(sizeClass);
+
+    bool hugePages;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        std::vector<uint8*>& blocks = _free[sizeClass];
+        if (!blocks.empty()) {
+            uint8* ptr = blocks.back();
+            blocks.pop_back();
+
+            _cachedSize -= blockSize;
+
+            return PixelBuffer(ptr, PixelDeleter{ sizeClass });
+        }
+
+        hugePages = _hugePages;
+    }
+
+    uint8* ptr = nullptr;
+    if (hugePages && blockSize >= HUGE_PAGE_SIZE) {
+        ptr = alignedAlloc(blockSize, HUGE_PAGE_SIZE);
+
+#if defined(PBR_LINUX) && defined(MADV_HUGEPAGE)
+        // Only a hint, the block is still usable without huge pages
+        if (ptr)
+            madvise(ptr, (size_t)blockSize, MADV_HUGEPAGE);
+#endif
+    } else {
+        ptr = alignedAlloc(blockSize, PIXEL_ALIGNMENT);
+    }
+
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return PixelBuffer(ptr, PixelDeleter{ sizeClass });
+}
+
+void PixelAllocator::setCapacity(uint64 maxBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _capacity = maxBytes;
+
+    // Largest blocks go first
+    for (uint32 c = NUM_CLASSES; c-- > 0 && _cachedSize > _capacity; ) {
+        std::vector<uint8*>& blocks = _free[c];
+        while (!blocks.empty() && _cachedSize > _capacity) {
+            alignedFree(blocks.back());
+            blocks.pop_back();
+
+            _cachedSize -= classToSize(c);
+        }
+    }
+}
+
+uint64 PixelAllocator::cachedSize() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cachedSize;
+}
+
+void PixelAllocator::setHugePages(bool enable) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hugePages = enable;
+}
+
+void PixelAllocator::trim() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (std::vector<uint8*>& blocks : _free) {
+        for (uint8* ptr : blocks)
+            alignedFree(ptr);
+
+        blocks.clear();
+    }
+
+    _cachedSize = 0;
+}
+
+void PixelAllocator::release(uint8* ptr, uint32 sizeClass) {
+    uint64 blockSize = classToSize(sizeClass);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_cachedSize + blockSize <= _capacity) {
+            _free[sizeClass].push_back(ptr);
+            _cachedSize += blockSize;
+            return;
+        }
+    }
+
+    alignedFree(ptr);
+}
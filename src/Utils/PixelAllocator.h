@@ -0,0 +1,64 @@
+#ifndef __PBR_PIXELALLOCATOR_H__
+#define __PBR_PIXELALLOCATOR_H__
+
+#include <mutex>
+
+#include <PBR.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: PixelBuffer pixels = Pixels.allocate(size);
+#define Pixels PixelAllocator::get()
+
+namespace pbr {
+
+    // Alignment of every block, a cache line and a full AVX-512 register
+    static PBR_CONSTEXPR uint64 PIXEL_ALIGNMENT = 64;
+
+    // Returns blocks to the allocator they came from
+    struct PixelDeleter {
+        uint32 sizeClass = 0;
+
+        void operator()(uint8* ptr) const;
+    };
+
+    using PixelBuffer = std::unique_ptr<uint8[], PixelDeleter>;
+
+    // Allocates pixel storage. Blocks are left uninitialized and rounded
+    // up to size classes, four per power of two, so freed blocks can be
+    // handed out again to images of about the same size.
+    class PixelAllocator {
+    public:
+        static PixelAllocator& get();
+
+        PixelBuffer allocate(uint64 size);
+
+        // Bytes of freed blocks kept for reuse, the rest go to the system
+        void   setCapacity(uint64 maxBytes);
+        uint64 cachedSize() const;
+
+        // Backs blocks of 2 MB and above with huge pages, where the
+        // system supports them. Off by default.
+        void setHugePages(bool enable);
+
+        // Frees every cached block
+        void trim();
+
+    private:
+        friend struct PixelDeleter;
+
+        PixelAllocator();
+
+        void release(uint8* ptr, uint32 sizeClass);
+
+        std::vector<std::vector<uint8*>> _free;
+
+        uint64 _capacity;
+        uint64 _cachedSize;
+        bool   _hugePages;
+
+        mutable std::mutex _mutex;
+    };
+
+}
+
+#endif
@@ -0,0 +1,612 @@
+#include <PixelOps.h>
+#include <SIMD.h>
+#include <RGBE.h>
+
+#include <cstring>
+
+#if defined(PBR_F16C)
+#include <immintrin.h>
+#endif
+
+using namespace pbr;
+using namespace pbr::simd;
+
+namespace {
+    struct SRGBTables {
+        float toLinear[256];
+
+        // Linear value where the 8-bit encoding steps from i to i + 1
+        float steps[255];
+
+        SRGBTables() {
+            for (uint32 i = 0; i < 256; ++i)
+                toLinear[i] = srgbToLinear(i / 255.0f);
+
+            for (uint32 i = 0; i < 255; ++i)
+                steps[i] = srgbToLinear((i + 0.5f) / 255.0f);
+        }
+
+        uint8 encode(float v) const {
+            // Counts the steps below v
+            uint32 lo = 0, hi = 255;
+            while (lo < hi) {
+                uint32 mid = (lo + hi) >> 1;
+                if (v >= steps[mid])
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            return (uint8)lo;
+        }
+    };
+
+    const SRGBTables& srgbTables() {
+        static const SRGBTables tables;
+        return tables;
+    }
+
+    template<typename T>
+    inline T roundClamp(float v, double low, double high) {
+        double r = std::floor((double)v + 0.5);
+
+        // Written so that NaNs end up at low
+        if (!(r >= low))
+            r = low;
+        if (r > high)
+            r = high;
+
+        return (T)r;
+    }
+
+    template<typename T>
+    void decodeValues(const uint8* src, float* dst, uint64 count, float scale, float low) {
+        const T* in = (const T*)src;
+        for (uint64 i = 0; i < count; ++i)
+            dst[i] = std::max((float)in[i] * scale, low);
+    }
+
+    template<typename T>
+    void encodeValues(const float* src, uint8* dst, uint64 count, float scale, double low, double high) {
+        T* out = (T*)dst;
+        for (uint64 i = 0; i < count; ++i)
+            out[i] = roundClamp<T>(src[i] * scale, low, high);
+    }
+
+    // Vector paths for the common 8 and 16-bit unsigned formats
+    void decodeBytes(const uint8* src, float* dst, uint64 count, float scale) {
+        vfloat s = set1(scale);
+
+        uint64 i = 0;
+        for (; i + WIDTH <= count; i += WIDTH)
+            store(dst + i, mul(loadBytes(src + i), s));
+        for (; i < count; ++i)
+            dst[i] = src[i] * scale;
+    }
+
+    void decodeShorts(const uint8* src, float* dst, uint64 count, float scale) {
+        const uint16* in = (const uint16*)src;
+        vfloat s = set1(scale);
+
+        uint64 i = 0;
+        for (; i + WIDTH <= count; i += WIDTH)
+            store(dst + i, mul(loadShorts(in + i), s));
+        for (; i < count; ++i)
+            dst[i] = in[i] * scale;
+    }
+
+    void encodeBytes(const float* src, uint8* dst, uint64 count) {
+        uint64 i = 0;
+#if defined(PBR_SSE2)
+        // The conversion saturates, and NaNs end up at zero
+        for (; i + WIDTH <= count; i += WIDTH)
+            storeBytes(dst + i, mul(load(src + i), set1(255.0f)));
+#endif
+        for (; i < count; ++i)
+            dst[i] = roundClamp<uint8>(src[i] * 255.0f, 0, 255);
+    }
+
+    inline uint32 toUnorm(float v, uint32 maxValue) {
+        return roundClamp<uint32>(v * maxValue, 0, maxValue);
+    }
+
+    // Largest value of the shared exponent format, 511/512 * 2^16
+    static PBR_CONSTEXPR float RGB9E5_MAX = 65408.0f;
+
+    // GL_UNSIGNED_INT_5_9_9_9_REV, from the EXT_texture_shared_exponent
+    // reference encoder. Exponents below -16 are raised to the minimum.
+    vint packRGB9E5(vfloat r, vfloat g, vfloat b) {
+        r = clamp(r, 0.0f, RGB9E5_MAX);
+        g = clamp(g, 0.0f, RGB9E5_MAX);
+        b = clamp(b, 0.0f, RGB9E5_MAX);
+
+        vfloat maxc = max(max(max(r, g), b), set1(1.0f / 65536.0f));
+        vint   expo = andi(asInt(maxc), 0x7F800000);
+
+        // 2^(e - 8) keeps 9 bits of the largest channel
+        vfloat denom = asFloat(addi(expo, seti(-(8 << 23))));
+
+        // Rounding the largest mantissa up to 512 takes one more exponent
+        vfloat bump = greater(toFloat(toInt(div(maxc, denom))), set1(511.5f));
+        denom = select(bump, add(denom, denom), denom);
+        expo  = addi(addi(shr(expo, 23), seti(15 + 1 - 127)), andi(asInt(bump), 1));
+
+        vint rgb = addi(toInt(div(r, denom)), shl(toInt(div(g, denom)), 9));
+        return addi(addi(rgb, shl(toInt(div(b, denom)), 18)), shl(expo, 27));
+    }
+
+    void unpackRGB9E5(vint v, vfloat& r, vfloat& g, vfloat& b) {
+        vfloat scale = asFloat(shl(addi(shr(v, 27), seti(127 - 15 - 9)), 23));
+
+        r = mul(toFloat(andi(v, 0x1FF)),         scale);
+        g = mul(toFloat(andi(shr(v, 9), 0x1FF)),  scale);
+        b = mul(toFloat(andi(shr(v, 18), 0x1FF)), scale);
+    }
+
+    // Unsigned floats with a 5-bit exponent and M mantissa bits, as used by
+    // GL_UNSIGNED_INT_10F_11F_11F_REV. Values round to nearest, finite ones
+    // too large to represent are clamped, and negatives and NaNs go to zero.
+    template<int32 M>
+    vint packSmallFloat(vfloat v) {
+        vfloat isInf = greater(v, set1(FLOAT_MAXIMUM));
+        v = clamp(v, 0.0f, (float)((2 << M) - 1) * (float)(1 << (15 - M)));
+
+        // Normal values rebias the float bits, rounding half up
+        vint normal = shr(addi(asInt(v), seti(1 << (22 - M))), 23 - M);
+        normal = addi(normal, seti(-((127 - 15) << M)));
+
+        // Denormals are multiples of 2^(-14 - M)
+        vint denormal = toInt(mul(v, set1((float)(1 << (14 + M)))));
+
+        vfloat isDenormal = greater(set1(1.0f / 16384.0f), v);
+        vfloat bits = select(isDenormal, asFloat(denormal), asFloat(normal));
+
+        return asInt(select(isInf, asFloat(seti(31 << M)), bits));
+    }
+
+    template<int32 M>
+    vfloat unpackSmallFloat(vint v) {
+        vfloat denormal = mul(toFloat(v), set1(1.0f / (float)(1 << (14 + M))));
+        vfloat normal   = asFloat(addi(shl(v, 23 - M), seti((127 - 15) << 23)));
+
+        // Exponent 31 holds infinity and NaN, which take the float's
+        // largest exponent and keep the mantissa
+        vfloat isInf = greater(toFloat(v), set1((float)((31 << M) - 1)));
+        vfloat special = asFloat(addi(asInt(normal), seti((255 - 31 - 127 + 15) << 23)));
+        normal = select(isInf, special, normal);
+
+        return select(greater(set1((float)(1 << M)), toFloat(v)), denormal, normal);
+    }
+
+    vint packRG11B10F(vfloat r, vfloat g, vfloat b) {
+        vint rg = addi(packSmallFloat<6>(r), shl(packSmallFloat<6>(g), 11));
+        return addi(rg, shl(packSmallFloat<5>(b), 22));
+    }
+
+    void unpackRG11B10F(vint v, vfloat& r, vfloat& g, vfloat& b) {
+        r = unpackSmallFloat<6>(andi(v, 0x7FF));
+        g = unpackSmallFloat<6>(andi(shr(v, 11), 0x7FF));
+        b = unpackSmallFloat<5>(shr(v, 22));
+    }
+
+    // Runs a packing kernel over interleaved RGB pixels, WIDTH at a time.
+    // The last group is padded with zeros.
+    template<typename Pack>
+    void packPixels(const float* src, uint32* dst, uint32 numPixels, Pack pack) {
+        float  r[WIDTH], g[WIDTH], b[WIDTH];
+        uint32 bits[WIDTH];
+
+        for (uint32 p = 0; p < numPixels; p += WIDTH) {
+            uint32 n = std::min(WIDTH, numPixels - p);
+            for (uint32 i = 0; i < WIDTH; ++i) {
+                const float* px = src + (p + std::min(i, n - 1)) * 3;
+                r[i] = px[0];
+                g[i] = px[1];
+                b[i] = px[2];
+            }
+
+            storei(bits, pack(load(r), load(g), load(b)));
+            memcpy(dst + p, bits, n * sizeof(uint32));
+        }
+    }
+
+    template<typename Unpack>
+    void unpackPixels(const uint32* src, float* dst, uint32 numPixels, Unpack unpack) {
+        float  r[WIDTH], g[WIDTH], b[WIDTH];
+        uint32 bits[WIDTH] = { };
+
+        for (uint32 p = 0; p < numPixels; p += WIDTH) {
+            uint32 n = std::min(WIDTH, numPixels - p);
+            memcpy(bits, src + p, n * sizeof(uint32));
+
+            vfloat vr, vg, vb;
+            unpack(loadi(bits), vr, vg, vb);
+            store(r, vr);
+            store(g, vg);
+            store(b, vb);
+
+            for (uint32 i = 0; i < n; ++i) {
+                float* px = dst + (p + i) * 3;
+                px[0] = r[i];
+                px[1] = g[i];
+                px[2] = b[i];
+            }
+        }
+    }
+
+    // Bit layouts match the GL packed types, so pixels upload unchanged
+    void decodePacked(ImageFormat format, const uint8* src, float* dst, uint32 numPixels) {
+        switch (format) {
+            case IMGFMT_RGBE8:
+                rgbeToFloat(src, dst, numPixels);
+                break;
+            case IMGFMT_RGB9E5:
+                unpackPixels((const uint32*)src, dst, numPixels, unpackRGB9E5);
+                break;
+            case IMGFMT_RG11B10F:
+                unpackPixels((const uint32*)src, dst, numPixels, unpackRG11B10F);
+                break;
+            case IMGFMT_RGB565: {
+                // GL_UNSIGNED_SHORT_5_6_5
+                const uint16* in = (const uint16*)src;
+                for (uint32 p = 0; p < numPixels; ++p, dst += 3) {
+                    dst[0] = (in[p] >> 11)         / 31.0f;
+                    dst[1] = ((in[p] >> 5) & 0x3F) / 63.0f;
+                    dst[2] = (in[p] & 0x1F)        / 31.0f;
+                }
+                break;
+            }
+            case IMGFMT_RGBA4: {
+                // GL_UNSIGNED_SHORT_4_4_4_4
+                const uint16* in = (const uint16*)src;
+                for (uint32 p = 0; p < numPixels; ++p, dst += 4) {
+                    dst[0] = (in[p] >> 12)        / 15.0f;
+                    dst[1] = ((in[p] >> 8) & 0xF) / 15.0f;
+                    dst[2] = ((in[p] >> 4) & 0xF) / 15.0f;
+                    dst[3] = (in[p] & 0xF)        / 15.0f;
+                }
+                break;
+            }
+            case IMGFMT_RGB10A2: {
+                // GL_UNSIGNED_INT_2_10_10_10_REV
+                const uint32* in = (const uint32*)src;
+                for (uint32 p = 0; p < numPixels; ++p, dst += 4) {
+                    dst[0] = (in[p] & 0x3FF)         / 1023.0f;
+                    dst[1] = ((in[p] >> 10) & 0x3FF) / 1023.0f;
+                    dst[2] = ((in[p] >> 20) & 0x3FF) / 1023.0f;
+                    dst[3] = (in[p] >> 30)           / 3.0f;
+                }
+                break;
+            }
+            default:
+                // Error
+                break;
+        }
+    }
+
+    void encodePacked(ImageFormat format, const float* src, uint8* dst, uint32 numPixels) {
+        switch (format) {
+            case IMGFMT_RGBE8:
+                floatToRGBE(src, dst, numPixels);
+                break;
+            case IMGFMT_RGB9E5:
+                packPixels(src, (uint32*)dst, numPixels, packRGB9E5);
+                break;
+            case IMGFMT_RG11B10F:
+                packPixels(src, (uint32*)dst, numPixels, packRG11B10F);
+                break;
+            case IMGFMT_RGB565: {
+                uint16* out = (uint16*)dst;
+                for (uint32 p = 0; p < numPixels; ++p, src += 3)
+                    out[p] = (uint16)((toUnorm(src[0], 31) << 11) | (toUnorm(src[1], 63) << 5) | toUnorm(src[2], 31));
+                break;
+            }
+            case IMGFMT_RGBA4: {
+                uint16* out = (uint16*)dst;
+                for (uint32 p = 0; p < numPixels; ++p, src += 4)
+                    out[p] = (uint16)((toUnorm(src[0], 15) << 12) | (toUnorm(src[1], 15) << 8) |
+                                      (toUnorm(src[2], 15) << 4)  |  toUnorm(src[3], 15));
+                break;
+            }
+            case IMGFMT_RGB10A2: {
+                uint32* out = (uint32*)dst;
+                for (uint32 p = 0; p < numPixels; ++p, src += 4)
+                    out[p] = toUnorm(src[0], 1023) | (toUnorm(src[1], 1023) << 10) |
+                             (toUnorm(src[2], 1023) << 20) | (toUnorm(src[3], 3) << 30);
+                break;
+            }
+            default:
+                // Error
+                break;
+        }
+    }
+}
+
+float pbr::halfToFloat(uint16 h) {
+    uint32 sign = (uint32)(h & 0x8000) << 16;
+    uint32 exp  = (h >> 10) & 0x1F;
+    uint32 mant = h & 0x3FF;
+
+    uint32 bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // Subnormal, renormalize it
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+
+            bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+        }
+    } else if (exp == 31) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+
+    return f;
+}
+
+uint16 pbr::floatToHalf(float f) {
+    uint32 bits;
+    memcpy(&bits, &f, sizeof(float));
+
+    uint32 sign = (bits >> 16) & 0x8000;
+    uint32 abs  = bits & 0x7FFFFFFF;
+
+    // Infinity and NaN
+    if (abs >= 0x7F800000)
+        return (uint16)(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0));
+
+    // Rounds to infinity from 65520 onwards
+    if (abs >= 0x477FF000)
+        return (uint16)(sign | 0x7C00);
+
+    // Below the smallest normal half
+    if (abs < 0x38800000) {
+        if (abs < 0x33000000)
+            return (uint16)sign;
+
+        uint32 exp   = abs >> 23;
+        uint32 mant  = (abs & 0x7FFFFF) | 0x800000;
+        uint32 shift = 126 - exp;
+
+        uint32 h    = mant >> shift;
+        uint32 rem  = mant & ((1u << shift) - 1);
+        uint32 half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+            h++;
+
+        return (uint16)(sign | h);
+    }
+
+    // Rebias the exponent, a carry from rounding moves into it
+    uint32 h   = (abs - ((127 - 15) << 23)) >> 13;
+    uint32 rem = abs & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++;
+
+    return (uint16)(sign | h);
+}
+
+float pbr::srgbToLinear(float c) {
+    if (c <= 0.04045f)
+        return c / 12.92f;
+
+    return std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float pbr::linearToSRGB(float c) {
+    if (c <= 0.0031308f)
+        return c * 12.92f;
+
+    return 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+bool pbr::isNormalized(ImageFormat format) {
+    return format >= IMGFMT_R8 && format <= IMGFMT_RGBA16S;
+}
+
+bool pbr::isRowConvertible(ImageFormat format) {
+    // Plain formats, and the packed ones with a known channel layout
+    return format < IMGFMT_D16 && formatToNumChannels(format) > 0;
+}
+
+void pbr::decodeRow(ImageFormat format, const uint8* src, float* dst, uint32 numPixels, bool sRGB) {
+    if (format >= IMGFMT_RGBE8) {
+        decodePacked(format, src, dst, numPixels);
+        return;
+    }
+
+    uint32 nChan = formatToNumChannels(format);
+    uint64 count = (uint64)numPixels * nChan;
+    bool   norm  = isNormalized(format);
+
+    switch (formatToImgComp(format)) {
+        case UBYTE:
+            if (sRGB && nChan >= 3) {
+                const SRGBTables& tables = srgbTables();
+                for (uint64 i = 0; i < count; i += nChan) {
+                    dst[i + 0] = tables.toLinear[src[i + 0]];
+                    dst[i + 1] = tables.toLinear[src[i + 1]];
+                    dst[i + 2] = tables.toLinear[src[i + 2]];
+
+                    // Alpha is always linear
+                    if (nChan == 4)
+                        dst[i + 3] = src[i + 3] / 255.0f;
+                }
+            } else {
+                decodeBytes(src, dst, count, 1.0f / 255.0f);
+            }
+            break;
+        case BYTE:
+            decodeValues<int8>(src, dst, count, norm ? 1.0f / 127.0f : 1.0f, norm ? -1.0f : FLOAT_LOWEST);
+            break;
+        case USHORT:
+            decodeShorts(src, dst, count, norm ? 1.0f / 65535.0f : 1.0f);
+            break;
+        case SHORT:
+            decodeValues<int16>(src, dst, count, norm ? 1.0f / 32767.0f : 1.0f, norm ? -1.0f : FLOAT_LOWEST);
+            break;
+        case UINT:
+            decodeValues<uint32>(src, dst, count, 1.0f, 0.0f);
+            break;
+        case INT:
+            decodeValues<int32>(src, dst, count, 1.0f, FLOAT_LOWEST);
+            break;
+        case HALF: {
+            const uint16* in = (const uint16*)src;
+
+            uint64 i = 0;
+#if defined(PBR_F16C)
+            for (; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + i))));
+#endif
+            for (; i < count; ++i)
+                dst[i] = halfToFloat(in[i]);
+            break;
+        }
+        case FLOAT:
+            memcpy(dst, src, (size_t)count * sizeof(float));
+            break;
+        default:
+            // Error
+            break;
+    }
+}
+
+void pbr::encodeRow(ImageFormat format, const float* src, uint8* dst, uint32 numPixels, bool sRGB) {
+    if (format >= IMGFMT_RGBE8) {
+        encodePacked(format, src, dst, numPixels);
+        return;
+    }
+
+    uint32 nChan = formatToNumChannels(format);
+    uint64 count = (uint64)numPixels * nChan;
+    bool   norm  = isNormalized(format);
+
+    switch (formatToImgComp(format)) {
+        case UBYTE:
+            if (sRGB && nChan >= 3) {
+                const SRGBTables& tables = srgbTables();
+                for (uint64 i = 0; i < count; i += nChan) {
+                    dst[i + 0] = tables.encode(src[i + 0]);
+                    dst[i + 1] = tables.encode(src[i + 1]);
+                    dst[i + 2] = tables.encode(src[i + 2]);
+
+                    if (nChan == 4)
+                        dst[i + 3] = roundClamp<uint8>(src[i + 3] * 255.0f, 0, 255);
+                }
+            } else {
+                encodeBytes(src, dst, count);
+            }
+            break;
+        case BYTE:
+            encodeValues<int8>(src, dst, count, norm ? 127.0f : 1.0f, norm ? -127 : -128, 127);
+            break;
+        case USHORT:
+            encodeValues<uint16>(src, dst, count, norm ? 65535.0f : 1.0f, 0, 65535);
+            break;
+        case SHORT:
+            encodeValues<int16>(src, dst, count, norm ? 32767.0f : 1.0f, norm ? -32767 : -32768, 32767);
+            break;
+        case UINT:
+            encodeValues<uint32>(src, dst, count, 1.0f, 0, 4294967295.0);
+            break;
+        case INT:
+            encodeValues<int32>(src, dst, count, 1.0f, -2147483648.0, 2147483647.0);
+            break;
+        case HALF: {
+            uint16* out = (uint16*)dst;
+
+            uint64 i = 0;
+#if defined(PBR_F16C)
+            for (; i + 8 <= count; i += 8)
+                _mm_storeu_si128((__m128i*)(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+            for (; i < count; ++i)
+                out[i] = floatToHalf(src[i]);
+            break;
+        }
+        case FLOAT:
+            memcpy(dst, src, (size_t)count * sizeof(float));
+            break;
+        default:
+            // Error
+            break;
+    }
+}
+
+void pbr::remapChannels(const float* src, uint32 srcChan, float* dst, uint32 dstChan, uint32 numPixels) {
+    // Gray sources fill all of RGB
+    bool gray = srcChan == 1 && dstChan >= 3;
+
+    for (uint32 p = 0; p < numPixels; ++p, src += srcChan, dst += dstChan) {
+        for (uint32 c = 0; c < dstChan; ++c) {
+            if (c < srcChan)
+                dst[c] = src[c];
+            else if (gray && c < 3)
+                dst[c] = src[0];
+            else
+                dst[c] = (c == 3) ? 1.0f : 0.0f;
+        }
+    }
+}
+
+void pbr::convertRow(ImageFormat srcFormat, const uint8* src, ImageFormat dstFormat, uint8* dst,
+                     uint32 numPixels, bool sRGB) {
+    static PBR_CONSTEXPR uint32 BATCH_SIZE = 256;
+
+    uint32 srcBpp = formatToBytesPerPixel(srcFormat);
+    uint32 dstBpp = formatToBytesPerPixel(dstFormat);
+
+    if (srcFormat == dstFormat) {
+        memmove(dst, src, (size_t)numPixels * srcBpp);
+        return;
+    }
+
+    uint32 srcChan = formatToNumChannels(srcFormat);
+    uint32 dstChan = formatToNumChannels(dstFormat);
+
+    // Every batch is decoded before it is written, so converting in place
+    // to smaller pixels never overwrites pixels that were not read yet
+    float values[BATCH_SIZE * 4];
+    float remapped[BATCH_SIZE * 4];
+
+    for (uint32 p = 0; p < numPixels; p += BATCH_SIZE) {
+        uint32 count = std::min(BATCH_SIZE, numPixels - p);
+
+        const float* row = values;
+        decodeRow(srcFormat, src + (uint64)p * srcBpp, values, count, sRGB);
+
+        if (srcChan != dstChan) {
+            remapChannels(values, srcChan, remapped, dstChan, count);
+            row = remapped;
+        }
+
+        encodeRow(dstFormat, row, dst + (uint64)p * dstBpp, count, sRGB);
+    }
+}
+
+void pbr::rgbToYCbCr(const uint8* src, uint32 nChan, uint8* y, uint8* cb, uint8* cr, uint32 numPixels) {
+    // BT.709 weights scaled to the 219 and 224 levels of limited range,
+    // in 16-bit fixed point
+    static PBR_CONSTEXPR int32 YR  =  11966, YG =  40254, YB =   4064;
+    static PBR_CONSTEXPR int32 CBR =  -6596, CBG = -22189, CBB = 28784;
+    static PBR_CONSTEXPR int32 CRR =  28784, CRG = -26145, CRB = -2639;
+
+    for (uint32 p = 0; p < numPixels; ++p) {
+        int32 r = src[0], g = src[1], b = src[2];
+        src += nChan;
+
+        y[p]  = (uint8)(((YR  * r + YG  * g + YB  * b + 32768) >> 16) + 16);
+        cb[p] = (uint8)(((CBR * r + CBG * g + CBB * b + 32768) >> 16) + 128);
+        cr[p] = (uint8)(((CRR * r + CRG * g + CRB * b + 32768) >> 16) + 128);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef __PBR_PIXELOPS_H__
+#define __PBR_PIXELOPS_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // IEEE 754 half precision conversions, rounding to nearest even
+    float  halfToFloat(uint16 h);
+    uint16 floatToHalf(float f);
+
+    // sRGB transfer functions on [0, 1]
+    float srgbToLinear(float c);
+    float linearToSRGB(float c);
+
+    bool isNormalized(ImageFormat format);
+
+    // Formats that decodeRow and encodeRow handle, all but the depth
+    // and compressed ones
+    bool isRowConvertible(ImageFormat format);
+
+    // Converts numPixels pixels of format into floats, one per channel.
+    // Normalized formats map to [0, 1] or [-1, 1], integer formats keep
+    // their values. With sRGB, the color channels of RGB8 and RGBA8 are
+    // converted to linear.
+    void decodeRow(ImageFormat format, const uint8* src, float* dst, uint32 numPixels, bool sRGB = false);
+
+    // Inverse of decodeRow, rounds and clamps values to the format range
+    void encodeRow(ImageFormat format, const float* src, uint8* dst, uint32 numPixels, bool sRGB = false);
+
+    // Copies float pixels between channel counts. Missing channels are 0,
+    // alpha is 1, and a single channel source is replicated to RGB.
+    void remapChannels(const float* src, uint32 srcChan, float* dst, uint32 dstChan, uint32 numPixels);
+
+    // Converts numPixels pixels between two row convertible formats, in
+    // small batches through float. src and dst may be the same buffer if
+    // the destination pixels are not larger than the source ones.
+    void convertRow(ImageFormat srcFormat, const uint8* src, ImageFormat dstFormat, uint8* dst,
+                    uint32 numPixels, bool sRGB = false);
+
+    // Converts numPixels pixels of RGB8 or RGBA8 to limited range BT.709
+    // Y'CbCr, written to separate planes. Values are not linearized, as
+    // video expects gamma encoded components.
+    void rgbToYCbCr(const uint8* src, uint32 nChan, uint8* y, uint8* cb, uint8* cr, uint32 numPixels);
+
+}
+
+#endif
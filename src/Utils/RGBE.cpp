@@ -0,0 +1,378 @@
+#include <RGBE.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <PixelOps.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <atomic>
+
+using namespace pbr;
+
+namespace {
+    // Widths that new style RLE scanlines can hold
+    static PBR_CONSTEXPR uint32 RLE_MIN_WIDTH = 8;
+    static PBR_CONSTEXPR uint32 RLE_MAX_WIDTH = 0x7FFF;
+
+    struct RGBETables {
+        float scale[256];
+
+        RGBETables() {
+            // Mantissas are taken at the center of their interval
+            scale[0] = 0.0f;
+            for (int32 e = 1; e < 256; ++e)
+                scale[e] = std::ldexp(1.0f, e - (128 + 8));
+        }
+    };
+
+    const RGBETables& rgbeTables() {
+        static const RGBETables tables;
+        return tables;
+    }
+
+    bool readLine(const uint8* data, uint64 size, uint64& pos, std::string& line) {
+        line.clear();
+        while (pos < size) {
+            char c = (char)data[pos++];
+            if (c == '\n')
+                return true;
+
+            line += c;
+        }
+
+        return false;
+    }
+
+    bool hasRLEMarker(const uint8* data, uint64 size, uint64 pos, uint32 width) {
+        if (width < RLE_MIN_WIDTH || width > RLE_MAX_WIDTH || pos + 4 > size)
+            return false;
+
+        return data[pos] == 2 && data[pos + 1] == 2 &&
+               ((data[pos + 2] << 8) | data[pos + 3]) == (int32)width;
+    }
+
+    // Walks the runs of an RLE scanline without decoding it.
+    // Returns the position of the next scanline, or 0 if it is malformed.
+    uint64 skipRLE(const uint8* data, uint64 size, uint64 pos, uint32 width) {
+        pos += 4;
+
+        for (uint32 c = 0; c < 4; ++c) {
+            uint32 x = 0;
+            while (x < width) {
+                if (pos >= size)
+                    return 0;
+
+                uint32 count = data[pos++];
+                if (count > 128) {
+                    count -= 128;
+                    pos   += 1;
+                } else {
+                    pos += count;
+                }
+
+                x += count;
+                if (count == 0 || x > width)
+                    return 0;
+            }
+        }
+
+        return (pos <= size) ? pos : 0;
+    }
+
+    // Decodes the scanline at pos, which must have been checked by skipRLE
+    void decodeRLE(const uint8* data, uint64 pos, uint32 width, uint8* rgbe) {
+        pos += 4;
+
+        for (uint32 c = 0; c < 4; ++c) {
+            uint32 x = 0;
+            while (x < width) {
+                uint32 count = data[pos++];
+                if (count > 128) {
+                    count -= 128;
+
+                    uint8 val = data[pos++];
+                    for (uint32 i = 0; i < count; ++i)
+                        rgbe[(x + i) * 4 + c] = val;
+                } else {
+                    for (uint32 i = 0; i < count; ++i)
+                        rgbe[(x + i) * 4 + c] = data[pos++];
+                }
+
+                x += count;
+            }
+        }
+    }
+
+    // Flat scanline, with the old style runs of repeated pixels
+    bool decodeFlat(const uint8* data, uint64 size, uint64& pos, uint32 width, uint8* rgbe) {
+        uint32 shift = 0;
+        uint32 x = 0;
+
+        while (x < width) {
+            if (pos + 4 > size)
+                return false;
+
+            const uint8* px = data + pos;
+            pos += 4;
+
+            if (px[0] == 1 && px[1] == 1 && px[2] == 1) {
+                uint32 count = (uint32)px[3] << shift;
+                if (x == 0 || x + count > width)
+                    return false;
+
+                for (uint32 i = 0; i < count; ++i, ++x)
+                    memcpy(rgbe + x * 4, rgbe + (x - 1) * 4, 4);
+
+                shift += 8;
+            } else {
+                memcpy(rgbe + x * 4, px, 4);
+                x++;
+
+                shift = 0;
+            }
+        }
+
+        return true;
+    }
+
+    // Appends one byte plane with the run length encoding of Radiance
+    void encodeRLE(const uint8* plane, uint32 width, uint32 stride, std::vector<uint8>& out) {
+        static PBR_CONSTEXPR uint32 MIN_RUN = 4;
+
+        uint32 cur = 0;
+        while (cur < width) {
+            uint32 begRun   = cur;
+            uint32 runCount = 0;
+            uint32 oldCount = 0;
+
+            // Find the next run of at least MIN_RUN bytes
+            while (runCount < MIN_RUN && begRun < width) {
+                begRun  += runCount;
+                oldCount = runCount;
+                runCount = 1;
+
+                while (begRun + runCount < width && runCount < 127 &&
+                       plane[begRun * stride] == plane[(begRun + runCount) * stride])
+                    runCount++;
+            }
+
+            // Short run right before it
+            if (oldCount > 1 && oldCount == begRun - cur) {
+                out.push_back((uint8)(128 + oldCount));
+                out.push_back(plane[cur * stride]);
+                cur = begRun;
+            }
+
+            // Literal bytes up to the run
+            while (cur < begRun) {
+                uint32 count = std::min(begRun - cur, 128u);
+
+                out.push_back((uint8)count);
+                for (uint32 i = 0; i < count; ++i)
+                    out.push_back(plane[(cur + i) * stride]);
+
+                cur += count;
+            }
+
+            if (runCount >= MIN_RUN) {
+                out.push_back((uint8)(128 + runCount));
+                out.push_back(plane[begRun * stride]);
+                cur += runCount;
+            }
+        }
+    }
+}
+
+void pbr::rgbeToFloat(const uint8* rgbe, float* rgb, uint32 numPixels) {
+    const float* scale = rgbeTables().scale;
+
+    for (uint32 p = 0; p < numPixels; ++p) {
+        const uint8* px = rgbe + p * 4;
+        float s = scale[px[3]];
+
+        rgb[p * 3 + 0] = (px[0] + 0.5f) * s;
+        rgb[p * 3 + 1] = (px[1] + 0.5f) * s;
+        rgb[p * 3 + 2] = (px[2] + 0.5f) * s;
+    }
+}
+
+void pbr::floatToRGBE(const float* src, uint8* rgbe, uint32 numPixels, uint32 nChan) {
+    for (uint32 p = 0; p < numPixels; ++p) {
+        const float* px = src + p * nChan;
+        uint8* out = rgbe + p * 4;
+
+        // Negative values are not representable, NaNs end up at zero
+        float r = std::min(std::max(px[0], 0.0f), 1e38f);
+        float g = std::min(std::max(px[1], 0.0f), 1e38f);
+        float b = std::min(std::max(px[2], 0.0f), 1e38f);
+
+        float v = std::max(std::max(r, g), b);
+        if (v < 1e-32f) {
+            memset(out, 0, 4);
+            continue;
+        }
+
+        int32 e;
+        float m = std::frexp(v, &e) * 256.0f / v;
+
+        out[0] = (uint8)std::min(r * m, 255.0f);
+        out[1] = (uint8)std::min(g * m, 255.0f);
+        out[2] = (uint8)std::min(b * m, 255.0f);
+        out[3] = (uint8)(e + 128);
+    }
+}
+
+bool pbr::loadRGBE(const std::string& filePath, Image& image, ImageFormat format) {
+    if (format != IMGFMT_RGB32F && format != IMGFMT_RGBE8)
+        return false;
+
+    MappedFile file;
+    if (!file.open(filePath))
+        return false;
+
+    const uint8* data = file.data();
+    uint64 size = file.size();
+    uint64 pos  = 0;
+
+    // Header, up to an empty line
+    std::string line;
+    if (!readLine(data, size, pos, line) || line.compare(0, 2, "#?") != 0)
+        return false;
+
+    while (readLine(data, size, pos, line) && !line.empty()) {
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+            return false; // XYZE is not supported
+    }
+
+    // Resolution string, rows may be stored bottom up
+    char yAxis[3], xAxis[3];
+    int32 height, width;
+    if (!readLine(data, size, pos, line) ||
+        sscanf(line.c_str(), "%2s %d %2s %d", yAxis, &height, xAxis, &width) != 4)
+        return false;
+
+    bool bottomUp = strcmp(yAxis, "+Y") == 0;
+    if ((!bottomUp && strcmp(yAxis, "-Y") != 0) || strcmp(xAxis, "+X") != 0 ||
+        width <= 0 || height <= 0)
+        return false;
+
+    image.init(format, width, height, 1);
+
+    // Scanline starts are found ahead, so they can be decoded in parallel
+    std::vector<uint64> starts(height);
+    bool isRLE = true;
+    for (int32 y = 0; y < height && isRLE; ++y) {
+        starts[y] = pos;
+
+        isRLE = hasRLEMarker(data, size, pos, width);
+        if (isRLE)
+            isRLE = (pos = skipRLE(data, size, pos, width)) != 0;
+    }
+
+    uint64 rowSize = image.size(0) / height;
+    auto row = [&](int32 y) {
+        return image.data(0) + (bottomUp ? height - 1 - y : y) * rowSize;
+    };
+
+    if (isRLE) {
+        Workers.parallelRange(height, 16, [&](uint32 begin, uint32 end) {
+            std::vector<uint8> rgbe((size_t)width * 4);
+
+            for (uint32 y = begin; y < end; ++y) {
+                if (format == IMGFMT_RGBE8) {
+                    decodeRLE(data, starts[y], width, row(y));
+                } else {
+                    decodeRLE(data, starts[y], width, &rgbe[0]);
+                    rgbeToFloat(&rgbe[0], (float*)row(y), width);
+                }
+            }
+        });
+
+        return true;
+    }
+
+    // Flat or mixed files have to be read in order
+    pos = starts[0];
+
+    std::vector<uint8> rgbe((size_t)width * 4);
+    for (int32 y = 0; y < height; ++y) {
+        if (hasRLEMarker(data, size, pos, width)) {
+            uint64 next = skipRLE(data, size, pos, width);
+            if (next == 0)
+                return false;
+
+            decodeRLE(data, pos, width, &rgbe[0]);
+            pos = next;
+        } else if (!decodeFlat(data, size, pos, width, &rgbe[0])) {
+            return false;
+        }
+
+        if (format == IMGFMT_RGBE8)
+            memcpy(row(y), &rgbe[0], rgbe.size());
+        else
+            rgbeToFloat(&rgbe[0], (float*)row(y), width);
+    }
+
+    return true;
+}
+
+bool pbr::saveRGBE(const std::string& filePath, const Image& image, uint32 lvl) {
+    ImageFormat format = image.format();
+    uint32 nChan = image.numChannels();
+
+    if (lvl >= image.numLevels() || image.depth() > 1)
+        return false;
+
+    if (format != IMGFMT_RGBE8 && (!isRowConvertible(format) || nChan < 3))
+        return false;
+
+    uint32 width  = mipDimension(image.width(),  lvl);
+    uint32 height = mipDimension(image.height(), lvl);
+    uint64 rowSize = image.size(lvl) / height;
+    bool   useRLE  = width >= RLE_MIN_WIDTH && width <= RLE_MAX_WIDTH;
+
+    // Encode scanlines in parallel, then write them in order
+    std::vector<std::vector<uint8>> lines(height);
+    Workers.parallelRange(height, 16, [&](uint32 begin, uint32 end) {
+        std::vector<float> values((size_t)width * nChan);
+        std::vector<uint8> rgbe((size_t)width * 4);
+
+        for (uint32 y = begin; y < end; ++y) {
+            const uint8* src = image.data(lvl) + y * rowSize;
+            if (format == IMGFMT_RGBE8) {
+                memcpy(&rgbe[0], src, rgbe.size());
+            } else {
+                decodeRow(format, src, &values[0], width);
+                floatToRGBE(&values[0], &rgbe[0], width, nChan);
+            }
+
+            std::vector<uint8>& out = lines[y];
+            if (!useRLE) {
+                out = rgbe;
+                continue;
+            }
+
+            out.reserve(rgbe.size() + 4);
+            out.push_back(2);
+            out.push_back(2);
+            out.push_back((uint8)(width >> 8));
+            out.push_back((uint8)(width & 0xFF));
+
+            for (uint32 c = 0; c < 4; ++c)
+                encodeRLE(&rgbe[c], width, 4, out);
+        }
+    });
+
+    std::ofstream file(filePath, std::ios::out | std::ios::binary);
+    file << "#?RADIANCE\n";
+    file << "FORMAT=32-bit_rle_rgbe\n\n";
+    file << "-Y " << height << " +X " << width << "\n";
+
+    for (uint32 y = 0; y < height; ++y)
+        file.write((const char*)&lines[y][0], lines[y].size());
+
+    file.close();
+
+    return !file.fail();
+}
@@ -0,0 +1,22 @@
+#ifndef __PBR_RGBE_H__
+#define __PBR_RGBE_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // Radiance .hdr images. Pixels are decoded to IMGFMT_RGB32F, or kept
+    // as IMGFMT_RGBE8 at a quarter of the memory.
+    bool loadRGBE(const std::string& filePath, Image& image, ImageFormat format = IMGFMT_RGB32F);
+
+    // Writes one level with RLE scanlines, from RGBE8 or any row
+    // convertible format with at least 3 channels
+    bool saveRGBE(const std::string& filePath, const Image& image, uint32 lvl = 0);
+
+    void rgbeToFloat(const uint8* rgbe, float* rgb, uint32 numPixels);
+    void floatToRGBE(const float* src, uint8* rgbe, uint32 numPixels, uint32 nChan = 3);
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+#include <Resample.h>
+#include <ThreadPool.h>
+
+#if defined(PBR_AVX2)
+#include <immintrin.h>
+#elif defined(PBR_SSE2)
+#include <emmintrin.h>
+#endif
+
+using namespace pbr;
+
+namespace {
+    // Source taps of one destination pixel, along one axis
+    struct Contrib {
+        uint32 first;
+        uint32 count;
+        uint32 weights; // Index of the first weight
+    };
+
+    struct FilterTable {
+        std::vector<Contrib> contribs;
+        std::vector<float>   weights;
+    };
+
+    // Roughly the number of floats each task gets to filter
+    static PBR_CONSTEXPR uint32 ROWS_TASK_SIZE = 16384;
+
+    float sinc(float x) {
+        if (std::abs(x) < 1e-6f)
+            return 1.0f;
+
+        x *= math::PI;
+        return std::sin(x) / x;
+    }
+
+    // Zeroth order modified Bessel function of the first kind
+    float bessel0(float x) {
+        float sum  = 1.0f;
+        float term = 1.0f;
+        float x2   = x * x / 4.0f;
+
+        for (uint32 k = 1; k < 32; ++k) {
+            term *= x2 / (float)(k * k);
+            sum  += term;
+
+            if (term < sum * 1e-8f)
+                break;
+        }
+
+        return sum;
+    }
+
+    void buildTable(MipFilter filter, uint32 srcSize, uint32 dstSize, FilterTable& table) {
+        float ratio  = (float)srcSize / dstSize;
+        float scale  = std::max(ratio, 1.0f);
+        float radius = filterRadius(filter) * scale;
+
+        int32 last = (int32)srcSize - 1;
+
+        table.contribs.resize(dstSize);
+        table.weights.clear();
+
+        for (uint32 x = 0; x < dstSize; ++x) {
+            float center = (x + 0.5f) * ratio;
+
+            int32 lo = (int32)std::floor(center - radius);
+            int32 hi = (int32)std::ceil(center + radius);
+
+            Contrib& contrib = table.contribs[x];
+            contrib.first   = math::clamp(lo, 0, last);
+            contrib.count   = math::clamp(hi, 0, last) - contrib.first + 1;
+            contrib.weights = (uint32)table.weights.size();
+
+            table.weights.resize(table.weights.size() + contrib.count, 0.0f);
+            float* w = &table.weights[contrib.weights];
+
+            // Taps beyond the borders fold into the edge pixels
+            float sum = 0.0f;
+            for (int32 i = lo; i <= hi; ++i) {
+                float weight = filterWeight(filter, (i + 0.5f - center) / scale);
+
+                w[math::clamp(i, 0, last) - contrib.first] += weight;
+                sum += weight;
+            }
+
+            if (sum != 0.0f) {
+                for (uint32 k = 0; k < contrib.count; ++k)
+                    w[k] /= sum;
+            }
+        }
+    }
+
+    // dst[i] += weight * src[i]
+    void accumulateRow(float* dst, const float* src, float weight, uint32 count) {
+        uint32 i = 0;
+
+#if defined(PBR_AVX2)
+        __m256 w8 = _mm256_set1_ps(weight);
+        for (; i + 8 <= count; i += 8) {
+            __m256 d = _mm256_loadu_ps(dst + i);
+            __m256 s = _mm256_loadu_ps(src + i);
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(w8, s)));
+        }
+#elif defined(PBR_SSE2)
+        __m128 w4 = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4) {
+            __m128 d = _mm_loadu_ps(dst + i);
+            __m128 s = _mm_loadu_ps(src + i);
+            _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(w4, s)));
+        }
+#endif
+
+        for (; i < count; ++i)
+            dst[i] += weight * src[i];
+    }
+
+    void filterRow(const FilterTable& table, uint32 nChan, const float* src, float* dst) {
+        uint32 width = (uint32)table.contribs.size();
+
+#if defined(PBR_SSE2) || defined(PBR_AVX2)
+        // One pixel per register
+        if (nChan == 4) {
+            for (uint32 x = 0; x < width; ++x) {
+                const Contrib& contrib = table.contribs[x];
+                const float* w = &table.weights[contrib.weights];
+                const float* s = src + contrib.first * 4;
+
+                __m128 acc = _mm_setzero_ps();
+                for (uint32 k = 0; k < contrib.count; ++k)
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+
+                _mm_storeu_ps(dst + x * 4, acc);
+            }
+
+            return;
+        }
+#endif
+
+        for (uint32 x = 0; x < width; ++x) {
+            const Contrib& contrib = table.contribs[x];
+            const float* w = &table.weights[contrib.weights];
+            const float* s = src + contrib.first * nChan;
+
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (uint32 k = 0; k < contrib.count; ++k) {
+                for (uint32 c = 0; c < nChan; ++c)
+                    acc[c] += w[k] * s[k * nChan + c];
+            }
+
+            for (uint32 c = 0; c < nChan; ++c)
+                dst[x * nChan + c] = acc[c];
+        }
+    }
+}
+
+float pbr::filterRadius(MipFilter filter) {
+    switch (filter) {
+        case MIPFILTER_KAISER:
+        case MIPFILTER_LANCZOS:
+            return 3.0f;
+        default:
+            return 0.5f;
+    }
+}
+
+float pbr::filterWeight(MipFilter filter, float x) {
+    x = std::abs(x);
+
+    switch (filter) {
+        case MIPFILTER_KAISER: {
+            static PBR_CONSTEXPR float width = 3.0f;
+            static PBR_CONSTEXPR float alpha = 4.0f;
+
+            if (x >= width)
+                return 0.0f;
+
+            float t = x / width;
+            return sinc(x) * bessel0(alpha * std::sqrt(1.0f - t * t)) / bessel0(alpha);
+        }
+        case MIPFILTER_LANCZOS:
+            if (x >= 3.0f)
+                return 0.0f;
+
+            return sinc(x) * sinc(x / 3.0f);
+        default:
+            if (x < 0.5f)
+                return 1.0f;
+
+            return (x == 0.5f) ? 0.5f : 0.0f;
+    }
+}
+
+void pbr::resample(MipFilter filter, uint32 nChan,
+                   const float* src, uint32 srcWidth, uint32 srcHeight,
+                   float* dst, uint32 dstWidth, uint32 dstHeight) {
+    FilterTable tableX, tableY;
+    buildTable(filter, srcWidth,  dstWidth,  tableX);
+    buildTable(filter, srcHeight, dstHeight, tableY);
+
+    uint32 srcRow = srcWidth * nChan;
+    uint32 dstRow = dstWidth * nChan;
+
+    // Horizontal pass, into srcHeight rows of the destination width
+    std::vector<float> tmp((size_t)dstRow * srcHeight);
+    Workers.parallelRange(srcHeight, ROWS_TASK_SIZE / srcRow, [&](uint32 begin, uint32 end) {
+        for (uint32 y = begin; y < end; ++y)
+            filterRow(tableX, nChan, src + (uint64)y * srcRow, &tmp[(uint64)y * dstRow]);
+    });
+
+    // Vertical pass, a weighted sum of whole rows
+    Workers.parallelRange(dstHeight, ROWS_TASK_SIZE / dstRow, [&](uint32 begin, uint32 end) {
+        for (uint32 y = begin; y < end; ++y) {
+            const Contrib& contrib = tableY.contribs[y];
+            const float* w = &tableY.weights[contrib.weights];
+
+            float* out = dst + (uint64)y * dstRow;
+            std::fill(out, out + dstRow, 0.0f);
+
+            for (uint32 k = 0; k < contrib.count; ++k)
+                accumulateRow(out, &tmp[(uint64)(contrib.first + k) * dstRow], w[k], dstRow);
+        }
+    });
+}
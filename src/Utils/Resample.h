@@ -0,0 +1,22 @@
+#ifndef __PBR_RESAMPLE_H__
+#define __PBR_RESAMPLE_H__
+
+#include <PBR.h>
+#include <Image.h>
+
+namespace pbr {
+
+    // Radius of the filter, in destination pixels
+    float filterRadius(MipFilter filter);
+    float filterWeight(MipFilter filter, float x);
+
+    // Resamples an image of floats with nChan interleaved channels, using a
+    // separable filter. Borders are clamped to the edge. Rows are processed
+    // in parallel by the worker threads.
+    void resample(MipFilter filter, uint32 nChan,
+                  const float* src, uint32 srcWidth, uint32 srcHeight,
+                  float* dst, uint32 dstWidth, uint32 dstHeight);
+
+}
+
+#endif
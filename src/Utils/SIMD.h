@@ -0,0 +1,266 @@
+#ifndef __PBR_SIMD_H__
+#define __PBR_SIMD_H__
+
+#include <PBR.h>
+
+#include <cstring>
+
+#if defined(PBR_AVX2)
+#include <immintrin.h>
+#elif defined(PBR_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace pbr {
+namespace simd {
+
+    // Float vector of the widest instruction set available, with the same
+    // set of operations in every variant so kernels are written once
+
+#if defined(PBR_AVX2)
+
+    static PBR_CONSTEXPR uint32 WIDTH = 8;
+
+    typedef __m256  vfloat;
+    typedef __m256i vint;
+
+    inline vfloat set1(float v)                  { return _mm256_set1_ps(v); }
+    inline vfloat load(const float* p)           { return _mm256_loadu_ps(p); }
+    inline void   store(float* p, vfloat v)      { _mm256_storeu_ps(p, v); }
+
+    inline vfloat add(vfloat a, vfloat b)        { return _mm256_add_ps(a, b); }
+    inline vfloat sub(vfloat a, vfloat b)        { return _mm256_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b)        { return _mm256_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b)        { return _mm256_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a)                 { return _mm256_sqrt_ps(a); }
+    inline vfloat min(vfloat a, vfloat b)        { return _mm256_min_ps(a, b); }
+    inline vfloat max(vfloat a, vfloat b)        { return _mm256_max_ps(a, b); }
+
+    inline vfloat greater(vfloat a, vfloat b)    { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, mask); }
+
+    inline vint   toInt(vfloat v)                { return _mm256_cvtps_epi32(v); }
+    inline vfloat toFloat(vint v)                { return _mm256_cvtepi32_ps(v); }
+    inline vint   asInt(vfloat v)                { return _mm256_castps_si256(v); }
+    inline vfloat asFloat(vint v)                { return _mm256_castsi256_ps(v); }
+
+    inline vint   addi(vint a, vint b)           { return _mm256_add_epi32(a, b); }
+    inline vint   andi(vint a, int32 b)          { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+    inline vint   ori(vint a, int32 b)           { return _mm256_or_si256(a, _mm256_set1_epi32(b)); }
+    inline vint   seti(int32 v)                  { return _mm256_set1_epi32(v); }
+    inline vint   shl(vint a, int32 n)           { return _mm256_slli_epi32(a, n); }
+    inline vint   shr(vint a, int32 n)           { return _mm256_srli_epi32(a, n); }
+
+    inline vint   loadi(const uint32* p)         { return _mm256_loadu_si256((const __m256i*)p); }
+    inline void   storei(uint32* p, vint v)      { _mm256_storeu_si256((__m256i*)p, v); }
+
+    // Rounds to nearest and saturates WIDTH values into bytes
+    inline void storeBytes(uint8* p, vfloat v) {
+        vint i = toInt(v);
+        __m128i s = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+        _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(s, s));
+    }
+
+    // Widens WIDTH unsigned bytes or shorts to floats
+    inline vfloat loadBytes(const uint8* p) {
+        return toFloat(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+    }
+
+    inline vfloat loadShorts(const uint16* p) {
+        return toFloat(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)));
+    }
+
+#elif defined(PBR_SSE2)
+
+    static PBR_CONSTEXPR uint32 WIDTH = 4;
+
+    typedef __m128  vfloat;
+    typedef __m128i vint;
+
+    inline vfloat set1(float v)                  { return _mm_set1_ps(v); }
+    inline vfloat load(const float* p)           { return _mm_loadu_ps(p); }
+    inline void   store(float* p, vfloat v)      { _mm_storeu_ps(p, v); }
+
+    inline vfloat add(vfloat a, vfloat b)        { return _mm_add_ps(a, b); }
+    inline vfloat sub(vfloat a, vfloat b)        { return _mm_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b)        { return _mm_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b)        { return _mm_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a)                 { return _mm_sqrt_ps(a); }
+    inline vfloat min(vfloat a, vfloat b)        { return _mm_min_ps(a, b); }
+    inline vfloat max(vfloat a, vfloat b)        { return _mm_max_ps(a, b); }
+
+    inline vfloat greater(vfloat a, vfloat b)    { return _mm_cmpgt_ps(a, b); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    inline vint   toInt(vfloat v)                { return _mm_cvtps_epi32(v); }
+    inline vfloat toFloat(vint v)                { return _mm_cvtepi32_ps(v); }
+    inline vint   asInt(vfloat v)                { return _mm_castps_si128(v); }
+    inline vfloat asFloat(vint v)                { return _mm_castsi128_ps(v); }
+
+    inline vint   addi(vint a, vint b)           { return _mm_add_epi32(a, b); }
+    inline vint   andi(vint a, int32 b)          { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+    inline vint   ori(vint a, int32 b)           { return _mm_or_si128(a, _mm_set1_epi32(b)); }
+    inline vint   seti(int32 v)                  { return _mm_set1_epi32(v); }
+    inline vint   shl(vint a, int32 n)           { return _mm_slli_epi32(a, n); }
+    inline vint   shr(vint a, int32 n)           { return _mm_srli_epi32(a, n); }
+
+    inline vint   loadi(const uint32* p)         { return _mm_loadu_si128((const __m128i*)p); }
+    inline void   storei(uint32* p, vint v)      { _mm_storeu_si128((__m128i*)p, v); }
+
+    inline void storeBytes(uint8* p, vfloat v) {
+        vint s = _mm_packs_epi32(toInt(v), toInt(v));
+        int32 bytes = _mm_cvtsi128_si32(_mm_packus_epi16(s, s));
+        memcpy(p, &bytes, 4);
+    }
+
+    inline vfloat loadBytes(const uint8* p) {
+        int32 bytes;
+        memcpy(&bytes, p, 4);
+
+        __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+        return toFloat(_mm_unpacklo_epi16(v, zero));
+    }
+
+    inline vfloat loadShorts(const uint16* p) {
+        __m128i v = _mm_loadl_epi64((const __m128i*)p);
+        return toFloat(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+    }
+
+#else
+
+    static PBR_CONSTEXPR uint32 WIDTH = 1;
+
+    typedef float vfloat;
+    typedef int32 vint;
+
+    inline vfloat set1(float v)                  { return v; }
+    inline vfloat load(const float* p)           { return *p; }
+    inline void   store(float* p, vfloat v)      { *p = v; }
+
+    inline vfloat add(vfloat a, vfloat b)        { return a + b; }
+    inline vfloat sub(vfloat a, vfloat b)        { return a - b; }
+    inline vfloat mul(vfloat a, vfloat b)        { return a * b; }
+    inline vfloat div(vfloat a, vfloat b)        { return a / b; }
+    inline vfloat sqrt(vfloat a)                 { return std::sqrt(a); }
+    // b is returned when either is a NaN, like minps and maxps
+    inline vfloat min(vfloat a, vfloat b)        { return a < b ? a : b; }
+    inline vfloat max(vfloat a, vfloat b)        { return a > b ? a : b; }
+
+    // Masks are all ones or zero, as in the vector versions
+    inline vfloat asFloat(vint v)                { float f; memcpy(&f, &v, 4); return f; }
+    inline vint   asInt(vfloat v)                { vint i; memcpy(&i, &v, 4); return i; }
+
+    inline vfloat greater(vfloat a, vfloat b)    { return asFloat(a > b ? -1 : 0); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) { return asInt(mask) ? a : b; }
+
+    inline vint   toInt(vfloat v)                { return (vint)std::floor(v + 0.5f); }
+    inline vfloat toFloat(vint v)                { return (vfloat)v; }
+
+    inline vint   addi(vint a, vint b)           { return a + b; }
+    inline vint   andi(vint a, int32 b)          { return a & b; }
+    inline vint   ori(vint a, int32 b)           { return a | b; }
+    inline vint   seti(int32 v)                  { return v; }
+    inline vint   shl(vint a, int32 n)           { return (vint)((uint32)a << n); }
+    inline vint   shr(vint a, int32 n)           { return (vint)((uint32)a >> n); }
+
+    inline vint   loadi(const uint32* p)         { return (vint)*p; }
+    inline void   storei(uint32* p, vint v)      { *p = (uint32)v; }
+
+    inline void storeBytes(uint8* p, vfloat v) {
+        *p = (uint8)std::min(std::max(toInt(v), 0), 255);
+    }
+
+    inline vfloat loadBytes(const uint8* p)      { return (vfloat)*p; }
+    inline vfloat loadShorts(const uint16* p)    { return (vfloat)*p; }
+
+#endif
+
+    inline vfloat clamp(vfloat v, float low, float high) {
+        return min(max(v, set1(low)), set1(high));
+    }
+
+    // 2^x, for x in [-126, 127]
+    inline vfloat exp2(vfloat x) {
+        x = clamp(x, -126.0f, 127.0f);
+
+        // Split into an integer and a fraction in [-0.5, 0.5]
+        vint   i = toInt(x);
+        vfloat f = mul(sub(x, toFloat(i)), set1(0.69314718f));
+
+        // e^f, Taylor series up to the 6th power
+        vfloat p = set1(1.0f / 720.0f);
+        p = add(mul(p, f), set1(1.0f / 120.0f));
+        p = add(mul(p, f), set1(1.0f / 24.0f));
+        p = add(mul(p, f), set1(1.0f / 6.0f));
+        p = add(mul(p, f), set1(0.5f));
+        p = add(mul(p, f), set1(1.0f));
+        p = add(mul(p, f), set1(1.0f));
+
+        return mul(p, asFloat(shl(addi(i, seti(127)), 23)));
+    }
+
+    // log2(x), for positive and finite x
+    inline vfloat log2(vfloat x) {
+        vint bits = asInt(x);
+
+        // Mantissa in [1, 2) and the unbiased exponent
+        vfloat m = asFloat(ori(andi(bits, 0x007FFFFF), 0x3F800000));
+        vfloat e = toFloat(addi(andi(shr(bits, 23), 0xFF), seti(-127)));
+
+        // Move the mantissa to [sqrt(0.5), sqrt(2)) for a faster series
+        vfloat big = greater(m, set1(1.41421356f));
+        m = select(big, mul(m, set1(0.5f)), m);
+        e = select(big, add(e, set1(1.0f)), e);
+
+        // ln(m) = 2 * atanh(t)
+        vfloat t  = div(sub(m, set1(1.0f)), add(m, set1(1.0f)));
+        vfloat t2 = mul(t, t);
+
+        vfloat p = set1(1.0f / 9.0f);
+        p = add(mul(p, t2), set1(1.0f / 7.0f));
+        p = add(mul(p, t2), set1(1.0f / 5.0f));
+        p = add(mul(p, t2), set1(1.0f / 3.0f));
+        p = add(mul(p, t2), set1(1.0f));
+
+        return add(e, mul(mul(p, t), set1(2.0f * 1.44269504f)));
+    }
+
+    // x^y, for x >= 0. Zero stays zero.
+    inline vfloat pow(vfloat x, float y) {
+        vfloat r = exp2(mul(log2(max(x, set1(1e-30f))), set1(y)));
+        return select(greater(x, set1(0.0f)), r, set1(0.0f));
+    }
+
+    // Angle of (x, y) in [-pi, pi], within 2e-6 radians. Zero for (0, 0).
+    inline vfloat atan2(vfloat y, vfloat x) {
+        vfloat zero = set1(0.0f);
+
+        vfloat ax = max(x, sub(zero, x));
+        vfloat ay = max(y, sub(zero, y));
+        vfloat mx = max(ax, ay);
+
+        // atan(a) for a in [0, 1]
+        vfloat a  = select(greater(mx, zero), div(min(ax, ay), mx), zero);
+        vfloat a2 = mul(a, a);
+
+        vfloat p = set1(-0.0117212f);
+        p = add(mul(p, a2), set1(0.05265332f));
+        p = add(mul(p, a2), set1(-0.11643287f));
+        p = add(mul(p, a2), set1(0.19354346f));
+        p = add(mul(p, a2), set1(-0.33262347f));
+        p = add(mul(p, a2), set1(0.99997726f));
+        p = mul(p, a);
+
+        // Back to the octant of (x, y)
+        p = select(greater(ay, ax), sub(set1(1.57079633f), p), p);
+        p = select(greater(zero, x), sub(set1(3.14159265f), p), p);
+        return select(greater(zero, y), sub(zero, p), p);
+    }
+
+}
+}
+
+#endif
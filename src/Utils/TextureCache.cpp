@@ -0,0 +1,247 @@
+#include <TextureCache.h>
+#include <MappedFile.h>
+#include <PBRMath.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <path.h>
+
+using namespace pbr;
+
+namespace {
+    // Changes to the import code that alter its output must bump this,
+    // so entries written by older versions are never used
+    static PBR_CONSTEXPR uint64 CACHE_VERSION = 2;
+
+    static PBR_CONSTEXPR uint64 DEFAULT_CAPACITY = 1ull << 30; // 1 GB
+
+    // Whether the file is gone. Files mapped by readers cannot be
+    // deleted on every platform.
+    bool removeFile(const std::string& path) {
+        filesystem::path file(path);
+        return !file.exists() || file.remove_file();
+    }
+}
+
+TextureCache::TextureCache() : _folder("TextureCache"), _capacity(DEFAULT_CAPACITY),
+    _totalSize(0), _tick(0) {
+    readIndex();
+}
+
+TextureCache::~TextureCache() {
+    // Keeps the use order of this run
+    writeIndex();
+}
+
+TextureCache& TextureCache::get() {
+    static TextureCache cache;
+    return cache;
+}
+
+void TextureCache::setDirectory(const std::string& folder) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    writeIndex();
+
+    _folder = folder;
+    _entries.clear();
+    _totalSize = 0;
+    _tick = 0;
+
+    readIndex();
+}
+
+void TextureCache::setCapacity(uint64 maxBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _capacity = maxBytes;
+    evict(0);
+    writeIndex();
+}
+
+uint64 TextureCache::computeKey(const std::string& filePath, const TextureImportSettings& settings) const {
+    MappedFile file;
+    if (!file.open(filePath))
+        return 0;
+
+    uint64 seed = CACHE_VERSION | ((uint64)settings.sRGB << 8) |
+                  ((uint64)settings.mipFilter << 16) | ((uint64)settings.compressed << 32);
+
+    uint64 key = math::hashBytes(file.data(), file.size(), seed);
+
+    // 0 is reserved for unreadable files
+    return (key != 0) ? key : 1;
+}
+
+bool TextureCache::load(uint64 key, Image& image) {
+    std::string path = entryPath(key);
+
+    Entry read = { 0, 0 };
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _entries.find(key);
+        if (it != _entries.end())
+            read = it->second;
+    }
+
+    bool loaded = image.loadImage(path);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _entries.find(key);
+    if (!loaded) {
+        // Drop entries that were deleted or cannot be read anymore, unless
+        // they were stored again while being read
+        if (it != _entries.end() && it->second.lastUse == read.lastUse &&
+            it->second.size == read.size && removeFile(path)) {
+            _totalSize -= it->second.size;
+            _entries.erase(it);
+        }
+
+        return false;
+    }
+
+    // Entries missing from the index are adopted
+    if (it == _entries.end()) {
+        Entry entry = { (uint64)filesystem::path(path).file_size(), 0 };
+        it = _entries.emplace(key, entry).first;
+
+        _totalSize += entry.size;
+    }
+
+    it->second.lastUse = ++_tick;
+
+    return true;
+}
+
+bool TextureCache::store(uint64 key, const Image& image) {
+    std::string path = entryPath(key);
+
+    // Written under a unique name first, so readers never see partial files
+    std::string temp;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        filesystem::path folder(_folder);
+        if (!folder.exists() && !filesystem::create_directory(folder))
+            return false;
+
+        temp = path + "." + std::to_string(++_tick) + ".img";
+    }
+
+    if (!image.saveImage(temp)) {
+        removeFile(temp);
+        return false;
+    }
+
+    uint64 size = filesystem::path(temp).file_size();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // rename does not replace existing files on every platform. An entry
+    // that is still mapped stays as it is.
+    if (!removeFile(path)) {
+        removeFile(temp);
+        return false;
+    }
+
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        _totalSize -= it->second.size;
+        _entries.erase(it);
+    }
+
+    evict(size);
+
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        removeFile(temp);
+        writeIndex();
+        return false;
+    }
+
+    Entry entry = { size, ++_tick };
+    _entries.emplace(key, entry);
+    _totalSize += size;
+
+    writeIndex();
+
+    return true;
+}
+
+void TextureCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Entries still mapped by readers are kept
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (removeFile(entryPath(it->first))) {
+            _totalSize -= it->second.size;
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    writeIndex();
+}
+
+std::string TextureCache::entryPath(uint64 key) const {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+    return _folder + "/" + name + ".img";
+}
+
+void TextureCache::readIndex() {
+    std::ifstream file(_folder + "/index.txt");
+
+    // Each line holds the key, size and last use of an entry
+    unsigned long long key, size, lastUse;
+    while (file >> std::hex >> key >> std::dec >> size >> lastUse) {
+        Entry entry = { size, lastUse };
+        if (!_entries.emplace(key, entry).second)
+            continue;
+
+        _totalSize += size;
+        _tick = std::max(_tick, (uint64)lastUse);
+    }
+}
+
+void TextureCache::writeIndex() const {
+    if (!filesystem::path(_folder).exists())
+        return;
+
+    std::ofstream file(_folder + "/index.txt");
+    for (const auto& entry : _entries) {
+        file << std::hex << entry.first << std::dec << " "
+             << entry.second.size << " " << entry.second.lastUse << "\n";
+    }
+}
+
+void TextureCache::evict(uint64 reserve) {
+    if (_totalSize + reserve <= _capacity)
+        return;
+
+    // Least recently used first
+    std::vector<std::pair<uint64, uint64>> order;
+    order.reserve(_entries.size());
+    for (const auto& entry : _entries)
+        order.emplace_back(entry.second.lastUse, entry.first);
+
+    std::sort(order.begin(), order.end());
+
+    // Entries still mapped by readers cannot be deleted and are skipped
+    for (const auto& use : order) {
+        if (_totalSize + reserve <= _capacity)
+            break;
+
+        if (!removeFile(entryPath(use.second)))
+            continue;
+
+        auto it = _entries.find(use.second);
+        _totalSize -= it->second.size;
+        _entries.erase(it);
+    }
+}
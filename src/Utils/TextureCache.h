@@ -0,0 +1,76 @@
+#ifndef __PBR_TEXTURECACHE_H__
+#define __PBR_TEXTURECACHE_H__
+
+#include <mutex>
+#include <unordered_map>
+
+#include <PBR.h>
+#include <Image.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: TexCache.load(key, image);
+#define TexCache TextureCache::get()
+
+namespace pbr {
+
+    // How a source file is processed before it is uploaded
+    struct TextureImportSettings {
+        bool        sRGB;
+        MipFilter   mipFilter;
+        ImageFormat compressed; // IMGFMT_UNKNOWN to keep the source format
+    };
+
+    // Processed textures, stored as IMG files named after a hash of the
+    // source file contents and the import settings. Editing a source file
+    // changes its key, and stale entries age out of the cache, least
+    // recently used first, once it grows over its capacity.
+    class TextureCache {
+    public:
+        ~TextureCache();
+
+        static TextureCache& get();
+
+        void setDirectory(const std::string& folder);
+        void setCapacity(uint64 maxBytes);
+
+        // Key of a source file processed with the given settings, from a
+        // hash of its contents. Returns 0 if the file cannot be read.
+        uint64 computeKey(const std::string& filePath, const TextureImportSettings& settings) const;
+
+        // Loads an entry, mapped from disk. Returns false if it is not
+        // in the cache.
+        bool load(uint64 key, Image& image);
+
+        // Stores an entry, evicting old ones to stay under the capacity
+        bool store(uint64 key, const Image& image);
+
+        // Removes every entry
+        void clear();
+
+    private:
+        TextureCache();
+
+        struct Entry {
+            uint64 size;
+            uint64 lastUse;
+        };
+
+        std::string entryPath(uint64 key) const;
+
+        void readIndex();
+        void writeIndex() const;
+        void evict(uint64 reserve);
+
+        std::unordered_map<uint64, Entry> _entries;
+        std::string _folder;
+
+        uint64 _capacity;
+        uint64 _totalSize;
+        uint64 _tick;
+
+        std::mutex _mutex;
+    };
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <ThreadPool.h>
+
+#include <atomic>
+
+using namespace pbr;
+
+namespace {
+    struct ParallelJob {
+        std::function<void(uint32)> func;
+        uint32 count;
+
+        std::atomic<uint32> next;
+        std::atomic<uint32> done;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+
+    void runJob(ParallelJob& job) {
+        uint32 idx;
+        while ((idx = job.next++) < job.count) {
+            job.func(idx);
+
+            if (++job.done == job.count) {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.cond.notify_all();
+            }
+        }
+    }
+}
+
+ThreadPool::ThreadPool() : _stop(false) {
+    uint32 numCores = std::thread::hardware_concurrency();
+
+    // Leave a core for the thread issuing the work
+    uint32 numWorkers = (numCores > 1) ? numCores - 1 : 1;
+    for (uint32 t = 0; t < numWorkers; ++t)
+        _threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _cond.notify_all();
+    for (std::thread& thread : _threads)
+        thread.join();
+}
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool _inst;
+    return _inst;
+}
+
+uint32 ThreadPool::numThreads() const {
+    return (uint32)_threads.size();
+}
+
+void ThreadPool::push(std::function<void()>&& task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(std::move(task));
+    }
+
+    _cond.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+
+            if (_stop && _tasks.empty())
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(uint32 count, const std::function<void(uint32)>& func) {
+    if (count == 0)
+        return;
+
+    if (count == 1) {
+        func(0);
+        return;
+    }
+
+    auto job = std::make_shared<ParallelJob>();
+    job->func  = func;
+    job->count = count;
+    job->next  = 0;
+    job->done  = 0;
+
+    // Helpers that start after the work is gone just return
+    uint32 numHelpers = std::min(count - 1, numThreads());
+    for (uint32 h = 0; h < numHelpers; ++h)
+        push([job]() { runJob(*job); });
+
+    runJob(*job);
+
+    // Wait for the indices taken by the helpers
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cond.wait(lock, [&job]() { return job->done == job->count; });
+}
+
+void ThreadPool::parallelRange(uint32 count, uint32 grain, const std::function<void(uint32, uint32)>& func) {
+    grain = std::max(grain, 1u);
+
+    uint32 numRanges = (count + grain - 1) / grain;
+    parallelFor(numRanges, [&](uint32 r) {
+        func(r * grain, std::min((r + 1) * grain, count));
+    });
+}
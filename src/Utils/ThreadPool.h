@@ -0,0 +1,67 @@
+#ifndef __PBR_THREADPOOL_H__
+#define __PBR_THREADPOOL_H__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <queue>
+
+#include <PBR.h>
+
+// Macro to syntax sugar the singleton getter
+// ex: Workers.parallelFor(6, func);
+#define Workers ThreadPool::get()
+
+namespace pbr {
+
+    class ThreadPool {
+    public:
+        ~ThreadPool();
+
+        static ThreadPool& get();
+
+        uint32 numThreads() const;
+
+        // Calls func(i) for every i in [0, count) and waits for all of them.
+        // The calling thread takes part in the work, so nested calls are safe.
+        void parallelFor(uint32 count, const std::function<void(uint32)>& func);
+
+        // Splits [0, count) into ranges of at least grain indices and calls
+        // func(begin, end) for each of them in parallel
+        void parallelRange(uint32 count, uint32 grain, const std::function<void(uint32, uint32)>& func);
+
+        // Queues func to run on a worker thread
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> enqueue(F&& func);
+
+    private:
+        ThreadPool();
+
+        void push(std::function<void()>&& task);
+        void workerLoop();
+
+        std::vector<std::thread>          _threads;
+        std::queue<std::function<void()>> _tasks;
+
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        bool _stop;
+    };
+
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> ThreadPool::enqueue(F&& func) {
+        typedef typename std::result_of<F()>::type Ret;
+
+        auto task = std::make_shared<std::packaged_task<Ret()>>(std::forward<F>(func));
+        std::future<Ret> result = task->get_future();
+
+        push([task]() { (*task)(); });
+
+        return result;
+    }
+
+}
+
+#endif
\ No newline at end of file
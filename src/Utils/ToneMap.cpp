@@ -0,0 +1,87 @@
+#include <ToneMap.h>
+#include <SIMD.h>
+
+using namespace pbr;
+using namespace pbr::simd;
+
+namespace {
+    float uncharted(float v, const RendererBuffer& p) {
+        return ((v * (p.A * v + p.C * p.B) + p.D * p.E) / (v * (p.A * v + p.B) + p.D * p.F)) - p.E / p.F;
+    }
+
+    struct ToneKernel {
+        ToneOperator op;
+
+        vfloat exposure;
+        vfloat A, CB, B, DE, DF, EF;
+        vfloat whiteScale;
+        float  invGamma;
+
+        ToneKernel(ToneOperator op, const RendererBuffer& p) : op(op) {
+            exposure = set1(p.exp);
+
+            A  = set1(p.A);
+            B  = set1(p.B);
+            CB = set1(p.C * p.B);
+            DE = set1(p.D * p.E);
+            DF = set1(p.D * p.F);
+            EF = set1(p.E / p.F);
+            whiteScale = set1(1.0f / uncharted(p.W, p));
+
+            invGamma = (p.gamma > 0.0f) ? 1.0f / p.gamma : 1.0f;
+        }
+
+        // Returns WIDTH values scaled to [0, 255]
+        vfloat operator()(vfloat c) const {
+            c = mul(c, exposure);
+
+            switch (op) {
+                case REINHART:
+                    c = div(c, add(c, set1(1.0f)));
+                    break;
+                case UNCHARTED: {
+                    vfloat num = add(mul(c, add(mul(A, c), CB)), DE);
+                    vfloat den = add(mul(c, add(mul(A, c), B)), DF);
+                    c = mul(sub(div(num, den), EF), whiteScale);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            c = pow(clamp(c, 0.0f, 1.0f), invGamma);
+
+            return mul(c, set1(255.0f));
+        }
+    };
+}
+
+void pbr::toneMapRow(ToneOperator op, const RendererBuffer& params,
+                     const float* src, uint8* dst, uint32 numPixels, uint32 nChan) {
+    ToneKernel kernel(op, params);
+
+    // Channels are all mapped alike, alpha is fixed afterwards
+    uint64 count = (uint64)numPixels * nChan;
+
+    uint64 i = 0;
+    for (; i + WIDTH <= count; i += WIDTH)
+        storeBytes(dst + i, kernel(load(src + i)));
+
+    // Pad the tail to a full vector
+    if (i < count) {
+        float  tail[WIDTH] = { };
+        uint8  out[WIDTH];
+        uint32 rem = (uint32)(count - i);
+
+        memcpy(tail, src + i, rem * sizeof(float));
+        storeBytes(out, kernel(load(tail)));
+        memcpy(dst + i, out, rem);
+    }
+
+    if (nChan == 4) {
+        for (uint32 p = 0; p < numPixels; ++p) {
+            float a = std::min(std::max(src[p * 4 + 3], 0.0f), 1.0f);
+            dst[p * 4 + 3] = (uint8)(a * 255.0f + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef __PBR_TONEMAP_H__
+#define __PBR_TONEMAP_H__
+
+#include <PBR.h>
+
+namespace pbr {
+
+    enum ToneOperator {
+        SIMPLE,
+        REINHART,
+        UNCHARTED
+    };
+
+    // Buffer for shaders with renderer information
+    struct RendererBuffer {
+        float gamma;
+        float exp;
+
+        // Uncharted tone curve control parameters
+        float A, B, C, D, E, F, W;
+    };
+
+    // Applies exposure, the tone operator and the inverse of the gamma in
+    // params to numPixels pixels of nChan floats, writing 8-bit values.
+    // Matches the post-processing in the shaders. A fourth channel is
+    // alpha and is only clamped.
+    void toneMapRow(ToneOperator op, const RendererBuffer& params,
+                    const float* src, uint8* dst, uint32 numPixels, uint32 nChan);
+
+}
+
+#endif
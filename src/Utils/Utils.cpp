@@ -1,10 +1,16 @@
 #include <Utils.h>
 
 #include <iostream>
+#include <algorithm>
+#include <path.h>
 
 #include <Mesh.h>
 #include <LoadXML.h>
 #include <PBRMaterial.h>
+#include <TextureCache.h>
+#include <TextureStreamer.h>
+#include <TextureResidency.h>
+#include <Resources.h>
 
 using namespace pbr;
 
@@ -43,29 +49,159 @@ sref<Shape> Utils::loadSceneObject(const std::string& folder) {
     return obj;
 }
 
-RRID Utils::loadTexture(const std::string& path) {
-    Image image;
-    TexSampler texSampler;
+namespace {
+    // A material map, streamed in while a flat placeholder stands in for it
+    struct TextureImport {
+        std::string name;
+        bool        sRGB;
+        ImageFormat compressed;
+        Color       placeholder;
+
+        std::string key;
+        RRID        rrid;
+    };
+
+    // Registry key of a texture file, shared by every material that
+    // imports it with the same settings
+    std::string textureKey(const std::string& path, bool sRGB, ImageFormat compressed) {
+        filesystem::path file(path);
+        std::string canonical = file.exists() ? file.make_absolute().str() : path;
+
+        return canonical + "|" + std::to_string(sRGB) + "|" + std::to_string(compressed);
+    }
+
+    uint64 pixelHash(const Image& image) {
+        uint32 layout[] = { (uint32)image.format(), (uint32)image.width(), (uint32)image.height(),
+                            (uint32)image.depth(), image.numLevels() };
+
+        uint64 seed = math::hashBytes(layout, sizeof(layout));
+        return math::hashBytes(image.data(0), image.totalSize(), seed);
+    }
+
+    // CPU side of the texture import, it makes no GL calls
+    bool importTexture(const std::string& path, bool sRGB, ImageFormat compressed,
+                       Image& image, TexSampler& sampler) {
+        // Block compress only when the GPU can sample the format
+        if (compressed != IMGFMT_UNKNOWN && !RHI.isFormatSupported(compressed))
+            compressed = IMGFMT_UNKNOWN;
+
+        TextureImportSettings settings = { sRGB, MIPFILTER_KAISER, compressed };
+        uint64 key = TexCache.computeKey(path, settings);
+
+        if (key == 0 || !TexCache.load(key, image)) {
+            if (!image.loadImage(path))
+                return false;
+
+            // Assets may ship without mips, build the chain at import
+            if (!image.hasMipMap())
+                image.generateMipmaps(settings.mipFilter, sRGB);
+
+            // The BC7 encoder only writes mode 6 blocks, which lose too
+            // much alpha precision on cutouts. Maps with transparent
+            // texels use DXT5 instead, or stay uncompressed without it.
+            if (compressed == IMGFMT_BC7 && !image.isOpaque())
+                compressed = RHI.isFormatSupported(IMGFMT_DXT5) ? IMGFMT_DXT5 : IMGFMT_UNKNOWN;
+
+            if (compressed != IMGFMT_UNKNOWN)
+                image.compress(compressed);
+
+            if (key != 0)
+                TexCache.store(key, image);
+        }
+
+        if (image.hasMipMap())
+            sampler.setFilterMode(FILTER_LINEAR_MIP_LINEAR, FILTER_LINEAR);
+
+        return true;
+    }
 
-    image.loadImage(path);
+    // Queues a material map on the streamer. The key is registered right
+    // away, so other materials share the texture before it is uploaded.
+    RRID streamTexture(const std::string& path, const TextureImport& tex) {
+        sref<uint64> hash = make_sref<uint64>(0);
 
-    RRID rrid = RHI.createTexture(image, texSampler);
+        bool sRGB = tex.sRGB;
+        ImageFormat compressed = tex.compressed;
 
-    return rrid;
+        auto import = [path, sRGB, compressed, hash](Image& image, TexSampler& sampler) {
+            if (!importTexture(path, sRGB, compressed, image, sampler))
+                return false;
+
+            *hash = pixelHash(image);
+            return true;
+        };
+
+        std::string key = tex.key;
+        // The image is kept to load back the levels residency evicts
+        auto ready = [key, hash](RRID id, const sref<Image>& image) {
+            Resource.registerTexture(key, *hash, id, image->totalSize());
+            Residency.manage(id, image);
+        };
+
+        // Pixels already on the GPU under another path are shared
+        auto share = [hash](RRID id) {
+            return Resource.aliasTexture(id, *hash);
+        };
+
+        RRID rrid = Streamer.request(import, tex.placeholder, ready, share);
+        Resource.registerTexture(key, 0, rrid, 0);
+
+        return rrid;
+    }
 }
 
 sref<Material> Utils::buildMaterial(const std::string& path, const ParameterMap& map) {
     sref<PBRMaterial> mat = make_sref<PBRMaterial>();
 
+    TextureImport diffuse   = { "diffuse",   true,  IMGFMT_BC7,   Color(0.5f),             "", -1 };
+    TextureImport normal    = { "normal",    false, IMGFMT_ATI2N, Color(0.5f, 0.5f, 1.0f), "", -1 };
+    TextureImport roughness = { "roughness", false, IMGFMT_ATI1N, Color(0.5f),             "", -1 };
+    TextureImport metallic  = { "metallic",  false, IMGFMT_ATI1N, Color(0.0f),             "", -1 };
+
+    // Constant values take precedence over textures
+    std::vector<TextureImport*> imports;
+    if (!map.hasRGB("diffuse") && map.hasTexture("diffuse"))
+        imports.push_back(&diffuse);
+    if (map.hasTexture("normal"))
+        imports.push_back(&normal);
+    if (!map.hasFloat("roughness") && map.hasTexture("roughness"))
+        imports.push_back(&roughness);
+    if (!map.hasFloat("metallic") && map.hasTexture("metallic"))
+        imports.push_back(&metallic);
+
+    // Files already in the registry are not imported again, and files
+    // used by more than one map are imported once
+    std::vector<TextureImport*> pending;
+    for (TextureImport* tex : imports) {
+        tex->key  = textureKey(path + "/" + map.getTexture(tex->name), tex->sRGB, tex->compressed);
+        tex->rrid = -1;
+
+        bool queued = std::any_of(pending.begin(), pending.end(), [&](const TextureImport* other) {
+            return other->key == tex->key;
+        });
+
+        if (!queued && (tex->rrid = Resource.acquireTexture(tex->key)) == -1)
+            pending.push_back(tex);
+    }
+
+    // Maps are decoded on the workers and uploaded over the next frames
+    for (TextureImport* tex : pending)
+        tex->rrid = streamTexture(path + "/" + map.getTexture(tex->name), *tex);
+
+    for (TextureImport* tex : imports) {
+        if (tex->rrid == -1)
+            tex->rrid = Resource.acquireTexture(tex->key);
+    }
+
     if (map.hasRGB("diffuse"))
         mat->setDiffuse(Color(map.getRGB("diffuse")));
     else if (map.hasTexture("diffuse"))
-        mat->setDiffuse(loadTexture(path + "/" + map.getTexture("diffuse")));
+        mat->setDiffuse(diffuse.rrid);
     else
         mat->setDiffuse(Color(0.5f, 0.5f, 0.5f));
 
     if (map.hasTexture("normal"))
-        mat->setNormal(loadTexture(path + "/" + map.getTexture("normal")));
+        mat->setNormal(normal.rrid);
 
     if (map.hasRGB("specular"))
         mat->setSpecular(Color(map.getRGB("specular")));
@@ -75,14 +211,14 @@ sref<Material> Utils::buildMaterial(const std::string& path, const ParameterMap&
     if (map.hasFloat("roughness"))
         mat->setRoughness(map.getFloat("roughness"));
     else if (map.hasTexture("roughness"))
-        mat->setRoughness(loadTexture(path + "/" + map.getTexture("roughness")));
+        mat->setRoughness(roughness.rrid);
     else
         mat->setRoughness(0.2f);
 
     if (map.hasFloat("metallic"))
         mat->setMetallic(map.getFloat("metallic"));
     else if (map.hasTexture("metallic"))
-        mat->setMetallic(loadTexture(path + "/" + map.getTexture("metallic")));
+        mat->setMetallic(metallic.rrid);
     else
         mat->setMetallic(0.5f);
 
@@ -14,7 +14,6 @@ namespace pbr {
         void throwError(const std::string& error);
 
         sref<Shape> loadSceneObject(const std::string& folder);
-        RRID loadTexture(const std::string& path);
         sref<Material> buildMaterial(const std::string& path, const ParameterMap& map);
     }
 }